@@ -0,0 +1,127 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+
+#include "Integer.h"
+
+namespace llreve {
+namespace dynamic {
+
+// Functions are lowered once to a register based bytecode before they are
+// interpreted. Every variable of a function gets a dense register index, the
+// constants follow the variables so the operands of an instruction are plain
+// indices into the registers of a frame.
+using Register = unsigned;
+
+enum class Opcode {
+    Add,
+    Sub,
+    Mul,
+    SDiv,
+    UDiv,
+    SRem,
+    URem,
+    Shl,
+    LShr,
+    AShr,
+    And,
+    Or,
+    Xor,
+    BoolAnd,
+    BoolOr,
+    BoolXor,
+    // The predicate is stored in the immediate
+    ICmp,
+    // The following casts store the target bitwidth in the immediate
+    BoolToInt,
+    ZExt,
+    SExt,
+    ZExtOrTrunc,
+    // Operands: pointer, constant offset and pairs of variable index and scale
+    GEP,
+    // The bitwidth of the loaded or stored value is stored in the immediate
+    Load,
+    Store,
+    Select,
+    Call,
+    // Terminators, their operands after the condition are edge indices
+    Ret,
+    Br,
+    CondBr,
+    // Operands: condition, default edge and pairs of case value and edge
+    Switch,
+    // Report the origin when they are executed
+    UnsupportedInstruction,
+    UnsupportedOperand,
+    UnsupportedTerminator
+};
+
+struct BytecodeInstr {
+    Opcode opcode;
+    Register result;
+    // Range in Bytecode::operands
+    unsigned firstOperand;
+    unsigned numOperands;
+    unsigned immediate;
+    // The value this instruction has been lowered from
+    const llvm::Value *origin;
+};
+
+struct PhiMove {
+    Register to;
+    Register from;
+};
+
+// A control flow edge together with the phi nodes of its target which are
+// evaluated in order when it is taken
+struct BytecodeEdge {
+    unsigned block;
+    // Range in Bytecode::moves
+    unsigned firstMove;
+    unsigned numMoves;
+    // An incoming value of a phi node that can’t be interpreted
+    const llvm::Value *unsupported;
+};
+
+struct BytecodeBlock {
+    const llvm::BasicBlock *block;
+    // Range in Bytecode::instrs, the last instruction is the terminator
+    unsigned firstInstr;
+    unsigned endInstr;
+};
+
+struct Bytecode {
+    const llvm::Function *function;
+    std::vector<BytecodeBlock> blocks;
+    std::vector<BytecodeInstr> instrs;
+    std::vector<Register> operands;
+    std::vector<BytecodeEdge> edges;
+    std::vector<PhiMove> moves;
+    llvm::DenseMap<const llvm::BasicBlock *, unsigned> blockIndices;
+    llvm::DenseMap<const llvm::Value *, Register> registers;
+    // The value stored in each of the first registers, the remaining
+    // registers hold constants
+    std::vector<const llvm::Value *> variables;
+    // The registers of a fresh frame
+    std::vector<Integer> initialRegisters;
+};
+
+/// The bytecode is cached, so this only lowers a function on its first use
+const Bytecode &getBytecode(const llvm::Function &fun);
+/// Has to be called when a function is modified after it has been interpreted
+void forgetBytecode(const llvm::Function &fun);
+}
+}
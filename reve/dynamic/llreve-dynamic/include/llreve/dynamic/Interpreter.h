@@ -121,6 +121,15 @@ struct Heap {
          Integer background)
         : assignedValues(std::move(assignedValues)),
           background(std::move(background)) {}
+    Heap(const Heap &other) = default;
+    // Moves of the DenseMap don’t allocate, declaring this noexcept allows
+    // vectors of traces to move their states when they grow instead of
+    // copying them
+    Heap(Heap &&other) noexcept
+        : assignedValues(std::move(other.assignedValues)),
+          background(std::move(other.background)) {}
+    Heap &operator=(const Heap &other) = default;
+    Heap &operator=(Heap &&other) = default;
 };
 
 bool isContainedIn(const llvm::SmallDenseMap<HeapAddress, Integer> &small,
@@ -137,7 +146,8 @@ template <typename T> struct State {
     State(VarMap<T> variables, Heap heap)
         : variables(std::move(variables)), heap(std::move(heap)) {}
     State() = default;
-    State(State &&other) = default;
+    State(State &&other) noexcept
+        : variables(std::move(other.variables)), heap(std::move(other.heap)) {}
     State(const State &other) = default;
     State &operator=(const State &other) = default;
     State &operator=(State &&other) = default;
@@ -219,34 +229,6 @@ template <typename T> struct BlockStep : Step<T> {
     }
 };
 
-template <typename T> struct BlockUpdate {
-    // State after phi nodes
-    State<T> step;
-    // next block, null if the block ended with a return instruction
-    const llvm::BasicBlock *nextBlock;
-    // function calls in this block in the order they were called
-    std::vector<Call<T>> calls;
-    // Indicates a stop because we ran out of steps
-    bool earlyExit;
-    // steps this block has needed, if there are no function calls exactly one
-    // step per block is needed
-    uint32_t blocksVisited;
-    BlockUpdate(State<T> step, // State end,
-                const llvm::BasicBlock *nextBlock, std::vector<Call<T>> calls,
-                bool earlyExit, uint32_t blocksVisited)
-        : step(std::move(step)), nextBlock(nextBlock), calls(std::move(calls)),
-          earlyExit(earlyExit), blocksVisited(blocksVisited) {}
-    BlockUpdate() = default;
-};
-
-struct TerminatorUpdate {
-    // State end;
-    const llvm::BasicBlock *nextBlock;
-    TerminatorUpdate(const llvm::BasicBlock *nextBlock)
-        : nextBlock(nextBlock) {}
-    TerminatorUpdate() = default;
-};
-
 /// The variables in the entry state will be renamed appropriately for both
 /// programs
 MonoPair<FastCall>
@@ -264,60 +246,6 @@ auto interpretFunction(const llvm::Function &fun, FastState entry,
 auto interpretFunction(const llvm::Function &fun, FastState entry,
                        const llvm::BasicBlock *bb, uint32_t maxSteps,
                        const AnalysisResultsMap &analysisResults) -> FastCall;
-auto interpretBlock(const llvm::BasicBlock &block,
-                    const llvm::BasicBlock *prevBlock, FastState &state,
-                    bool skipPhi, uint32_t maxStep,
-                    const AnalysisResultsMap &analysisResults)
-    -> BlockUpdate<const llvm::Value *>;
-auto interpretPHI(const llvm::PHINode &instr, FastState &state,
-                  const llvm::BasicBlock *prevBlock) -> void;
-auto interpretInstruction(const llvm::Instruction *instr, FastState &state)
-    -> void;
-auto interpretTerminator(const llvm::TerminatorInst *instr, FastState &state)
-    -> TerminatorUpdate;
-auto resolveValue(const llvm::Value *val, const FastState &state,
-                  const llvm::Type *type) -> Integer;
-auto interpretICmpInst(const llvm::ICmpInst *instr, FastState &state) -> void;
-auto interpretIntPredicate(const llvm::ICmpInst *instr,
-                           llvm::CmpInst::Predicate pred, const Integer &i0,
-                           const Integer &i1, FastState &state) -> void;
-auto interpretBinOp(const llvm::BinaryOperator *instr, FastState &state)
-    -> void;
-auto interpretIntBinOp(const llvm::BinaryOperator *instr,
-                       llvm::Instruction::BinaryOps op, const Integer &i0,
-                       const Integer &i1, FastState &state) -> void;
-auto interpretBoolBinOp(const llvm::BinaryOperator *instr,
-                        llvm::Instruction::BinaryOps op, bool b0, bool b1,
-                        FastState &state) -> void;
-
-template <typename A, typename T> Integer resolveGEP(T &gep, State<A> &state) {
-    Integer offset = resolveValue(gep.getPointerOperand(), state,
-                                  gep.getPointerOperand()->getType());
-    const auto type = gep.getSourceElementType();
-    std::vector<llvm::Value *> indices;
-    for (auto ix = gep.idx_begin(), e = gep.idx_end(); ix != e; ++ix) {
-        // Try several ways of finding the module
-        const llvm::Module *mod = nullptr;
-        if (auto instr = llvm::dyn_cast<llvm::Instruction>(&gep)) {
-            mod = instr->getModule();
-        }
-        if (auto global =
-                llvm::dyn_cast<llvm::GlobalValue>(gep.getPointerOperand())) {
-            mod = global->getParent();
-        }
-        if (mod == nullptr) {
-            logErrorData("Couldn’t cast gep to an instruction:\n", gep);
-        }
-        indices.push_back(*ix);
-        const auto indexedType = llvm::GetElementPtrInst::getIndexedType(
-            type, llvm::ArrayRef<llvm::Value *>(indices));
-        const auto size = typeSize(indexedType, mod->getDataLayout());
-        Integer val = resolveValue(*ix, state, (*ix)->getType());
-        offset += Integer(mpz_class(size)).asPointer() *
-                  Integer(val.asUnbounded()).asPointer();
-    }
-    return offset;
-}
 
 std::string valueName(const llvm::Value *val);
 
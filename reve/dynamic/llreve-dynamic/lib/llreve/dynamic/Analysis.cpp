@@ -16,6 +16,7 @@
 #include "MonoPair.h"
 #include "PathAnalysis.h"
 #include "Serialize.h"
+#include "llreve/dynamic/Bytecode.h"
 #include "llreve/dynamic/HeapPattern.h"
 #include "llreve/dynamic/Interpreter.h"
 #include "llreve/dynamic/Linear.h"
@@ -405,6 +406,44 @@ driver(MonoPair<llvm::Module &> modules, AnalysisResultsMap &analysisResults,
     return generateSMT(modules, analysisResults, fileOpts);
 }
 
+// The clauses for the current program apart from the declarations of the
+// invariants, with the foralls already removed. They do not depend on the
+// invariant candidates and only change when the loops are transformed.
+struct CandidateIndependentClauses {
+    vector<SharedSMTRef> header;
+    vector<SharedSMTRef> assertions;
+    set<SortedVar> introducedVariables;
+};
+
+static CandidateIndependentClauses
+candidateIndependentClauses(MonoPair<llvm::Module &> modules,
+                            const AnalysisResultsMap &analysisResults,
+                            FileOptions fileOpts) {
+    CandidateIndependentClauses clauses;
+    vector<SharedSMTRef> header;
+    vector<SharedSMTRef> footer = generateSMTStreaming(
+        modules, analysisResults, fileOpts,
+        [&header](vector<SharedSMTRef> newHeader) {
+            header = std::move(newHeader);
+        },
+        [&clauses](SharedSMTRef assertion) {
+            clauses.assertions.push_back(std::move(assertion));
+        },
+        InvariantDeclarations::Exclude);
+    for (auto &clause : clauses.assertions) {
+        clause = removeForalls(*clause, clauses.introducedVariables);
+    }
+    for (const auto &clause : header) {
+        clauses.header.push_back(
+            removeForalls(*clause, clauses.introducedVariables));
+    }
+    for (const auto &clause : footer) {
+        clauses.assertions.push_back(
+            removeForalls(*clause, clauses.introducedVariables));
+    }
+    return clauses;
+}
+
 std::vector<smt::SharedSMTRef>
 cegarDriver(MonoPair<llvm::Module &> modules,
             AnalysisResultsMap &analysisResults,
@@ -422,6 +461,9 @@ cegarDriver(MonoPair<llvm::Module &> modules,
     z3::solver z3Solver(z3Cxt);
     // We start by assuming equivalence and change it to non equivalence
     LlreveResult result = LlreveResult::Equivalent;
+    // Only the declarations of the invariants change between iterations, the
+    // remaining clauses are regenerated after loop transformations
+    std::unique_ptr<CandidateIndependentClauses> independentClauses;
     do {
         Mark cexStartMark(
             static_cast<int>(vals.values.at("INV_INDEX_START").get_si()));
@@ -457,6 +499,7 @@ cegarDriver(MonoPair<llvm::Module &> modules,
                 dynamicAnalysisResults, analysisResults, instrNameMap,
                 blockNameMap, patterns, degree);
             if (transformed == Transformed::Yes) {
+                independentClauses = nullptr;
                 continue;
             }
         } else if (vals.functions.first && vals.functions.second) {
@@ -495,25 +538,39 @@ cegarDriver(MonoPair<llvm::Module &> modules,
             relationalFunctionInvariantCandidates;
         SMTGenerationOpts::getInstance().FunctionalFunctionalInvariants =
             functionInvariantCandidates;
-        vector<SharedSMTRef> clauses =
-            generateSMT(modules, analysisResults, fileOpts);
+        if (!independentClauses) {
+            independentClauses = make_unique<CandidateIndependentClauses>(
+                candidateIndependentClauses(modules, analysisResults,
+                                            fileOpts));
+        }
         z3Solver.reset();
         llvm::StringMap<z3::expr> nameMap;
         llvm::StringMap<smt::Z3DefineFun> defineFunMap;
-        vector<SharedSMTRef> z3Clauses;
-        set<SortedVar> introducedVariables;
-        for (const auto &clause : clauses) {
-            z3Clauses.push_back(removeForalls(*clause, introducedVariables));
+        // The candidate invariants change in every iteration so translations
+        // are only shared between the clauses of one iteration
+        smt::Z3TranslationCache translationCache;
+        vector<SharedSMTRef> z3Clauses = independentClauses->header;
+        set<SortedVar> introducedVariables =
+            independentClauses->introducedVariables;
+        for (const auto &declaration :
+             generateInvariantDeclarations(modules, analysisResults)) {
+            z3Clauses.push_back(
+                removeForalls(*declaration, introducedVariables));
         }
+        z3Clauses.insert(z3Clauses.end(),
+                         independentClauses->assertions.begin(),
+                         independentClauses->assertions.end());
         vector<SharedSMTRef> introducedClauses;
         for (const auto &var : introducedVariables) {
             introducedClauses.push_back(make_unique<VarDecl>(var));
-            VarDecl(var).toZ3(z3Cxt, z3Solver, nameMap, defineFunMap);
+            VarDecl(var).toZ3(z3Cxt, z3Solver, nameMap, defineFunMap,
+                              translationCache);
         }
         z3Clauses.insert(z3Clauses.begin(), introducedClauses.begin(),
                          introducedClauses.end());
         for (const auto &clause : z3Clauses) {
-            clause->toZ3(z3Cxt, z3Solver, nameMap, defineFunMap);
+            clause->toZ3(z3Cxt, z3Solver, nameMap, defineFunMap,
+                         translationCache);
         }
         if (DumpIntermediateSMTFlag) {
             serializeSMT(z3Clauses, false,
@@ -716,6 +773,9 @@ bool applyLoopTransformation(
             break;
         }
     }
+    // The interpreter has to lower the transformed functions again
+    forgetBytecode(*functions.first);
+    forgetBytecode(*functions.second);
     // Update path analysis
     analysisResults.at(functions.first).paths = findPaths(marks.first);
     analysisResults.at(functions.second).paths = findPaths(marks.second);
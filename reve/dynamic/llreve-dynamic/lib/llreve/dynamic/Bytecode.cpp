@@ -0,0 +1,410 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#include "llreve/dynamic/Bytecode.h"
+
+#include "Helper.h"
+#include "Opts.h"
+
+#include <memory>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+using llvm::BasicBlock;
+using llvm::BinaryOperator;
+using llvm::BranchInst;
+using llvm::CastInst;
+using llvm::CmpInst;
+using llvm::ConstantInt;
+using llvm::Function;
+using llvm::GetElementPtrInst;
+using llvm::ICmpInst;
+using llvm::Instruction;
+using llvm::PHINode;
+using llvm::ReturnInst;
+using llvm::SwitchInst;
+using llvm::Value;
+using llvm::dyn_cast;
+using llvm::isa;
+
+using std::unique_ptr;
+using std::vector;
+
+using namespace llreve::opts;
+
+namespace llreve {
+namespace dynamic {
+
+// Used for operands that can’t be interpreted
+static const Register InvalidRegister = ~0u;
+
+static bool hasRegister(const Instruction &instr) {
+    // Return instructions store the return value, calls of void functions
+    // store the value returned by the callee
+    return !instr.getType()->isVoidTy() || isa<ReturnInst>(instr) ||
+           isa<llvm::CallInst>(instr);
+}
+
+// Pointers are treated as 64 bit integers
+static unsigned bitWidth(const llvm::Type &type) {
+    return type.isIntegerTy() ? type.getIntegerBitWidth() : 64;
+}
+
+static bool opcodeForBinOp(const BinaryOperator &binOp, Opcode &opcode) {
+    if (binOp.getType()->getIntegerBitWidth() == 1) {
+        switch (binOp.getOpcode()) {
+        case Instruction::Or:
+            opcode = Opcode::BoolOr;
+            return true;
+        case Instruction::And:
+            opcode = Opcode::BoolAnd;
+            return true;
+        case Instruction::Xor:
+            opcode = Opcode::BoolXor;
+            return true;
+        default:
+            return false;
+        }
+    }
+    switch (binOp.getOpcode()) {
+    case Instruction::Add:
+        opcode = Opcode::Add;
+        return true;
+    case Instruction::Sub:
+        opcode = Opcode::Sub;
+        return true;
+    case Instruction::Mul:
+        opcode = Opcode::Mul;
+        return true;
+    case Instruction::SDiv:
+        opcode = Opcode::SDiv;
+        return true;
+    case Instruction::UDiv:
+        opcode = Opcode::UDiv;
+        return true;
+    case Instruction::SRem:
+        opcode = Opcode::SRem;
+        return true;
+    case Instruction::URem:
+        opcode = Opcode::URem;
+        return true;
+    case Instruction::Shl:
+        opcode = Opcode::Shl;
+        return true;
+    case Instruction::LShr:
+        opcode = Opcode::LShr;
+        return true;
+    case Instruction::AShr:
+        opcode = Opcode::AShr;
+        return true;
+    case Instruction::And:
+        opcode = Opcode::And;
+        return true;
+    case Instruction::Or:
+        opcode = Opcode::Or;
+        return true;
+    case Instruction::Xor:
+        opcode = Opcode::Xor;
+        return true;
+    default:
+        return false;
+    }
+}
+
+namespace {
+class BytecodeBuilder {
+    Bytecode &code;
+
+  public:
+    explicit BytecodeBuilder(Bytecode &code) : code(code) {}
+
+    void build(const Function &fun) {
+        code.function = &fun;
+        for (const auto &arg : fun.args()) {
+            addVariable(&arg);
+        }
+        for (const auto &block : fun) {
+            code.blockIndices.insert(
+                {&block, static_cast<unsigned>(code.blocks.size())});
+            code.blocks.push_back({&block, 0, 0});
+            for (const auto &instr : block) {
+                if (hasRegister(instr)) {
+                    addVariable(&instr);
+                }
+            }
+        }
+        for (auto &block : code.blocks) {
+            block.firstInstr = static_cast<unsigned>(code.instrs.size());
+            for (const auto &instr : *block.block) {
+                if (isa<PHINode>(instr)) {
+                    // Phi nodes are lowered to moves on the incoming edges
+                    continue;
+                }
+                if (instr.isTerminator()) {
+                    lowerTerminator(instr);
+                } else {
+                    lowerInstruction(instr);
+                }
+            }
+            block.endInstr = static_cast<unsigned>(code.instrs.size());
+        }
+    }
+
+  private:
+    void addVariable(const Value *val) {
+        code.registers.insert(
+            {val, static_cast<Register>(code.variables.size())});
+        code.variables.push_back(val);
+        code.initialRegisters.emplace_back();
+    }
+
+    Register constant(Integer val) {
+        code.initialRegisters.push_back(std::move(val));
+        return static_cast<Register>(code.initialRegisters.size() - 1);
+    }
+
+    Register operand(const Value *val) {
+        auto it = code.registers.find(val);
+        if (it != code.registers.end()) {
+            return it->second;
+        }
+        Register reg = InvalidRegister;
+        if (const auto constInt = dyn_cast<ConstantInt>(val)) {
+            if (constInt->getBitWidth() == 1 ||
+                SMTGenerationOpts::getInstance().BitVect) {
+                reg = constant(Integer(constInt->getValue()));
+            } else {
+                reg = constant(Integer(mpz_class(constInt->getSExtValue())));
+            }
+        } else if (isa<llvm::ConstantPointerNull>(val)) {
+            reg = constant(Integer(makeBoundedInt(64, 0)));
+        } else {
+            return InvalidRegister;
+        }
+        code.registers.insert({val, reg});
+        return reg;
+    }
+
+    Register result(const Instruction &instr) {
+        return hasRegister(instr) ? code.registers.find(&instr)->second
+                                  : InvalidRegister;
+    }
+
+    void emit(Opcode opcode, const Instruction &instr,
+              llvm::ArrayRef<Register> operands, unsigned immediate = 0) {
+        for (const auto reg : operands) {
+            if (reg == InvalidRegister) {
+                emitUnsupportedOperand(instr);
+                return;
+            }
+        }
+        code.instrs.push_back({opcode, result(instr),
+                               static_cast<unsigned>(code.operands.size()),
+                               static_cast<unsigned>(operands.size()),
+                               immediate, &instr});
+        code.operands.insert(code.operands.end(), operands.begin(),
+                             operands.end());
+    }
+
+    void emitUnsupportedOperand(const Instruction &instr) {
+        for (const auto &op : instr.operands()) {
+            const Value *val = op.get();
+            if (!isa<BasicBlock>(val) && !isa<Function>(val) &&
+                operand(val) == InvalidRegister) {
+                code.instrs.push_back({Opcode::UnsupportedOperand,
+                                       InvalidRegister, 0, 0, 0, val});
+                return;
+            }
+        }
+        emitUnsupported(instr);
+    }
+
+    void emitUnsupported(const Instruction &instr) {
+        code.instrs.push_back(
+            {Opcode::UnsupportedInstruction, InvalidRegister, 0, 0, 0, &instr});
+    }
+
+    Register edge(const BasicBlock &from, const BasicBlock &to) {
+        BytecodeEdge edge{code.blockIndices.find(&to)->second,
+                          static_cast<unsigned>(code.moves.size()), 0,
+                          nullptr};
+        for (const auto &instr : to) {
+            const auto phi = dyn_cast<PHINode>(&instr);
+            if (!phi) {
+                break;
+            }
+            const Value *incoming = phi->getIncomingValueForBlock(&from);
+            Register reg = operand(incoming);
+            if (reg == InvalidRegister) {
+                if (edge.unsupported == nullptr) {
+                    edge.unsupported = incoming;
+                }
+                continue;
+            }
+            code.moves.push_back({code.registers.find(phi)->second, reg});
+            ++edge.numMoves;
+        }
+        code.edges.push_back(edge);
+        return static_cast<Register>(code.edges.size() - 1);
+    }
+
+    void lowerInstruction(const Instruction &instr) {
+        if (const auto binOp = dyn_cast<BinaryOperator>(&instr)) {
+            Opcode opcode;
+            if (!opcodeForBinOp(*binOp, opcode)) {
+                emitUnsupported(instr);
+                return;
+            }
+            emit(opcode, instr,
+                 {operand(binOp->getOperand(0)),
+                  operand(binOp->getOperand(1))});
+        } else if (const auto icmp = dyn_cast<ICmpInst>(&instr)) {
+            emit(Opcode::ICmp, instr,
+                 {operand(icmp->getOperand(0)), operand(icmp->getOperand(1))},
+                 icmp->getPredicate());
+        } else if (const auto cast = dyn_cast<CastInst>(&instr)) {
+            lowerCast(*cast);
+        } else if (const auto gep = dyn_cast<GetElementPtrInst>(&instr)) {
+            lowerGEP(*gep);
+        } else if (const auto load = dyn_cast<llvm::LoadInst>(&instr)) {
+            emit(Opcode::Load, instr, {operand(load->getPointerOperand())},
+                 bitWidth(*load->getType()));
+        } else if (const auto store = dyn_cast<llvm::StoreInst>(&instr)) {
+            emit(Opcode::Store, instr,
+                 {operand(store->getPointerOperand()),
+                  operand(store->getValueOperand())},
+                 bitWidth(*store->getValueOperand()->getType()));
+        } else if (const auto select = dyn_cast<llvm::SelectInst>(&instr)) {
+            emit(Opcode::Select, instr,
+                 {operand(select->getCondition()),
+                  operand(select->getTrueValue()),
+                  operand(select->getFalseValue())});
+        } else if (const auto call = dyn_cast<llvm::CallInst>(&instr)) {
+            vector<Register> args;
+            for (const auto &arg : call->arg_operands()) {
+                args.push_back(operand(arg));
+            }
+            emit(Opcode::Call, instr, args);
+        } else {
+            emitUnsupported(instr);
+        }
+    }
+
+    void lowerCast(const CastInst &cast) {
+        const Register op = operand(cast.getOperand(0));
+        const unsigned width = bitWidth(*cast.getType());
+        if (cast.getSrcTy()->isIntegerTy(1) &&
+            cast.getDestTy()->getIntegerBitWidth() > 1) {
+            emit(Opcode::BoolToInt, cast, {op}, width);
+        } else if (isa<llvm::ZExtInst>(cast)) {
+            emit(Opcode::ZExt, cast, {op}, width);
+        } else if (isa<llvm::SExtInst>(cast)) {
+            emit(Opcode::SExt, cast, {op}, width);
+        } else if (isa<llvm::TruncInst>(cast) ||
+                   isa<llvm::PtrToIntInst>(cast) ||
+                   isa<llvm::IntToPtrInst>(cast)) {
+            emit(Opcode::ZExtOrTrunc, cast, {op}, width);
+        } else {
+            emitUnsupported(cast);
+        }
+    }
+
+    // The offsets of constant indices are summed up here, only the variable
+    // indices are scaled by the interpreter
+    void lowerGEP(const GetElementPtrInst &gep) {
+        const auto &layout = gep.getModule()->getDataLayout();
+        const auto type = gep.getSourceElementType();
+        Integer constantOffset = Integer(mpz_class(0)).asPointer();
+        vector<Register> operands = {operand(gep.getPointerOperand())};
+        vector<Register> variableIndices;
+        vector<Value *> indices;
+        for (auto ix = gep.idx_begin(), e = gep.idx_end(); ix != e; ++ix) {
+            Value *indexValue = *ix;
+            indices.push_back(indexValue);
+            const auto indexedType =
+                GetElementPtrInst::getIndexedType(type, indices);
+            const Integer scale =
+                Integer(mpz_class(typeSize(indexedType, layout))).asPointer();
+            const Register index = operand(indexValue);
+            if (isa<ConstantInt>(indexValue)) {
+                const Integer &val = code.initialRegisters[index];
+                constantOffset +=
+                    scale * Integer(val.asUnbounded()).asPointer();
+            } else {
+                variableIndices.push_back(index);
+                variableIndices.push_back(constant(scale));
+            }
+        }
+        operands.push_back(constant(std::move(constantOffset)));
+        operands.insert(operands.end(), variableIndices.begin(),
+                        variableIndices.end());
+        emit(Opcode::GEP, gep, operands);
+    }
+
+    void lowerTerminator(const Instruction &instr) {
+        const BasicBlock &block = *instr.getParent();
+        if (const auto retInst = dyn_cast<ReturnInst>(&instr)) {
+            if (retInst->getReturnValue() == nullptr) {
+                emit(Opcode::Ret, instr, {constant(Integer(mpz_class(0)))});
+            } else {
+                emit(Opcode::Ret, instr, {operand(retInst->getReturnValue())});
+            }
+        } else if (const auto branchInst = dyn_cast<BranchInst>(&instr)) {
+            if (branchInst->isUnconditional()) {
+                emit(Opcode::Br, instr,
+                     {edge(block, *branchInst->getSuccessor(0))});
+            } else {
+                emit(Opcode::CondBr, instr,
+                     {operand(branchInst->getCondition()),
+                      edge(block, *branchInst->getSuccessor(0)),
+                      edge(block, *branchInst->getSuccessor(1))});
+            }
+        } else if (const auto switchInst = dyn_cast<SwitchInst>(&instr)) {
+            vector<Register> operands = {
+                operand(switchInst->getCondition()),
+                edge(block, *switchInst->getDefaultDest())};
+            for (auto c : switchInst->cases()) {
+                if (SMTGenerationOpts::getInstance().BitVect) {
+                    operands.push_back(
+                        constant(Integer(c.getCaseValue()->getValue())));
+                } else {
+                    operands.push_back(constant(Integer(
+                        mpz_class(c.getCaseValue()->getSExtValue()))));
+                }
+                operands.push_back(edge(block, *c.getCaseSuccessor()));
+            }
+            emit(Opcode::Switch, instr, operands);
+        } else {
+            code.instrs.push_back({Opcode::UnsupportedTerminator,
+                                   InvalidRegister, 0, 0, 0, &instr});
+        }
+    }
+};
+}
+
+static llvm::DenseMap<const Function *, unique_ptr<Bytecode>> bytecodeCache;
+
+const Bytecode &getBytecode(const Function &fun) {
+    auto it = bytecodeCache.find(&fun);
+    if (it != bytecodeCache.end()) {
+        return *it->second;
+    }
+    auto code = std::make_unique<Bytecode>();
+    BytecodeBuilder(*code).build(fun);
+    const Bytecode &ref = *code;
+    bytecodeCache.insert({&fun, std::move(code)});
+    return ref;
+}
+
+void forgetBytecode(const Function &fun) { bytecodeCache.erase(&fun); }
+}
+}
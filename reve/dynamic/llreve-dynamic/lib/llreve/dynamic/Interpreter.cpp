@@ -12,30 +12,10 @@
 
 #include "Compat.h"
 #include "Helper.h"
+#include "llreve/dynamic/Bytecode.h"
 
-#include "llvm/IR/Constants.h"
-
-using llvm::Argument;
-using llvm::BasicBlock;
-using llvm::BinaryOperator;
-using llvm::BranchInst;
-using llvm::CastInst;
 using llvm::CmpInst;
-using llvm::ConstantInt;
 using llvm::Function;
-using llvm::GetElementPtrInst;
-using llvm::ICmpInst;
-using llvm::Instruction;
-using llvm::LoadInst;
-using llvm::PHINode;
-using llvm::ReturnInst;
-using llvm::SelectInst;
-using llvm::StoreInst;
-using llvm::SwitchInst;
-using llvm::TerminatorInst;
-using llvm::Value;
-using llvm::dyn_cast;
-using llvm::isa;
 
 using std::function;
 using std::make_shared;
@@ -124,34 +104,110 @@ MonoPair<FastCall> interpretFunctionPair(
                           startBlocks.second, maxSteps, analysisResults));
 }
 
+namespace {
+// The registers of a function that is being interpreted
+struct Frame {
+    const Bytecode &code;
+    vector<Integer> registers;
+    // The assigned variables as they are recorded in the trace. This is only
+    // brought up to date when a state is recorded, so most assignments don’t
+    // touch it.
+    mutable FastVarMap variables;
+    mutable vector<Register> modified;
+    Heap heap;
+    Frame(const Bytecode &code, const FastState &entry)
+        : code(code), registers(code.initialRegisters), heap(entry.heap) {
+        for (const auto &var : entry.variables) {
+            auto it = code.registers.find(var.first);
+            if (it == code.registers.end() ||
+                it->second >= code.variables.size()) {
+                logErrorData("Not a variable of the interpreted function:\n",
+                             *var.first);
+                exit(1);
+            }
+            set(it->second, var.second);
+        }
+    }
+    const Integer &operand(const BytecodeInstr &instr, unsigned i) const {
+        return registers[code.operands[instr.firstOperand + i]];
+    }
+    void set(Register reg, Integer val) {
+        registers[reg] = std::move(val);
+        modified.push_back(reg);
+    }
+    FastState state() const {
+        for (const auto reg : modified) {
+            insertOrReplace(variables, {code.variables[reg], registers[reg]});
+        }
+        modified.clear();
+        return FastState(variables, heap);
+    }
+};
+
+// Used instead of an edge index when a function returns
+const unsigned NoEdge = ~0u;
+
+struct BlockResult {
+    // State after phi nodes
+    FastState step;
+    unsigned nextEdge;
+    // function calls in this block in the order they were called
+    vector<FastCall> calls;
+    // Indicates a stop because we ran out of steps
+    bool earlyExit;
+    // steps this block has needed, if there are no function calls exactly one
+    // step per block is needed
+    uint32_t blocksVisited;
+    BlockResult(FastState step, unsigned nextEdge, vector<FastCall> calls,
+                bool earlyExit, uint32_t blocksVisited)
+        : step(std::move(step)), nextEdge(nextEdge), calls(std::move(calls)),
+          earlyExit(earlyExit), blocksVisited(blocksVisited) {}
+};
+}
+
+static void interpretPhiMoves(const BytecodeEdge &edge, Frame &frame);
+static BlockResult interpretBlock(const BytecodeBlock &block, Frame &frame,
+                                  uint32_t maxSteps,
+                                  const AnalysisResultsMap &analysisResults);
+static void interpretInstruction(const BytecodeInstr &instr, Frame &frame);
+static unsigned interpretTerminator(const BytecodeInstr &instr, Frame &frame);
+static bool interpretPredicate(const BytecodeInstr &instr, const Integer &i0,
+                               const Integer &i1);
+
 FastCall interpretFunction(const Function &fun, FastState entry,
                            const llvm::BasicBlock *startBlock,
                            uint32_t maxSteps,
                            const AnalysisResultsMap &analysisResults) {
-    const BasicBlock *prevBlock = nullptr;
-    const BasicBlock *currentBlock = startBlock;
+    const Bytecode &code = getBytecode(fun);
+    Frame frame(code, entry);
     vector<BlockStep<const llvm::Value *>> steps;
-    FastState currentState = entry;
-    BlockUpdate<const llvm::Value *> update;
+    // The phi nodes of the start block are part of the entry state
+    const BytecodeEdge *incoming = nullptr;
+    unsigned blockIndex = code.blockIndices.find(startBlock)->second;
     uint32_t blocksVisited = 0;
-    bool firstBlock = true;
-    do {
-        update =
-            interpretBlock(*currentBlock, prevBlock, currentState, firstBlock,
-                           maxSteps - blocksVisited, analysisResults);
-        firstBlock = false;
-        blocksVisited += update.blocksVisited;
-        steps.emplace_back(currentBlock->getName(), std::move(update.step),
-                           std::move(update.calls));
-        prevBlock = currentBlock;
-        currentBlock = update.nextBlock;
-        if (blocksVisited > maxSteps || update.earlyExit) {
-            return FastCall(&fun, std::move(entry), std::move(currentState),
+    while (true) {
+        if (incoming != nullptr) {
+            interpretPhiMoves(*incoming, frame);
+        }
+        const BytecodeBlock &block = code.blocks[blockIndex];
+        BlockResult result = interpretBlock(block, frame,
+                                            maxSteps - blocksVisited,
+                                            analysisResults);
+        blocksVisited += result.blocksVisited;
+        steps.emplace_back(block.block->getName(), std::move(result.step),
+                           std::move(result.calls));
+        if (blocksVisited > maxSteps || result.earlyExit) {
+            return FastCall(&fun, std::move(entry), frame.state(),
                             std::move(steps), true, blocksVisited);
         }
-    } while (currentBlock != nullptr);
-    return FastCall(&fun, std::move(entry), std::move(currentState),
-                    std::move(steps), false, blocksVisited);
+        if (result.nextEdge == NoEdge) {
+            break;
+        }
+        incoming = &code.edges[result.nextEdge];
+        blockIndex = incoming->block;
+    }
+    return FastCall(&fun, std::move(entry), frame.state(), std::move(steps),
+                    false, blocksVisited);
 }
 
 FastCall interpretFunction(const Function &fun, FastState entry,
@@ -161,413 +217,281 @@ FastCall interpretFunction(const Function &fun, FastState entry,
                              analysisResults);
 }
 
-BlockUpdate<const llvm::Value *>
-interpretBlock(const BasicBlock &block, const BasicBlock *prevBlock,
-               FastState &state, bool skipPhi, uint32_t maxSteps,
-               const AnalysisResultsMap &analysisResults) {
-    uint32_t blocksVisited = 1;
-    const Instruction *firstNonPhi = block.getFirstNonPHI();
-    const Instruction *terminator = block.getTerminator();
-    // Handle phi instructions
-    BasicBlock::const_iterator instrIterator;
-    for (instrIterator = block.begin(); &*instrIterator != firstNonPhi;
-         ++instrIterator) {
-        const Instruction *inst = &*instrIterator;
-        assert(isa<PHINode>(inst));
-        if (!skipPhi) {
-            interpretPHI(*dyn_cast<PHINode>(inst), state, prevBlock);
-        }
+static void interpretPhiMoves(const BytecodeEdge &edge, Frame &frame) {
+    if (edge.unsupported != nullptr) {
+        logErrorData("Operators are not yet handled\n", *edge.unsupported);
+        exit(1);
     }
-    FastState step(state);
+    const auto moves = llvm::makeArrayRef(frame.code.moves)
+                           .slice(edge.firstMove, edge.numMoves);
+    // Phi nodes are evaluated in order and can see the values assigned by
+    // the previous ones
+    for (const auto &move : moves) {
+        frame.set(move.to, frame.registers[move.from]);
+    }
+}
 
+static BlockResult interpretBlock(const BytecodeBlock &block, Frame &frame,
+                                  uint32_t maxSteps,
+                                  const AnalysisResultsMap &analysisResults) {
+    uint32_t blocksVisited = 1;
+    FastState step = frame.state();
     vector<FastCall> calls;
-    // Handle non phi instructions
-    for (; &*instrIterator != terminator; ++instrIterator) {
-        if (const auto call = dyn_cast<llvm::CallInst>(&*instrIterator)) {
-            const Function *fun = call->getCalledFunction();
-            FastVarMap args;
-            auto argIt = fun->arg_begin();
-            for (const auto &arg : call->arg_operands()) {
-                args.insert(std::make_pair(
-                    &*argIt, resolveValue(arg, state, arg->getType())));
-                ++argIt;
-            }
-            FastCall c =
-                interpretFunction(*fun, FastState(args, state.heap),
-                                  maxSteps - blocksVisited, analysisResults);
-            blocksVisited += c.blocksVisited;
-            if (blocksVisited > maxSteps || c.earlyExit) {
-                return BlockUpdate<const llvm::Value *>(
-                    std::move(step), nullptr, std::move(calls), true,
-                    blocksVisited);
-            }
-            state.heap = c.returnState.heap;
-            insertOrReplace(
-                state.variables,
-                {call, c.returnState.variables
-                           .find(analysisResults.at(fun).returnInstruction)
-                           ->second});
-            calls.push_back(std::move(c));
-        } else {
-            interpretInstruction(&*instrIterator, state);
+    const unsigned terminator = block.endInstr - 1;
+    for (unsigned i = block.firstInstr; i < terminator; ++i) {
+        const BytecodeInstr &instr = frame.code.instrs[i];
+        if (instr.opcode != Opcode::Call) {
+            interpretInstruction(instr, frame);
+            continue;
+        }
+        const Function *fun =
+            llvm::cast<llvm::CallInst>(instr.origin)->getCalledFunction();
+        FastVarMap args;
+        auto argIt = fun->arg_begin();
+        for (unsigned j = 0; j < instr.numOperands; ++j, ++argIt) {
+            args.insert(std::make_pair(&*argIt, frame.operand(instr, j)));
+        }
+        FastCall c = interpretFunction(*fun, FastState(args, frame.heap),
+                                       maxSteps - blocksVisited,
+                                       analysisResults);
+        blocksVisited += c.blocksVisited;
+        if (blocksVisited > maxSteps || c.earlyExit) {
+            return BlockResult(std::move(step), NoEdge, std::move(calls),
+                               true, blocksVisited);
         }
+        frame.heap = c.returnState.heap;
+        frame.set(instr.result,
+                  c.returnState.variables
+                      .find(analysisResults.at(fun).returnInstruction)
+                      ->second);
+        calls.push_back(std::move(c));
     }
-
-    // Terminator instruction
-    TerminatorUpdate update = interpretTerminator(block.getTerminator(), state);
-
-    return BlockUpdate<const llvm::Value *>(std::move(step), update.nextBlock,
-                                            std::move(calls), false,
-                                            blocksVisited);
+    const unsigned nextEdge =
+        interpretTerminator(frame.code.instrs[terminator], frame);
+    return BlockResult(std::move(step), nextEdge, std::move(calls), false,
+                       blocksVisited);
 }
 
-void interpretInstruction(const Instruction *instr, FastState &state) {
-    if (const auto binOp = dyn_cast<BinaryOperator>(instr)) {
-        interpretBinOp(binOp, state);
-    } else if (const auto icmp = dyn_cast<ICmpInst>(instr)) {
-        interpretICmpInst(icmp, state);
-    } else if (const auto cast = dyn_cast<CastInst>(instr)) {
-        assert(cast->getNumOperands() == 1);
-        if (cast->getSrcTy()->isIntegerTy(1) &&
-            cast->getDestTy()->getIntegerBitWidth() > 1) {
-            // Convert a bool to an integer
-            Integer operand = state.variables.find(cast->getOperand(0))->second;
-            if (SMTGenerationOpts::getInstance().BitVect) {
-                insertOrReplace(
-                    state.variables,
-                    {cast, Integer(makeBoundedInt(
-                               cast->getType()->getIntegerBitWidth(),
-                               unsafeBool(operand) ? 1 : 0))});
-            } else {
-                insertOrReplace(
-                    state.variables,
-                    {cast, Integer(mpz_class(unsafeBool(operand) ? 1 : 0))});
-            }
+static void interpretInstruction(const BytecodeInstr &instr, Frame &frame) {
+    const auto op = [&](unsigned i) -> const Integer & {
+        return frame.operand(instr, i);
+    };
+    switch (instr.opcode) {
+    case Opcode::Add:
+        frame.set(instr.result, op(0) + op(1));
+        break;
+    case Opcode::Sub:
+        frame.set(instr.result, op(0) - op(1));
+        break;
+    case Opcode::Mul:
+        frame.set(instr.result, op(0) * op(1));
+        break;
+    case Opcode::SDiv:
+        frame.set(instr.result, op(0).sdiv(op(1)));
+        break;
+    case Opcode::UDiv:
+        frame.set(instr.result, op(0).udiv(op(1)));
+        break;
+    case Opcode::SRem:
+        frame.set(instr.result, op(0).srem(op(1)));
+        break;
+    case Opcode::URem:
+        frame.set(instr.result, op(0).urem(op(1)));
+        break;
+    case Opcode::Shl:
+        frame.set(instr.result, op(0).shl(op(1)));
+        break;
+    case Opcode::LShr:
+        frame.set(instr.result, op(0).lshr(op(1)));
+        break;
+    case Opcode::AShr:
+        frame.set(instr.result, op(0).ashr(op(1)));
+        break;
+    case Opcode::And:
+        frame.set(instr.result, op(0).and_(op(1)));
+        break;
+    case Opcode::Or:
+        frame.set(instr.result, op(0).or_(op(1)));
+        break;
+    case Opcode::Xor:
+        frame.set(instr.result, op(0).xor_(op(1)));
+        break;
+    case Opcode::BoolAnd:
+        frame.set(instr.result,
+                  Integer(unsafeBool(op(0)) && unsafeBool(op(1))));
+        break;
+    case Opcode::BoolOr:
+        frame.set(instr.result,
+                  Integer(unsafeBool(op(0)) || unsafeBool(op(1))));
+        break;
+    case Opcode::BoolXor:
+        frame.set(instr.result,
+                  Integer(unsafeBool(op(0)) != unsafeBool(op(1))));
+        break;
+    case Opcode::ICmp:
+        frame.set(instr.result,
+                  Integer(interpretPredicate(instr, op(0), op(1))));
+        break;
+    case Opcode::BoolToInt:
+        // Convert a bool to an integer
+        if (SMTGenerationOpts::getInstance().BitVect) {
+            frame.set(instr.result, Integer(makeBoundedInt(
+                                        instr.immediate,
+                                        unsafeBool(op(0)) ? 1 : 0)));
         } else {
-            if (const auto zext = dyn_cast<llvm::ZExtInst>(instr)) {
-                insertOrReplace(
-                    state.variables,
-                    {zext,
-                     resolveValue(zext->getOperand(0), state, zext->getType())
-                         .zext(zext->getType()->getIntegerBitWidth())});
-            } else if (const auto sext = dyn_cast<llvm::SExtInst>(instr)) {
-                insertOrReplace(
-                    state.variables,
-                    {sext,
-                     resolveValue(sext->getOperand(0), state, sext->getType())
-                         .sext(sext->getType()->getIntegerBitWidth())});
-            } else if (const auto trunc = dyn_cast<llvm::TruncInst>(instr)) {
-                insertOrReplace(
-                    state.variables,
-                    {trunc,
-                     resolveValue(trunc->getOperand(0), state, trunc->getType())
-                         .zextOrTrunc(trunc->getType()->getIntegerBitWidth())});
-            } else if (const auto ptrToInt =
-                           dyn_cast<llvm::PtrToIntInst>(instr)) {
-                insertOrReplace(
-                    state.variables,
-                    {ptrToInt,
-                     resolveValue(ptrToInt->getPointerOperand(), state,
-                                  ptrToInt->getPointerOperand()->getType())
-                         .zextOrTrunc(
-                             ptrToInt->getType()->getIntegerBitWidth())});
-            } else if (const auto intToPtr =
-                           dyn_cast<llvm::IntToPtrInst>(instr)) {
-                insertOrReplace(
-                    state.variables,
-                    {ptrToInt, resolveValue(intToPtr->getOperand(0), state,
-                                            intToPtr->getOperand(0)->getType())
-                                   .zextOrTrunc(64)});
-            } else {
-                logErrorData("Unsupported instruction:\n", *instr);
-                exit(1);
-            }
+            frame.set(instr.result,
+                      Integer(mpz_class(unsafeBool(op(0)) ? 1 : 0)));
+        }
+        break;
+    case Opcode::ZExt:
+        frame.set(instr.result, Integer(op(0)).zext(instr.immediate));
+        break;
+    case Opcode::SExt:
+        frame.set(instr.result, Integer(op(0)).sext(instr.immediate));
+        break;
+    case Opcode::ZExtOrTrunc:
+        frame.set(instr.result, Integer(op(0)).zextOrTrunc(instr.immediate));
+        break;
+    case Opcode::GEP: {
+        Integer offset = op(0);
+        offset += op(1);
+        for (unsigned i = 2; i < instr.numOperands; i += 2) {
+            offset += op(i + 1) * Integer(op(i).asUnbounded()).asPointer();
         }
-    } else if (const auto gep = dyn_cast<GetElementPtrInst>(instr)) {
-        insertOrReplace(state.variables, {gep, resolveGEP(*gep, state)});
-    } else if (const auto load = dyn_cast<LoadInst>(instr)) {
-        Integer ptr = resolveValue(load->getPointerOperand(), state,
-                                   load->getPointerOperand()->getType());
+        frame.set(instr.result, std::move(offset));
+        break;
+    }
+    case Opcode::Load: {
+        const Integer &ptr = op(0);
+        Heap &heap = frame.heap;
         // This will only insert 0 if there is not already a different element
         if (SMTGenerationOpts::getInstance().BitVect) {
-            unsigned bytes = load->getType()->getIntegerBitWidth() / 8;
-            llvm::APInt val =
-                makeBoundedInt(load->getType()->getIntegerBitWidth(), 0);
+            unsigned bytes = instr.immediate / 8;
+            llvm::APInt val = makeBoundedInt(instr.immediate, 0);
             for (unsigned i = 0; i < bytes; ++i) {
-                auto heapIt = state.heap.assignedValues.insert(std::make_pair(
+                auto heapIt = heap.assignedValues.insert(std::make_pair(
                     ptr.asPointer() + Integer(mpz_class(i)).asPointer(),
                     Integer(makeBoundedInt(
-                        8, state.heap.background.asUnbounded().get_si()))));
+                        8, heap.background.asUnbounded().get_si()))));
                 assert(heapIt.first->second.type == IntType::Bounded);
                 assert(heapIt.first->second.bounded.getBitWidth() == 8);
                 val = (val << 8) |
                       (heapIt.first->second.bounded).sextOrSelf(bytes * 8);
             }
-            insertOrReplace(state.variables, {load, Integer(val)});
+            frame.set(instr.result, Integer(val));
         } else {
-            auto heapIt = state.heap.assignedValues.insert(
-                std::make_pair(ptr.asPointer(), state.heap.background));
-            insertOrReplace(state.variables, {load, heapIt.first->second});
+            auto heapIt = heap.assignedValues.insert(
+                std::make_pair(ptr.asPointer(), heap.background));
+            frame.set(instr.result, heapIt.first->second);
         }
-    } else if (const auto store = dyn_cast<StoreInst>(instr)) {
-        HeapAddress addr = resolveValue(store->getPointerOperand(), state,
-                                        store->getPointerOperand()->getType());
-        Integer val = resolveValue(store->getValueOperand(), state,
-                                   store->getValueOperand()->getType());
+        break;
+    }
+    case Opcode::Store: {
+        const HeapAddress &addr = op(0);
+        const Integer &val = op(1);
+        Heap &heap = frame.heap;
         if (SMTGenerationOpts::getInstance().BitVect) {
-            int bytes =
-                store->getValueOperand()->getType()->getIntegerBitWidth() / 8;
+            int bytes = static_cast<int>(instr.immediate / 8);
             assert(val.type == IntType::Bounded);
             llvm::APInt bval = val.bounded;
             if (bytes == 1) {
-                state.heap.assignedValues[addr] = val;
+                heap.assignedValues[addr] = val;
             } else {
-                uint64_t i = 0;
                 for (; bytes >= 0; --bytes) {
                     llvm::APInt el = bval.trunc(8);
                     bval = bval.ashr(8);
-                    state.heap
-                        .assignedValues[addr + Integer(llvm::APInt(
+                    heap.assignedValues[addr + Integer(llvm::APInt(
                                                    64, static_cast<uint64_t>(
                                                            bytes)))] =
                         Integer(el);
-                    ++i;
                 }
             }
         } else {
-            state.heap.assignedValues[addr] = val;
-        }
-    } else if (const auto select = dyn_cast<SelectInst>(instr)) {
-        Integer cond = resolveValue(select->getCondition(), state,
-                                    select->getCondition()->getType());
-        bool condVal = unsafeBool(cond);
-        if (condVal) {
-            Integer var =
-                resolveValue(select->getTrueValue(), state, select->getType());
-            insertOrReplace(state.variables, {select, var});
-        } else {
-            Integer var =
-                resolveValue(select->getFalseValue(), state, select->getType());
-            insertOrReplace(state.variables, {select, var});
+            heap.assignedValues[addr] = val;
         }
-
-    } else {
-        logErrorData("unsupported instruction:\n", *instr);
+        break;
     }
-}
-
-void interpretPHI(const PHINode &instr, FastState &state,
-                  const BasicBlock *prevBlock) {
-    const Value *val = instr.getIncomingValueForBlock(prevBlock);
-    Integer var = resolveValue(val, state, val->getType());
-    insertOrReplace(state.variables, {&instr, var});
-}
-
-TerminatorUpdate interpretTerminator(const TerminatorInst *instr,
-                                     FastState &state) {
-    if (const auto retInst = dyn_cast<ReturnInst>(instr)) {
-        if (retInst->getReturnValue() == nullptr) {
-            insertOrReplace(state.variables, {retInst, Integer(mpz_class(0))});
-        } else {
-            insertOrReplace(
-                state.variables,
-                {retInst, resolveValue(retInst->getReturnValue(), state,
-                                       retInst->getReturnValue()->getType())});
-        }
-        return TerminatorUpdate(nullptr);
-    } else if (const auto branchInst = dyn_cast<BranchInst>(instr)) {
-        if (branchInst->isUnconditional()) {
-            assert(branchInst->getNumSuccessors() == 1);
-            return TerminatorUpdate(branchInst->getSuccessor(0));
-        } else {
-            Integer cond = resolveValue(branchInst->getCondition(), state,
-                                        branchInst->getCondition()->getType());
-            bool condVal = unsafeBool(cond);
-            assert(branchInst->getNumSuccessors() == 2);
-            if (condVal) {
-                return TerminatorUpdate(branchInst->getSuccessor(0));
-            } else {
-                return TerminatorUpdate(branchInst->getSuccessor(1));
-            }
-        }
-    } else if (const auto switchInst = dyn_cast<SwitchInst>(instr)) {
-        Integer condVal = resolveValue(switchInst->getCondition(), state,
-                                       switchInst->getCondition()->getType());
-        for (auto c : switchInst->cases()) {
-            Integer caseVal;
-            if (SMTGenerationOpts::getInstance().BitVect) {
-                caseVal = Integer(c.getCaseValue()->getValue());
-            } else {
-                caseVal = Integer(mpz_class(c.getCaseValue()->getSExtValue()));
-            }
-            if (caseVal == condVal) {
-                return TerminatorUpdate(c.getCaseSuccessor());
-            }
-        }
-        return TerminatorUpdate(switchInst->getDefaultDest());
-
-    } else {
-        logError("Only return and branches are supported\n");
-        return TerminatorUpdate(nullptr);
+    case Opcode::Select:
+        frame.set(instr.result, unsafeBool(op(0)) ? op(1) : op(2));
+        break;
+    case Opcode::UnsupportedInstruction:
+        logErrorData("Unsupported instruction:\n", *instr.origin);
+        exit(1);
+    case Opcode::UnsupportedOperand:
+        logErrorData("Operators are not yet handled\n", *instr.origin);
+        exit(1);
+    case Opcode::Call:
+    case Opcode::Ret:
+    case Opcode::Br:
+    case Opcode::CondBr:
+    case Opcode::Switch:
+    case Opcode::UnsupportedTerminator:
+        logErrorData("Not a regular instruction:\n", *instr.origin);
+        exit(1);
     }
 }
 
-Integer resolveValue(const Value *val, const FastState &state,
-                     const llvm::Type * /* unused */) {
-    if (isa<Instruction>(val) || isa<Argument>(val)) {
-        return state.variables.find(val)->second;
-    } else if (const auto constInt = dyn_cast<ConstantInt>(val)) {
-        if (constInt->getBitWidth() == 1) {
-            return Integer(constInt->getValue());
-        } else if (!SMTGenerationOpts::getInstance().BitVect) {
-            return Integer(mpz_class(constInt->getSExtValue()));
-        } else {
-            return Integer(constInt->getValue());
+static unsigned interpretTerminator(const BytecodeInstr &instr, Frame &frame) {
+    // The operands of branches following the condition are edges
+    const auto edge = [&](unsigned i) {
+        return frame.code.operands[instr.firstOperand + i];
+    };
+    switch (instr.opcode) {
+    case Opcode::Ret:
+        frame.set(instr.result, frame.operand(instr, 0));
+        return NoEdge;
+    case Opcode::Br:
+        return edge(0);
+    case Opcode::CondBr:
+        return unsafeBool(frame.operand(instr, 0)) ? edge(1) : edge(2);
+    case Opcode::Switch: {
+        const Integer &condVal = frame.operand(instr, 0);
+        for (unsigned i = 2; i < instr.numOperands; i += 2) {
+            if (frame.operand(instr, i) == condVal) {
+                return edge(i + 1);
+            }
         }
-    } else if (llvm::isa<llvm::ConstantPointerNull>(val)) {
-        return Integer(makeBoundedInt(64, 0));
+        return edge(1);
     }
-    logErrorData("Operators are not yet handled\n", *val);
-    exit(1);
-}
-
-void interpretICmpInst(const ICmpInst *instr, FastState &state) {
-    assert(instr->getNumOperands() == 2);
-    Integer op0 = resolveValue(instr->getOperand(0), state,
-                               instr->getOperand(0)->getType());
-    Integer op1 = resolveValue(instr->getOperand(1), state,
-                               instr->getOperand(0)->getType());
-    switch (instr->getPredicate()) {
+    case Opcode::UnsupportedTerminator:
+        logError("Only return and branches are supported\n");
+        return NoEdge;
+    case Opcode::UnsupportedOperand:
+        logErrorData("Operators are not yet handled\n", *instr.origin);
+        exit(1);
     default:
-        interpretIntPredicate(instr, instr->getPredicate(), std::move(op0),
-                              std::move(op1), state);
+        logErrorData("Not a terminator:\n", *instr.origin);
+        exit(1);
     }
 }
 
-void interpretIntPredicate(const ICmpInst *instr, CmpInst::Predicate pred,
-                           const Integer &i0, const Integer &i1,
-                           FastState &state) {
-    bool predVal = false;
-    switch (pred) {
+static bool interpretPredicate(const BytecodeInstr &instr, const Integer &i0,
+                               const Integer &i1) {
+    switch (static_cast<CmpInst::Predicate>(instr.immediate)) {
     case CmpInst::ICMP_EQ:
-        predVal = i0.eq(i1);
-        break;
+        return i0.eq(i1);
     case CmpInst::ICMP_NE:
-        predVal = i0.ne(i1);
-        break;
+        return i0.ne(i1);
     case CmpInst::ICMP_SGE:
-        predVal = i0.sge(i1);
-        break;
+        return i0.sge(i1);
     case CmpInst::ICMP_SGT:
-        predVal = i0.sgt(i1);
-        break;
+        return i0.sgt(i1);
     case CmpInst::ICMP_SLE:
-        predVal = i0.sle(i1);
-        break;
+        return i0.sle(i1);
     case CmpInst::ICMP_SLT:
-        predVal = i0.slt(i1);
-        break;
+        return i0.slt(i1);
     case CmpInst::ICMP_UGE:
-        predVal = i0.uge(i1);
-        break;
+        return i0.uge(i1);
     case CmpInst::ICMP_UGT:
-        predVal = i0.ugt(i1);
-        break;
+        return i0.ugt(i1);
     case CmpInst::ICMP_ULE:
-        predVal = i0.ule(i1);
-        break;
+        return i0.ule(i1);
     case CmpInst::ICMP_ULT:
-        predVal = i0.ult(i1);
-        break;
+        return i0.ult(i1);
     default:
-        logErrorData("Unsupported predicate:\n", *instr);
-    }
-    insertOrReplace(state.variables, {instr, Integer(predVal)});
-}
-
-void interpretBinOp(const BinaryOperator *instr, FastState &state) {
-    const Integer op0 = resolveValue(instr->getOperand(0), state,
-                                     instr->getOperand(0)->getType());
-    const Integer op1 = resolveValue(instr->getOperand(1), state,
-                                     instr->getOperand(1)->getType());
-    if (instr->getType()->getIntegerBitWidth() == 1) {
-        bool b0 = unsafeBool(op0);
-        bool b1 = unsafeBool(op1);
-        interpretBoolBinOp(instr, instr->getOpcode(), b0, b1, state);
-    } else {
-        interpretIntBinOp(instr, instr->getOpcode(), std::move(op0),
-                          std::move(op1), state);
-    }
-}
-
-void interpretBoolBinOp(const BinaryOperator *instr, Instruction::BinaryOps op,
-                        bool b0, bool b1, FastState &state) {
-    bool result = false;
-    switch (op) {
-    case Instruction::Or:
-        result = b0 || b1;
-        break;
-    case Instruction::And:
-        result = b0 && b1;
-        break;
-    case Instruction::Xor:
-        result = b0 ^ b1;
-        break;
-    default:
-        logErrorData("Unsupported binop:\n", *instr);
-        llvm::errs() << "\n";
-    }
-    insertOrReplace(state.variables, {instr, Integer(result)});
-}
-
-void interpretIntBinOp(const BinaryOperator *instr, Instruction::BinaryOps op,
-                       const Integer &i0, const Integer &i1, FastState &state) {
-    Integer result;
-    switch (op) {
-    case Instruction::Add:
-        result = i0 + i1;
-        break;
-    case Instruction::Sub:
-        result = i0 - i1;
-        break;
-    case Instruction::Mul:
-        result = i0 * i1;
-        break;
-    case Instruction::SDiv:
-        result = i0.sdiv(i1);
-        break;
-    case Instruction::UDiv:
-        result = i0.udiv(i1);
-        break;
-    case Instruction::SRem:
-        result = i0.srem(i1);
-        break;
-    case Instruction::URem:
-        result = i0.urem(i1);
-        break;
-    case Instruction::Shl:
-        result = i0.shl(i1);
-        break;
-    case Instruction::LShr:
-        result = i0.lshr(i1);
-        break;
-    case Instruction::AShr:
-        result = i0.ashr(i1);
-        break;
-    case Instruction::And:
-        result = i0.and_(i1);
-        break;
-    case Instruction::Or:
-        result = i0.or_(i1);
-        break;
-    case Instruction::Xor:
-        result = i0.xor_(i1);
-        break;
-    default:
-        logErrorData("Unsupported binop:\n", *instr);
-        llvm::errs() << "\n";
+        logErrorData("Unsupported predicate:\n", *instr.origin);
+        return false;
     }
-    insertOrReplace(state.variables, {instr, result});
 }
 
 bool varValEq(const Integer &lhs, const Integer &rhs) { return lhs == rhs; }
@@ -99,6 +99,8 @@ int main(int argc, const char **argv) {
                         FileName2Flag);
     PreprocessOpts preprocessOpts(ShowCFGFlag, ShowMarkedCFGFlag, false);
 
+    // Each action owns its own LLVMContext which allows compiling both
+    // programs concurrently
     std::unique_ptr<CodeGenAction> act1 =
         std::make_unique<clang::EmitLLVMOnlyAction>();
     std::unique_ptr<CodeGenAction> act2 =
@@ -0,0 +1,17 @@
+extern int __mark(int);
+
+int rotate(int **p, int n) {
+
+   int *t = p[1];
+   p[1] = p[0];
+   p[0] = t;
+
+   int i = 0;
+
+   while(__mark(42) & (i < n)) {
+      *p[0] += 1;
+      i++;
+   }
+
+   return i;
+}
@@ -0,0 +1,14 @@
+extern int __mark(int);
+int f(int x, int n) {
+  if (x > 0) {
+    return x + n;
+  }
+
+  int r = 0 - x;
+  int i = 0;
+  while (__mark(42) & (i < n)) {
+    r = r + 1;
+    i++;
+  }
+  return r;
+}
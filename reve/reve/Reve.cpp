@@ -9,11 +9,17 @@
  */
 
 #include "Compile.h"
+#include "ConeOfInfluence.h"
 #include "GitSHA1.h"
+#include "Logging.h"
 #include "ModuleSMTGeneration.h"
 #include "Opts.h"
 #include "Preprocess.h"
+#include "SMTCache.h"
 #include "Serialize.h"
+#include "Server.h"
+#include "Simplify.h"
+#include "Solve.h"
 
 #include "clang/Driver/Compilation.h"
 
@@ -21,6 +27,9 @@
 
 #include "llvm/Transforms/IPO.h"
 
+#include <fstream>
+#include <sstream>
+
 using clang::CodeGenAction;
 
 using clang::driver::ArgStringList;
@@ -30,6 +39,11 @@ using clang::driver::Driver;
 using clang::driver::JobList;
 
 using smt::SharedSMTRef;
+using smt::inlineSingleDefinitionPredicates;
+using smt::pruneUnreachableClauses;
+using smt::SimplificationStats;
+using smt::simplifyAssertion;
+using smt::simplifyAssertions;
 
 using std::make_shared;
 using std::placeholders::_1;
@@ -60,13 +74,17 @@ static llreve::cl::opt<string> ResourceDirFlag(
     llreve::cl::desc("Directory containing the clang resource files, "
                      "e.g. /usr/local/lib/clang/3.8.0"),
     llreve::cl::cat(ReveCategory));
+static llreve::cl::opt<string> PCHCacheDirFlag(
+    "pch-cache-dir",
+    llreve::cl::desc("Cache precompiled headers for the #include directives "
+                     "at the start of each input in this directory"),
+    llreve::cl::value_desc("dir"), llreve::cl::cat(ReveCategory));
+// The input files are only optional in server mode
 static llreve::cl::opt<string> FileName1Flag(llreve::cl::Positional,
                                              llreve::cl::desc("FILE1"),
-                                             llreve::cl::Required,
                                              llreve::cl::cat(ReveCategory));
 static llreve::cl::opt<string> FileName2Flag(llreve::cl::Positional,
                                              llreve::cl::desc("FILE2"),
-                                             llreve::cl::Required,
                                              llreve::cl::cat(ReveCategory));
 
 static llreve::cl::opt<string> IRFileName1(
@@ -85,6 +103,12 @@ static llreve::cl::opt<string>
                        llreve::cl::value_desc("filename"),
                        llreve::cl::cat(ReveCategory));
 
+static llreve::cl::opt<string> SMTCacheDirFlag(
+    "smt-cache-dir",
+    llreve::cl::desc("Cache the serialized SMT in this directory keyed by the "
+                     "preprocessed programs and the options"),
+    llreve::cl::value_desc("dir"), llreve::cl::cat(ReveCategory));
+
 // Preprocess flags
 static llreve::cl::opt<bool> ShowCFGFlag("show-cfg",
                                          llreve::cl::desc("Show cfg"),
@@ -174,6 +198,90 @@ static llreve::cl::opt<bool>
 static llreve::cl::opt<bool> InlineLets("inline-lets",
                                         llreve::cl::desc("Inline lets"),
                                         llreve::cl::cat(ReveCategory));
+static llreve::cl::opt<bool> SolveFlag(
+    "solve",
+    llreve::cl::desc("Solve the clauses using the Z3 API and print the result. "
+                     "Exits with 0 for EQUAL, 2 for NOT_EQUAL and 3 for "
+                     "UNKNOWN"),
+    llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<unsigned> ThreadsFlag(
+    "threads",
+    llreve::cl::desc("Number of threads used for generating the SMT of "
+                     "independent functions. The two programs are "
+                     "preprocessed concurrently, the functions of each "
+                     "program one after another"),
+    llreve::cl::init(1), llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<bool> HashConsFlag(
+    "hash-cons",
+    llreve::cl::desc("Share structurally equal subexpressions of the "
+                     "assertions while they are collected. Reduces the "
+                     "memory used for large modules at the cost of hashing "
+                     "every assertion"),
+    llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<bool> StreamFlag(
+    "stream",
+    llreve::cl::desc("Serialize the clauses while they are being generated "
+                     "instead of keeping all of them in memory. Not supported "
+                     "in combination with -muz"),
+    llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<bool> CSEFlag(
+    "cse",
+    llreve::cl::desc("Bind repeated subterms using define-fun and let. "
+                     "Implies -inline-lets. Ignored for -muz"),
+    llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<bool> SimplifyFlag(
+    "simplify",
+    llreve::cl::desc("Fold constants, simplify boolean connectives and drop "
+                     "trivially true clauses before serializing or solving"),
+    llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<bool> SimplifyStatsFlag(
+    "simplify-stats",
+    llreve::cl::desc("Print what -simplify removed to stderr"),
+    llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<bool> PruneClausesFlag(
+    "prune-clauses",
+    llreve::cl::desc("Remove clauses and predicates that cannot contribute to "
+                     "a query. Not supported in combination with -stream or "
+                     "-invert"),
+    llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<bool> InlinePredicatesFlag(
+    "inline-predicates",
+    llreve::cl::desc("Inline predicates that are defined by a single "
+                     "nonrecursive clause and used at most once. Not "
+                     "supported in combination with -stream or -invert"),
+    llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<bool> LargeBlockEncodingFlag(
+    "large-block-encoding",
+    llreve::cl::desc("Merge all paths between two marks into a single clause "
+                     "instead of emitting one clause per path"),
+    llreve::cl::cat(ReveCategory));
+
+static llreve::cl::opt<unsigned> PathBudgetFlag(
+    "path-budget",
+    llreve::cl::desc("Use the large-block encoding for functions whose "
+                     "per-path encoding needs more clauses than this. 0 "
+                     "disables the budget"),
+    llreve::cl::init(0), llreve::cl::cat(ReveCategory));
+
+// Server flags
+static llreve::cl::opt<bool> ServerFlag(
+    "server",
+    llreve::cl::desc("Read verification jobs as JSON lines from stdin"),
+    llreve::cl::cat(ReveCategory));
+static llreve::cl::opt<string> ServerSocketFlag(
+    "server-socket",
+    llreve::cl::desc("Read verification jobs as JSON lines from connections "
+                     "to the unix domain socket at the given path"),
+    llreve::cl::value_desc("path"), llreve::cl::cat(ReveCategory));
 
 static void printVersion() {
     std::cout << "llreve version " << g_GIT_SHA1 << "\n";
@@ -188,24 +296,46 @@ static void printModule(llvm::Module &mod, llvm::StringRef fileName) {
     mod.print(stream, nullptr);
 }
 
-int main(int argc, const char **argv) {
-    llreve::cl::SetVersionPrinter(printVersion);
-    parseCommandLineArguments(argc, argv);
+// Runs the complete pipeline for the already parsed command line arguments
+static int verify(const char *exeName, DriverSetup *driverSetup) {
+    if (FileName1Flag.empty() || FileName2Flag.empty()) {
+        logError("Two input files are required\n");
+        return 1;
+    }
+    if (SolveFlag && (MuZFlag || BitVectFlag || InvertFlag)) {
+        logError("-solve cannot be combined with -muz, -bitvect or -invert\n");
+        return 1;
+    }
+    // The streamed clauses are written before all of them are known. With
+    // -invert the clauses are negated and combined in a single satisfiability
+    // query over uninterpreted predicates. Dropping a disjunct or replacing a
+    // predicate by its only definition assumes the least fixpoint semantics of
+    // Horn clauses, which does not hold there.
+    if ((PruneClausesFlag || InlinePredicatesFlag) &&
+        (StreamFlag || InvertFlag)) {
+        logError("-prune-clauses and -inline-predicates cannot be combined "
+                 "with -stream or -invert\n");
+        return 1;
+    }
 
     PreprocessOpts preprocessOpts(ShowCFGFlag, ShowMarkedCFGFlag,
-                                  InferMarksFlag);
+                                  InferMarksFlag, ThreadsFlag);
     InputOpts inputOpts(IncludesFlag, ResourceDirFlag, FileName1Flag,
-                        FileName2Flag);
+                        FileName2Flag, PCHCacheDirFlag);
     FileOptions fileOpts = getFileOptions(inputOpts.FileNames);
     SerializeOpts serializeOpts(OutputFileNameFlag, DontInstantiate,
-                                BitVectFlag, true, InlineLets);
+                                BitVectFlag, true, InlineLets, CSEFlag,
+                                SimplifyFlag, PruneClausesFlag,
+                                InlinePredicatesFlag);
 
+    // Each action owns its own LLVMContext which allows compiling both
+    // programs concurrently
     std::unique_ptr<CodeGenAction> act1 =
         std::make_unique<clang::EmitLLVMOnlyAction>();
     std::unique_ptr<CodeGenAction> act2 =
         std::make_unique<clang::EmitLLVMOnlyAction>();
     MonoPair<unique_ptr<llvm::Module>> modules =
-        compileToModules(argv[0], inputOpts, {*act1, *act2});
+        compileToModules(exeName, inputOpts, {*act1, *act2}, driverSetup);
     MonoPair<llvm::Module &> moduleRefs = {*modules.first, *modules.second};
 
     std::map<const llvm::Function *, int> functionNumerals;
@@ -231,20 +361,146 @@ int main(int argc, const char **argv) {
             moduleRefs, parseFunctionPairFlags(AssumeEquivalentFlags))),
         getCoupledFunctions(moduleRefs, DisableAutoCouplingFlag,
                             parseFunctionPairFlags(CoupleFunctionsFlag)),
-        functionNumerals, reversedFunctionNumerals);
+        functionNumerals, reversedFunctionNumerals,
+        LargeBlockEncodingFlag ? PathEncoding::LargeBlock
+                               : PathEncoding::PerPath,
+        PathBudgetFlag);
+    SMTGenerationOpts::getInstance().Threads = ThreadsFlag;
+    SMTGenerationOpts::getInstance().HashCons = HashConsFlag;
 
     const auto analysisResults = preprocessModules(moduleRefs, preprocessOpts);
     printModule(*modules.first, IRFileName1);
     printModule(*modules.second, IRFileName2);
 
+    // The cache only contains the serialized SMT which can’t be solved
+    string cacheKey;
+    if (!SMTCacheDirFlag.empty() && !SolveFlag) {
+        cacheKey = smtCacheKey({*modules.first, *modules.second},
+                               preprocessOpts, fileOpts, serializeOpts,
+                               g_GIT_SHA1);
+        string smt;
+        if (lookupSMTCache(SMTCacheDirFlag, cacheKey, smt)) {
+            writeSerializedSMT(smt, serializeOpts);
+            llvm::llvm_shutdown();
+            return 0;
+        }
+    }
+
+    SimplificationStats simplificationStats;
+    bool muZ = SMTGenerationOpts::getInstance().OutputFormat == SMTFormat::Z3;
+    if (StreamFlag && !SolveFlag && !muZ) {
+        std::ostringstream cachedSMT;
+        std::ofstream outputFile;
+        std::ostream *out = &std::cout;
+        if (!cacheKey.empty()) {
+            out = &cachedSMT;
+        } else if (!OutputFileNameFlag.empty()) {
+            outputFile.open(OutputFileNameFlag);
+            out = &outputFile;
+        }
+        // Everything is written as soon as it has been generated, starting
+        // with the declarations
+        StreamingSerializer serializer(serializeOpts, *out, 64);
+        auto emit = [&serializer, &simplificationStats](SharedSMTRef expr) {
+            if (SimplifyFlag) {
+                expr = simplifyAssertion(*expr, simplificationStats);
+                if (!expr) {
+                    return;
+                }
+            }
+            serializer.push(std::move(expr));
+        };
+        vector<SharedSMTRef> footer = generateSMTStreaming(
+            moduleRefs, analysisResults, fileOpts,
+            [&emit](vector<SharedSMTRef> header) {
+                for (auto &expr : header) {
+                    emit(std::move(expr));
+                }
+            },
+            emit, InvariantDeclarations::Include);
+        for (auto &expr : footer) {
+            emit(std::move(expr));
+        }
+        serializer.finish();
+        if (SimplifyStatsFlag) {
+            simplificationStats.print(std::cerr);
+        }
+        if (!cacheKey.empty()) {
+            storeSMTCache(SMTCacheDirFlag, cacheKey, cachedSMT.str());
+            writeSerializedSMT(cachedSMT.str(), serializeOpts);
+        }
+        llvm::llvm_shutdown();
+        return 0;
+    }
+
     vector<SharedSMTRef> smtExprs =
         generateSMT(moduleRefs, analysisResults, fileOpts);
+    if (SimplifyFlag) {
+        smtExprs = simplifyAssertions(std::move(smtExprs), simplificationStats);
+        if (SimplifyStatsFlag) {
+            simplificationStats.print(std::cerr);
+        }
+    }
+    // Pruning first leaves fewer uses of each predicate
+    if (PruneClausesFlag) {
+        smtExprs = pruneUnreachableClauses(std::move(smtExprs));
+    }
+    if (InlinePredicatesFlag) {
+        smtExprs = inlineSingleDefinitionPredicates(std::move(smtExprs));
+    }
 
-    serializeSMT(smtExprs,
-                 SMTGenerationOpts::getInstance().OutputFormat == SMTFormat::Z3,
-                 serializeOpts);
+    if (SolveFlag) {
+        // Only write the clauses if they have been requested explicitly
+        if (!OutputFileNameFlag.empty()) {
+            serializeSMT(smtExprs, false, serializeOpts);
+        }
+        SolveResult result = solveSMT(smtExprs);
+        std::cout << solveResultName(result) << "\n";
+        llvm::llvm_shutdown();
+        switch (result) {
+        case SolveResult::Equal:
+            return 0;
+        case SolveResult::NotEqual:
+            return 2;
+        case SolveResult::Unknown:
+            return 3;
+        }
+    }
+
+    if (!cacheKey.empty()) {
+        std::ostringstream smt;
+        serializeSMT(smtExprs, muZ, serializeOpts, smt);
+        storeSMTCache(SMTCacheDirFlag, cacheKey, smt.str());
+        writeSerializedSMT(smt.str(), serializeOpts);
+    } else {
+        serializeSMT(smtExprs, muZ, serializeOpts);
+    }
 
     llvm::llvm_shutdown();
 
     return 0;
 }
+
+int main(int argc, const char **argv) {
+    llreve::cl::SetVersionPrinter(printVersion);
+    parseCommandLineArguments(argc, argv);
+
+    if (ServerFlag || !ServerSocketFlag.empty()) {
+        // The driver is set up once and inherited by the forked jobs
+        DriverSetup driverSetup = initializeDriverSetup();
+        JobRunner runJob = [&driverSetup](int jobArgc, const char **jobArgv) {
+            // Start from the default values so neither the options of the
+            // server nor those of earlier jobs apply to this one
+            llreve::cl::ResetAllOptionOccurrences();
+            parseCommandLineArguments(jobArgc, jobArgv);
+            return verify(jobArgv[0], &driverSetup);
+        };
+        string socketPath = ServerSocketFlag;
+        if (socketPath.empty()) {
+            return serveStdin(argv[0], runJob);
+        }
+        return serveSocket(argv[0], socketPath, runJob);
+    }
+
+    return verify(argv[0], nullptr);
+}
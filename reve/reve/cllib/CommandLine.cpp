@@ -1012,6 +1012,12 @@ void CommandLineParser::ResetAllOptionOccurrences() {
     for (auto SC : RegisteredSubCommands) {
         for (auto &O : SC->OptionsMap)
             O.second->reset();
+        for (Option *O : SC->PositionalOpts)
+            O->reset();
+        for (Option *O : SC->SinkOpts)
+            O->reset();
+        if (SC->ConsumeAfterOpt)
+            SC->ConsumeAfterOpt->reset();
     }
 }
 
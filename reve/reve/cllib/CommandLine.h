@@ -345,6 +345,9 @@ class Option {
     virtual void getExtraOptionNames(llvm::SmallVectorImpl<llvm::StringRef> &) {
     }
 
+    // Restore the value the option had before any occurrence was handled
+    virtual void setDefault() = 0;
+
     // addOccurrence - Wrapper around handleOccurrence that enforces Flags.
     //
     virtual bool addOccurrence(unsigned pos, llvm::StringRef ArgName,
@@ -356,7 +359,12 @@ class Option {
 
   public:
     inline int getNumOccurrences() const { return NumOccurrences; }
-    inline void reset() { NumOccurrences = 0; }
+    // Forget all occurrences and restore the default value, this allows
+    // parsing several command lines in succession
+    inline void reset() {
+        NumOccurrences = 0;
+        setDefault();
+    }
     virtual ~Option() {}
 };
 
@@ -1306,6 +1314,23 @@ class opt : public Option,
         }
     }
 
+    // Only plain values and strings have a default, the other class types are
+    // used for actions such as printing the help and are left alone
+    void setDefault() override {
+        setDefaultImpl(std::integral_constant<
+                       bool, !std::is_class<DataType>::value ||
+                                 std::is_same<DataType, std::string>::value>());
+    }
+    void setDefaultImpl(std::true_type) {
+        const OptionValue<DataType> &V = this->getDefault();
+        if (V.hasValue()) {
+            this->setValue(V.getValue());
+        } else {
+            this->setValue(DataType());
+        }
+    }
+    void setDefaultImpl(std::false_type) {}
+
     void done() {
         addArgument();
         Parser.initialize();
@@ -1365,6 +1390,12 @@ template <class DataType, class StorageClass> class list_storage {
                                 "line option with external storage!");
         Location->push_back(V);
     }
+
+    void clear() {
+        if (Location) {
+            Location->clear();
+        }
+    }
 };
 
 // Define how to hold a class type object, such as a string.
@@ -1434,6 +1465,8 @@ template <class DataType> class list_storage<DataType, bool> {
     const std::vector<DataType> *operator&() const { return &Storage; }
 
     template <class T> void addValue(const T &V) { Storage.push_back(V); }
+
+    void clear() { Storage.clear(); }
 };
 
 //===----------------------------------------------------------------------===//
@@ -1477,6 +1510,12 @@ class list : public Option, public list_storage<DataType, StorageClass> {
     void printOptionValue(size_t /*GlobalWidth*/,
                           bool /*Force*/) const override {}
 
+    // Without a stored default the option starts out empty
+    void setDefault() override {
+        Positions.clear();
+        list_storage<DataType, StorageClass>::clear();
+    }
+
     void done() {
         addArgument();
         Parser.initialize();
@@ -1548,6 +1587,12 @@ template <class DataType, class StorageClass> class bits_storage {
         *Location |= Bit(V);
     }
 
+    void clear() {
+        if (Location) {
+            *Location = 0;
+        }
+    }
+
     unsigned getBits() { return *Location; }
 
     template <class T> bool isSet(const T &V) {
@@ -1574,6 +1619,8 @@ template <class DataType> class bits_storage<DataType, bool> {
     unsigned getBits() { return Bits; }
 
     template <class T> bool isSet(const T &V) { return (Bits & Bit(V)) != 0; }
+
+    void clear() { Bits = 0; }
 };
 
 //===----------------------------------------------------------------------===//
@@ -1617,6 +1664,12 @@ class bits : public Option, public bits_storage<DataType, Storage> {
     void printOptionValue(size_t /*GlobalWidth*/,
                           bool /*Force*/) const override {}
 
+    // Without a stored default the option starts out empty
+    void setDefault() override {
+        Positions.clear();
+        bits_storage<DataType, Storage>::clear();
+    }
+
     void done() {
         addArgument();
         Parser.initialize();
@@ -1664,6 +1717,9 @@ class alias : public Option {
     void printOptionValue(size_t /*GlobalWidth*/,
                           bool /*Force*/) const override {}
 
+    // The value is stored in the aliased option which is reset on its own
+    void setDefault() override {}
+
     ValueExpected getValueExpectedFlagDefault() const override {
         return AliasFor->getValueExpectedFlag();
     }
@@ -0,0 +1,65 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+
+// A queue for a single producer and consumer. push blocks while the queue is
+// full so a slow consumer limits the number of elements that are alive.
+template <typename T> class BoundedQueue {
+  private:
+    std::queue<T> q;
+    size_t capacity;
+    bool closed = false;
+    std::mutex m;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+  public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+    void push(T val) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            while (q.size() >= capacity) {
+                notFull.wait(lock);
+            }
+            q.push(std::move(val));
+        }
+        notEmpty.notify_one();
+    }
+    // No more elements will be pushed
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            closed = true;
+        }
+        notEmpty.notify_all();
+    }
+    // Returns false if the queue has been closed and all elements have been
+    // popped
+    bool pop(T &val) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            while (q.empty() && !closed) {
+                notEmpty.wait(lock);
+            }
+            if (q.empty()) {
+                return false;
+            }
+            val = std::move(q.front());
+            q.pop();
+        }
+        notFull.notify_one();
+        return true;
+    }
+};
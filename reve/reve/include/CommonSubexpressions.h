@@ -0,0 +1,31 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include "SMT.h"
+
+namespace smt {
+
+// Bind subterms that occur more than once so that solvers and the writer only
+// have to process them once. Boolean terms that only depend on the variables
+// of the clauses and occur in several assertions are extracted into
+// define-funs which are placed before the first assertion. Afterwards terms
+// that occur more than once inside a single assertion are bound by a let
+// directly below its forall.
+//
+// Nested quantifiers and lets are left untouched, so terms below them are not
+// shared. The serializer therefore always inlines lets before calling this.
+auto eliminateCommonSubexpressions(std::vector<SharedSMTRef> exprs)
+    -> std::vector<SharedSMTRef>;
+// Only performs the second step for a single toplevel expression. This does
+// not need to know the other assertions and can thus be used while streaming.
+auto bindCommonSubexpressions(SharedSMTRef expr) -> SharedSMTRef;
+}
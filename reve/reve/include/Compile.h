@@ -17,6 +17,15 @@
 #include "clang/Driver/Driver.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Option/Option.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// The diagnostics and driver used to construct the frontend invocations.
+/// They don’t depend on the input files so they can be set up once and shared
+/// by several compilations, e.g. in server mode.
+struct DriverSetup {
+    std::unique_ptr<clang::DiagnosticsEngine> diags;
+    std::unique_ptr<clang::driver::Driver> driver;
+};
 
 /// compiles the input files to llvm modules
 /// \param exeName should be argv[0] in most cases
@@ -24,21 +33,47 @@
 /// IMPORTANT: The lifetime of the module is tied to the lifetime of the
 /// codegenactions, so make sure they stay alive if you don’t want to spend
 /// hours debugging really weird segfaults.
+/// The actions are executed on separate threads so they must not share an
+/// LLVMContext.
+/// If no driver setup is passed a new one is created.
 auto compileToModules(
     const char *exeName, llreve::opts::InputOpts &opts,
-    std::pair<clang::CodeGenAction &, clang::CodeGenAction &> actions)
+    std::pair<clang::CodeGenAction &, clang::CodeGenAction &> actions,
+    DriverSetup *driverSetup = nullptr)
     -> MonoPair<std::unique_ptr<llvm::Module>>;
 auto executeCodeGenActions(
     const char *exeName, llreve::opts::InputOpts &opts,
-    std::pair<clang::CodeGenAction &, clang::CodeGenAction &> actions) -> void;
+    std::pair<clang::CodeGenAction &, clang::CodeGenAction &> actions,
+    DriverSetup *driverSetup = nullptr) -> void;
+/// Returns false if the action failed instead of exiting, so it can run on a
+/// separate thread. The diagnostics are written to diagOutput. If a cache
+/// directory is passed, the #include directives at the start of the input are
+/// precompiled.
 auto executeCodeGenAction(const llvm::opt::ArgStringList &ccArgs,
                           clang::DiagnosticsEngine &diags,
-                          clang::CodeGenAction &act) -> void;
+                          clang::CodeGenAction &act,
+                          llvm::StringRef pchCacheDir = "",
+                          llvm::raw_ostream &diagOutput = llvm::errs())
+    -> bool;
+/// Returns the path to a precompiled header containing the #include
+/// directives at the start of the input, which end at preambleEnd. The
+/// header is looked up in the cache directory using a hash of the options
+/// and directives and rebuilt if the contents of any of the files it depends
+/// on have changed.
+/// Returns an empty string if there is nothing to precompile or building
+/// failed.
+auto getPrecompiledPreamble(const llvm::opt::ArgStringList &ccArgs,
+                            clang::DiagnosticsEngine &diags,
+                            llvm::StringRef inputFile,
+                            llvm::StringRef pchCacheDir, size_t &preambleEnd,
+                            llvm::raw_ostream &diagOutput) -> std::string;
 auto initializeArgs(const char *exeName, llreve::opts::InputOpts &opts)
     -> std::vector<const char *>;
-auto initializeDiagnostics(void) -> std::unique_ptr<clang::DiagnosticsEngine>;
+auto initializeDiagnostics(llvm::raw_ostream &os = llvm::errs())
+    -> std::unique_ptr<clang::DiagnosticsEngine>;
 auto initializeDriver(clang::DiagnosticsEngine &diags)
     -> std::unique_ptr<clang::driver::Driver>;
+auto initializeDriverSetup() -> DriverSetup;
 auto getCmd(clang::driver::Compilation &comp, clang::DiagnosticsEngine &diags)
     -> llvm::ErrorOr<MonoPair<llvm::opt::ArgStringList>>;
 template <typename T> auto makeErrorOr(T Arg) -> llvm::ErrorOr<T>;
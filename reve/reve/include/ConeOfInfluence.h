@@ -0,0 +1,31 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include "SMT.h"
+
+namespace smt {
+
+// Analyses on the predicate dependency graph of the generated Horn clauses.
+// Predicates are the relations declared by declare-fun/declare-rel. A clause
+// depends on the predicates in its premises and defines the predicates in its
+// conclusion. Queries are clauses whose conclusion is false or the predicate
+// of a query command.
+
+// Remove all clauses and declarations of predicates that cannot contribute to
+// a query. If there is no query everything is kept.
+auto pruneUnreachableClauses(std::vector<SharedSMTRef> exprs)
+    -> std::vector<SharedSMTRef>;
+// Replace predicates that are defined by a single nonrecursive clause and used
+// at most once by the premise of their definition.
+auto inlineSingleDefinitionPredicates(std::vector<SharedSMTRef> exprs)
+    -> std::vector<SharedSMTRef>;
+}
@@ -6,7 +6,7 @@
 #include "SMT.h"
 
 using FreeVarsMap = std::map<Mark, std::vector<smt::SortedVar>>;
-auto freeVars(PathMap map, std::vector<smt::SortedVar> funArgs, Program prog)
-    -> FreeVarsMap;
+auto freeVars(const PathMap &map, std::vector<smt::SortedVar> funArgs,
+              Program prog) -> FreeVarsMap;
 auto addMemoryArrays(std::vector<smt::SortedVar> vars, Program prog)
     -> std::vector<smt::SortedVar>;
@@ -50,6 +50,37 @@ struct AssignmentBlock {
     }
 };
 
+/// Memoizes assignmentsOnPath for the paths of the functions of one assertion
+/**
+A path shows up in the synchronized, forbidden and stutter paths and in the
+product with every path of the other program. With this cache its assignments
+and branch conditions are only built once.
+ */
+class PathAssignmentCache {
+  public:
+    auto assignments(const Path &path, Program prog,
+                     const std::vector<smt::SortedVar> &freeVars, bool toEnd)
+        -> const std::vector<AssignmentCallBlock> &;
+
+  private:
+    // Paths are identified by their blocks and the conditions of their edges,
+    // the latter are shared by all copies of a path
+    struct Key {
+        Program prog;
+        bool toEnd;
+        const llvm::BasicBlock *start;
+        std::vector<std::pair<const Condition *, const llvm::BasicBlock *>>
+            edges;
+        std::vector<std::string> freeVars;
+        bool operator<(const Key &other) const {
+            return std::tie(prog, toEnd, start, edges, freeVars) <
+                   std::tie(other.prog, other.toEnd, other.start, other.edges,
+                            other.freeVars);
+        }
+    };
+    std::map<Key, std::vector<AssignmentCallBlock>> cache;
+};
+
 /// Create the mutual assertions for the passed function.
 /**
 This creates complete assertions containing the input and output parameters of
@@ -59,9 +90,9 @@ auto relationalFunctionAssertions(
     MonoPair<const llvm::Function *> preprocessedFuns,
     const AnalysisResultsMap &analysisResults)
     -> std::vector<std::unique_ptr<smt::SMTExpr>>;
-auto functionalFunctionAssertions(
-    MonoPair<const llvm::Function *> preprocessedFun,
-    const AnalysisResultsMap &analysisResults, Program prog)
+auto functionalFunctionAssertions(const llvm::Function *preprocessedFun,
+                                  const AnalysisResultsMap &analysisResults,
+                                  Program prog)
     -> std::vector<std::unique_ptr<smt::SMTExpr>>;
 
 /// Create the assertion for the passed main function.
@@ -69,9 +100,13 @@ auto functionalFunctionAssertions(
 The main function is special because it is never called so the predicates don’t
 need to contain the output parameters. While it’s not necessary to use this
 encoding it seems to perform better in some cases.
+
+equalInputs indicates that IN_INV requires the arguments of both functions to
+be equal, which is used to skip pairs of paths that cannot start together.
  */
 auto relationalIterativeAssertions(MonoPair<const llvm::Function *> functions,
-                                   const AnalysisResultsMap &analysisResults)
+                                   const AnalysisResultsMap &analysisResults,
+                                   bool equalInputs)
     -> std::vector<std::unique_ptr<smt::SMTExpr>>;
 
 /// Get all combinations of paths that have the same start and end mark.
@@ -101,7 +136,10 @@ inline bool operator<(const MarkPair &lhs, const MarkPair &rhs) {
 auto getSynchronizedPaths(const PathMap &pathMap1, const PathMap &pathMap2,
                           const FreeVarsMap &freeVarsMap1,
                           const FreeVarsMap &freeVarsMap2,
-                          ReturnInvariantGenerator generateReturnInvariant)
+                          ReturnInvariantGenerator generateReturnInvariant,
+                          llreve::opts::PathEncoding encoding,
+                          PathAssignmentCache &cache,
+                          const ValueEqualities &entryEqualities)
     -> std::map<MarkPair, std::vector<std::unique_ptr<smt::SMTExpr>>>;
 
 /// Find all paths with the same start but different end marks
@@ -115,17 +153,21 @@ auto getForbiddenPaths(const MonoPair<PathMap> &pathMaps,
                        const MonoPair<BidirBlockMarkMap> &marked,
                        const FreeVarsMap &freeVarsMap1,
                        const FreeVarsMap &freeVarsMap2, std::string funName,
-                       bool main)
+                       bool main, llreve::opts::PathEncoding encoding,
+                       PathAssignmentCache &cache,
+                       const ValueEqualities &entryEqualities)
     -> std::map<Mark, std::vector<std::unique_ptr<smt::SMTExpr>>>;
 /// Get the assertions for a single program
 auto nonmutualPaths(
     const PathMap &pathMap, const FreeVarsMap &freeVarsMap, Program prog,
     std::string funName, const llvm::Type *type,
-    std::vector<std::unique_ptr<smt::SMTExpr>> functionNumeralConstraints)
+    std::vector<std::unique_ptr<smt::SMTExpr>> functionNumeralConstraints,
+    llreve::opts::PathEncoding encoding)
     -> std::vector<std::unique_ptr<smt::SMTExpr>>;
 auto getStutterPaths(const PathMap &pathMap1, const PathMap &pathMap2,
                      const FreeVarsMap &freeVarsMap, std::string funName,
-                     bool main)
+                     bool main, llreve::opts::PathEncoding encoding,
+                     PathAssignmentCache &cache)
     -> std::map<MarkPair, std::vector<std::unique_ptr<smt::SMTExpr>>>;
 
 /* -------------------------------------------------------------------------- */
@@ -134,6 +176,21 @@ auto getStutterPaths(const PathMap &pathMap1, const PathMap &pathMap2,
 auto assignmentsOnPath(const Path &path, Program prog,
                        const std::vector<smt::SortedVar> &freeVars, bool toEnd)
     -> std::vector<AssignmentCallBlock>;
+
+/// All paths of one program between two marks merged into a single block
+struct MergedPaths {
+    // The assignments of all blocks in topological order
+    std::vector<smt::AssignmentGroup> definitions;
+    // The blocks at which the paths end and the conditions under which they
+    // are reached
+    std::vector<std::pair<llvm::BasicBlock *, smt::SharedSMTRef>> ends;
+};
+
+auto mergedAssignments(const PathDAG &dag, Mark endMark, Program prog,
+                       const std::vector<smt::SortedVar> &freeVars, bool toEnd)
+    -> llvm::Optional<MergedPaths>;
+/// Holds if one of the paths of the merged block is taken
+auto reachedEnd(const MergedPaths &merged) -> smt::SharedSMTRef;
 auto interleaveAssignments(std::unique_ptr<smt::SMTExpr> endClause,
                            llvm::ArrayRef<AssignmentCallBlock> assignment1,
                            llvm::ArrayRef<AssignmentCallBlock> assignment2)
@@ -187,37 +244,15 @@ auto checkPathMaps(const PathMap &map1, const PathMap &map2) -> void;
 auto mapSubset(const PathMap &map1, const PathMap &map2) -> bool;
 auto getDontLoopInvariant(smt::SMTRef endClause, Mark startIndex,
                           const PathMap &pathMap,
-                          const FreeVarsMap &freeVarsMap, Program prog)
-    -> smt::SMTRef;
+                          const FreeVarsMap &freeVarsMap, Program prog,
+                          llreve::opts::PathEncoding encoding,
+                          PathAssignmentCache &cache) -> smt::SMTRef;
 auto addAssignments(std::unique_ptr<smt::SMTExpr> end,
                     llvm::ArrayRef<AssignmentBlock> assignments)
     -> std::unique_ptr<smt::SMTExpr>;
 auto addMemory(std::vector<smt::SharedSMTRef> &implArgs)
     -> std::function<void(CallInfo call, int index)>;
 
-// This combines `relationalFunctionDeclarations` and
-// `relationalFunctionAssertions`.
-auto generateRelationalFunctionSMT(
-    MonoPair<const llvm::Function *> preprocessedFunction,
-    const AnalysisResultsMap &analysisResults,
-    std::vector<smt::SharedSMTRef> &assertions,
-    std::vector<smt::SharedSMTRef> &declarations) -> void;
-// This combines `functionalFunctionDeclarations` and
-// `functionalFunctionAssertions`.
-auto generateFunctionalFunctionSMT(const llvm::Function *preprocessedFunction,
-                                   const AnalysisResultsMap &analysisResults,
-                                   Program prog,
-                                   std::vector<smt::SharedSMTRef> &assertions,
-                                   std::vector<smt::SharedSMTRef> &declarations)
-    -> void;
-// This combines `relationalIterativeDeclarations` and
-// `relationalIterativeAssertions`.
-auto generateRelationalIterativeSMT(
-    MonoPair<const llvm::Function *> preprocessedFunctions,
-    const AnalysisResultsMap &analysisResults,
-    std::vector<smt::SharedSMTRef> &assertions,
-    std::vector<smt::SharedSMTRef> &declarations) -> void;
-
 auto getFunctionNumeralConstraints(const llvm::Function *f, Program prog)
     -> std::vector<std::unique_ptr<smt::SMTExpr>>;
 auto getFunctionNumeralConstraints(MonoPair<const llvm::Function *> functions)
@@ -0,0 +1,48 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include "SMT.h"
+
+#include <string>
+#include <unordered_map>
+
+namespace smt {
+
+// Hash-consing of SMT expressions. Interning an expression returns a
+// structurally equal expression in which every subexpression that has been
+// seen before is replaced by the previously interned instance. Two
+// expressions interned by the same table are therefore structurally equal if
+// and only if they are the same object, so the pass that interns them can
+// compare and memoize by pointer.
+//
+// Interning happens after construction. Rewriting the interned expressions,
+// e.g. with an SMTVisitor, copies the nodes and loses the sharing, so later
+// passes that depend on it have to intern again.
+//
+// The table only holds weak references, so interned expressions are still
+// freed as soon as the last user drops them. Toplevel commands (declarations,
+// check-sat, …) are returned unchanged apart from their subexpressions.
+// Interning is not thread safe.
+class HashConsTable {
+  public:
+    auto intern(const SMTExpr &expr) -> SharedSMTRef;
+    // Number of interned expressions that are still alive
+    auto size() const -> size_t;
+    // Returns the canonical instance for key or registers expr as such
+    auto lookup(std::string key, SharedSMTRef expr) -> SharedSMTRef;
+
+  private:
+    std::unordered_map<std::string, std::weak_ptr<SMTExpr>> table;
+    size_t sweepThreshold = 1024;
+    void sweep();
+};
+}
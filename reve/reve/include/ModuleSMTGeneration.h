@@ -18,10 +18,49 @@
 
 #include "llvm/IR/Module.h"
 
+#include <functional>
+
+/// A part of the SMT generation that is independent of all other parts, e.g.
+/// the abstraction of a single function. The results are collected in the job
+/// so several jobs can run concurrently.
+struct GenerationJob {
+    std::function<void(std::vector<smt::SharedSMTRef> &assertions)> generate;
+    std::vector<smt::SharedSMTRef> assertions;
+    GenerationJob(
+        std::function<void(std::vector<smt::SharedSMTRef> &)> generate)
+        : generate(std::move(generate)) {}
+};
+
+/// Whether generateSMTStreaming includes the declarations of the invariants.
+enum class InvariantDeclarations { Include, Exclude };
+
 auto generateSMT(MonoPair<const llvm::Module &> modules,
                  const AnalysisResultsMap &analysisResults,
                  llreve::opts::FileOptions fileOpts)
     -> std::vector<smt::SharedSMTRef>;
+/// Generates the same SMT as generateSMT but passes the assertions to
+/// emitAssertion as soon as they have been generated instead of collecting
+/// them. The expressions that belong before the assertions are passed to
+/// emitHeader once, before the first assertion. The assertions are emitted in
+/// the same order as in the result of generateSMT. The expressions that
+/// belong after the assertions are returned. In inverted mode the assertions
+/// are combined into a single assertion so nothing is emitted and it is
+/// returned at the start of the result. If the declarations of the
+/// invariants are excluded, they have to be placed after the header.
+auto generateSMTStreaming(
+    MonoPair<const llvm::Module &> modules,
+    const AnalysisResultsMap &analysisResults,
+    llreve::opts::FileOptions fileOpts,
+    const std::function<void(std::vector<smt::SharedSMTRef>)> &emitHeader,
+    const std::function<void(smt::SharedSMTRef)> &emitAssertion,
+    InvariantDeclarations invariantDeclarations)
+    -> std::vector<smt::SharedSMTRef>;
+/// Declare the invariants of all functions that generateSMT produces
+/// assertions for, using the candidates in SMTGenerationOpts where they exist.
+/// These are the only parts of the output that depend on the candidates.
+auto generateInvariantDeclarations(MonoPair<const llvm::Module &> modules,
+                                   const AnalysisResultsMap &analysisResults)
+    -> std::vector<smt::SharedSMTRef>;
 auto generateSMTForMainFunctions(MonoPair<const llvm::Module &> modules,
                                  const AnalysisResultsMap &analysisResults,
                                  llreve::opts::FileOptions fileOpts,
@@ -31,8 +70,20 @@ auto generateSMTForMainFunctions(MonoPair<const llvm::Module &> modules,
 auto generateFunctionalAbstractions(
     const llvm::Module &module, const llvm::Function *mainFunction,
     const AnalysisResultsMap &analysisResults, Program prog,
-    std::vector<smt::SharedSMTRef> &assertions,
-    std::vector<smt::SharedSMTRef> &declarations) -> void;
+    std::vector<smt::SharedSMTRef> &assertions) -> void;
+auto addFunctionalAbstractionJobs(const llvm::Module &module,
+                                  const llvm::Function *mainFunction,
+                                  const AnalysisResultsMap &analysisResults,
+                                  Program prog,
+                                  std::vector<GenerationJob> &jobs) -> void;
+/// Runs the jobs on the given number of threads. The results are stored in the
+/// jobs themselves. finished is called on the calling thread for each job in
+/// the order of the jobs as soon as it and all previous jobs are done. Only a
+/// few jobs run ahead of the first unfinished one, so the results that wait
+/// for finished are bounded by the number of threads.
+auto runGenerationJobs(std::vector<GenerationJob> &jobs, unsigned threads,
+                       const std::function<void(GenerationJob &)> &finished)
+    -> void;
 auto select_Declaration() -> smt::SMTRef;
 auto store_Declaration() -> smt::SMTRef;
 auto globalDeclarations(const llvm::Module &mod1, const llvm::Module &mod2)
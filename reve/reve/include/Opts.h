@@ -35,9 +35,16 @@ class PreprocessOpts {
     bool ShowCFG;
     bool ShowMarkedCFG;
     bool InferMarks;
-    PreprocessOpts(bool showCFG, bool showMarkedCFG, bool inferMarks)
+    // Number of threads used for preprocessing. If it is greater than 1 the
+    // passes of the two programs, including the mark and path analyses, run
+    // concurrently. They transform the IR, so the functions of one program
+    // are still handled one after another. Only collecting the variables of
+    // the functions afterwards is distributed over all threads.
+    unsigned Threads;
+    PreprocessOpts(bool showCFG, bool showMarkedCFG, bool inferMarks,
+                   unsigned threads = 1)
         : ShowCFG(showCFG), ShowMarkedCFG(showMarkedCFG),
-          InferMarks(inferMarks) {}
+          InferMarks(inferMarks), Threads(threads) {}
 };
 
 enum class HeapOpt { Enabled, Disabled };
@@ -51,6 +58,9 @@ enum class FunctionEncoding { OnlyRecursive, Iterative };
 enum class ByteHeapOpt { Enabled, Disabled };
 enum class SMTFormat { Z3, SMTHorn };
 enum class PerfectSynchronization { Enabled, Disabled };
+// PerPath emits one clause for each path between two marks, LargeBlock merges
+// all paths between two marks into a single clause
+enum class PathEncoding { PerPath, LargeBlock };
 
 /// Singleton for the options used for SMT generation to avoid having to pass
 /// around the config object
@@ -78,7 +88,9 @@ class SMTGenerationOpts {
         std::set<MonoPair<llvm::Function *>> coupleFunctions,
         std::map<const llvm::Function *, int> functionNumerals,
         MonoPair<std::map<int, const llvm::Function *>>
-            reversedFunctionNumerals);
+            reversedFunctionNumerals,
+        PathEncoding encoding = PathEncoding::PerPath,
+        uint64_t pathBudget = 0);
     MonoPair<llvm::Function *> MainFunctions = {nullptr, nullptr};
     HeapOpt Heap;
     StackOpt Stack;
@@ -93,6 +105,10 @@ class SMTGenerationOpts {
     bool Invert;
     bool InitPredicate;
     bool DisableAutoAbstraction;
+    PathEncoding Encoding = PathEncoding::PerPath;
+    // Functions whose per-path encoding needs more clauses than this use the
+    // large-block encoding instead. 0 means that there is no budget.
+    uint64_t PathBudget = 0;
     // If an invariant is not in the map a declaration is added and it’s up to
     // the SMT solver to find it
     std::map<Mark, smt::SharedSMTRef> IterativeRelationalInvariants;
@@ -114,6 +130,12 @@ class SMTGenerationOpts {
     // This is just a reversed version of the above map separated by module
     MonoPair<std::map<int, const llvm::Function *>> ReversedFunctionNumerals = {
         {}, {}};
+    // Number of threads used for generating the SMT of independent functions.
+    // This is not set by initialize since it does not change the result.
+    unsigned Threads = 1;
+    // Share structurally equal subexpressions of the assertions while they
+    // are collected. Like Threads this does not change the result.
+    bool HashCons = false;
 
   private:
     SMTGenerationOpts() = default;
@@ -127,10 +149,15 @@ class InputOpts {
     std::vector<std::string> Includes;
     std::string ResourceDir;
     MonoPair<std::string> FileNames;
+    // Directory in which precompiled headers for the #include directives at
+    // the start of the inputs are cached. Empty if no precompiled headers
+    // should be used.
+    std::string PCHCacheDir;
     InputOpts(std::vector<std::string> includes, std::string resourceDir,
-              std::string file1, std::string file2)
+              std::string file1, std::string file2,
+              std::string pchCacheDir = "")
         : Includes(includes), ResourceDir(resourceDir),
-          FileNames(makeMonoPair(file1, file2)) {}
+          FileNames(makeMonoPair(file1, file2)), PCHCacheDir(pchCacheDir) {}
 };
 
 /// Options used for serializing the SMT
@@ -141,11 +168,22 @@ class SerializeOpts {
     bool MergeImplications;
     bool Pretty;
     bool InlineLets;
+    // Bind repeated subterms using define-fun and let
+    bool CSE;
+    // Fold constants and drop trivially true assertions before serializing
+    bool Simplify;
+    // Drop clauses that cannot contribute to a query
+    bool PruneClauses;
+    // Inline predicates with a single defining clause
+    bool InlinePredicates;
     SerializeOpts(std::string outputFileName, bool DontInstantiate,
-                  bool MergeImplications, bool Pretty, bool InlineLets)
+                  bool MergeImplications, bool Pretty, bool InlineLets,
+                  bool CSE = false, bool Simplify = false,
+                  bool PruneClauses = false, bool InlinePredicates = false)
         : OutputFileName(outputFileName), DontInstantiate(DontInstantiate),
           MergeImplications(MergeImplications), Pretty(Pretty),
-          InlineLets(InlineLets) {}
+          InlineLets(InlineLets), CSE(CSE), Simplify(Simplify),
+          PruneClauses(PruneClauses), InlinePredicates(InlinePredicates) {}
 };
 
 /// Options that are parsed from special comments inside the programs
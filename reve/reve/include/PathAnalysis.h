@@ -11,13 +11,49 @@
 #pragma once
 
 #include "MarkAnalysis.h"
+#include "MonoPair.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/InstrTypes.h"
+
+#include <mutex>
+
+namespace llvm {
+class ConstantInt;
+}
+
 namespace smt {
 class SMTExpr;
 }
 
+// Pairs of values of the first and the second program that are equal
+using ValueEqualities = std::vector<MonoPair<const llvm::Value *>>;
+
+// What is known about the values on one or two paths
+struct PathFacts {
+    // Values that are known to be constant. They are not stored as
+    // ConstantInt since creating constants modifies the LLVMContext, which is
+    // shared by the generation jobs running in parallel.
+    llvm::DenseMap<const llvm::Value *, llvm::APInt> Values;
+    // Values that are known to be equal to another value, which stands for
+    // them in Values and Comparisons
+    llvm::DenseMap<const llvm::Value *, const llvm::Value *> Representatives;
+    struct Comparison {
+        llvm::CmpInst::Predicate Pred;
+        const llvm::Value *Lhs;
+        const llvm::Value *Rhs;
+    };
+    // Comparisons that are known to hold
+    std::vector<Comparison> Comparisons;
+};
+
 class Condition {
   public:
     virtual std::unique_ptr<smt::SMTExpr> toSmt() const = 0;
+    // Add the facts implied by the condition, returns false if the condition
+    // contradicts the known facts
+    virtual bool assume(PathFacts &Facts) const = 0;
     virtual ~Condition();
 };
 
@@ -45,6 +81,7 @@ class BooleanCondition : public Condition {
     const llvm::Value *Cond;
     bool True;
     std::unique_ptr<smt::SMTExpr> toSmt() const override;
+    bool assume(PathFacts &Facts) const override;
 };
 
 class SwitchCondition : public Condition {
@@ -54,6 +91,7 @@ class SwitchCondition : public Condition {
     const llvm::Value *const Cond;
     llvm::APInt Val;
     std::unique_ptr<smt::SMTExpr> toSmt() const override;
+    bool assume(PathFacts &Facts) const override;
 };
 
 class SwitchDefault : public Condition {
@@ -63,6 +101,7 @@ class SwitchDefault : public Condition {
     const llvm::Value *const Cond;
     const std::vector<llvm::APInt> Vals;
     std::unique_ptr<smt::SMTExpr> toSmt() const override;
+    bool assume(PathFacts &Facts) const override;
 };
 
 // I really suck at finding nice names
@@ -70,23 +109,80 @@ using Path_ = std::vector<Edge>;
 using Paths_ = std::vector<Path_>;
 using Paths = std::vector<Path>;
 
+// All paths starting at a marked block, represented as a DAG with one node per
+// block that can be reached without passing another mark. Paths through the
+// same block share that node, so the size of the DAG is linear in the size of
+// the function even if the number of paths is exponential. The nodes are in
+// topological order, the start node is Nodes[0].
+class PathDAG {
+  public:
+    struct Successor {
+        std::shared_ptr<Condition> Cond;
+        size_t Node;
+    };
+    struct Node {
+        llvm::BasicBlock *Block;
+        std::vector<Successor> Successors;
+        // Marks of the paths ending at this node, empty for inner nodes
+        std::set<Mark> EndMarks;
+        // Marks of the paths passing through this node
+        std::set<Mark> Reaches;
+    };
+
+    PathDAG(Mark StartMark, llvm::BasicBlock *Start,
+            const BidirBlockMarkMap &MarkedBlocks);
+
+    Mark StartMark;
+    std::vector<Node> Nodes;
+
+    auto start() const -> llvm::BasicBlock * { return Nodes.front().Block; }
+    auto endMarks() const -> const std::set<Mark> & {
+        return Nodes.front().Reaches;
+    }
+    // Enumerate the paths ending at the given mark
+    auto paths(Mark EndMark) const -> Paths;
+    // Count the paths ending at the given mark without enumerating them. The
+    // count saturates instead of overflowing.
+    auto pathCount(Mark EndMark) const -> uint64_t;
+};
+
 // This just wraps an std::map specialized to the appropriate types. The only
 // reason why this is a struct instead of a type is to avoid ADL kicking in when
 // instantiating this pass
+//
+// The paths are stored as one PathDAG per marked block and only enumerated
+// when the map is accessed. Copies share the DAGs and the enumerated paths.
 struct PathMap {
   private:
-    std::map<Mark, std::map<Mark, Paths>> value;
+    struct Shared {
+        std::map<Mark, std::vector<PathDAG>> DAGs;
+        std::once_flag Enumerated;
+        std::map<Mark, std::map<Mark, Paths>> Value;
+    };
+    std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+    auto value() const -> const std::map<Mark, std::map<Mark, Paths>> &;
 
   public:
-    auto begin() { return value.begin(); }
-    auto end() { return value.end(); }
-    auto begin() const { return value.begin(); }
-    auto end() const { return value.end(); }
-    std::map<Mark, Paths> &at(Mark mark) { return value.at(mark); }
-    const std::map<Mark, Paths> &at(Mark mark) const { return value.at(mark); }
-    auto find(Mark mark) { return value.find(mark); }
-    auto find(Mark mark) const { return value.find(mark); }
-    auto &operator[](Mark mark) { return value[mark]; }
+    PathMap() = default;
+    PathMap(std::map<Mark, std::vector<PathDAG>> DAGs);
+    auto begin() const { return value().begin(); }
+    auto end() const { return value().end(); }
+    const std::map<Mark, Paths> &at(Mark mark) const {
+        return value().at(mark);
+    }
+    auto find(Mark mark) const { return value().find(mark); }
+
+    // The following do not enumerate the paths
+    auto dags() const -> const std::map<Mark, std::vector<PathDAG>> & {
+        return shared->DAGs;
+    }
+    auto dags(Mark startMark) const -> const std::vector<PathDAG> & {
+        return shared->DAGs.at(startMark);
+    }
+    auto startMarks() const -> std::vector<Mark>;
+    auto hasStartMark(Mark mark) const -> bool;
+    auto endMarks(Mark startMark) const -> std::set<Mark>;
+    auto pathCount(Mark startMark, Mark endMark) const -> uint64_t;
 };
 
 class PathAnalysis : public llvm::AnalysisInfoMixin<PathAnalysis> {
@@ -105,15 +201,26 @@ class PathAnalysis : public llvm::AnalysisInfoMixin<PathAnalysis> {
 
 auto lastBlock(Path Path) -> llvm::BasicBlock *;
 
-auto findPaths(BidirBlockMarkMap markedBlocks) -> PathMap;
+auto findPaths(const BidirBlockMarkMap &markedBlocks) -> PathMap;
 
-auto findPathsStartingAt(Mark For, llvm::BasicBlock *BB,
-                         BidirBlockMarkMap MarkedBlocks)
-    -> std::map<Mark, Paths>;
-
-auto traverse(llvm::BasicBlock *BB, BidirBlockMarkMap MarkedBlocks, bool First,
-              std::set<const llvm::BasicBlock *> Visited) -> Paths_;
+/// Check if the conditions on a path can hold at the same time
+/**
+This propagates constants along the path and only detects contradictions
+between conditions that are implied by them, so it is cheap but incomplete: a
+path for which this returns true can still be infeasible.
+ */
+auto isFeasible(const Path &Path) -> bool;
+/// Check if the conditions on a path of each program can hold at the same time
+/**
+Equalities are known to hold at the start of both paths, e.g. the equal inputs
+of the main functions at the entry mark. Without them this is the same as
+checking both paths on their own since the programs share no variables.
+ */
+auto isFeasiblePair(const Path &Path1, const Path &Path2,
+                    const ValueEqualities &Equalities) -> bool;
 
-auto isMarked(llvm::BasicBlock &BB, BidirBlockMarkMap MarkedBlocks) -> bool;
+auto isMarked(llvm::BasicBlock &BB, const BidirBlockMarkMap &MarkedBlocks)
+    -> bool;
 
-auto isReturn(llvm::BasicBlock &BB, BidirBlockMarkMap MarkedBlocks) -> bool;
+auto isReturn(llvm::BasicBlock &BB, const BidirBlockMarkMap &MarkedBlocks)
+    -> bool;
@@ -37,6 +37,13 @@ auto runAnalyses(
     const llvm::Module &module, Program prog,
     std::map<const llvm::Function *, PassAnalysisResults> &passResults,
     AnalysisResultsMap &analysisResults) -> void;
+/// Same as calling runAnalyses on both modules but the functions are
+/// distributed over the given number of threads. The marks and paths have
+/// already been computed by runFunctionPasses.
+auto runAnalysesParallel(
+    MonoPair<const llvm::Module &> modules,
+    std::map<const llvm::Function *, PassAnalysisResults> &passResults,
+    AnalysisResultsMap &analysisResults, unsigned threads) -> void;
 auto runAnalyses(
     const llvm::Function &fun, Program prog,
     std::map<const llvm::Function *, PassAnalysisResults> &passResults)
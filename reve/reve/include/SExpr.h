@@ -16,6 +16,7 @@
 #include <set>
 #include <vector>
 
+#include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/StringSet.h>
 
 namespace sexpr {
@@ -69,6 +70,45 @@ class Comment : public SExpr {
 };
 
 std::ostream &operator<<(std::ostream &os, const SExpr &val);
+
+// Writes the same text that serializing the corresponding SExpr tree would
+// produce without building the tree first. Applications and lists are opened
+// and closed explicitly, their elements are written in between. The output is
+// collected in a buffer and written to the stream in large chunks.
+class SExprWriter {
+  public:
+    SExprWriter(std::ostream &os, bool pretty) : os(os), pretty(pretty) {}
+    SExprWriter(const SExprWriter &) = delete;
+    SExprWriter &operator=(const SExprWriter &) = delete;
+    ~SExprWriter() { flush(); }
+    void value(llvm::StringRef val);
+    void comment(llvm::StringRef val);
+    // numArgs has to match the number of elements written before close
+    void openApply(llvm::StringRef fun, size_t numArgs);
+    void openList();
+    void close();
+    // Fallback for expressions that only know how to produce an SExpr
+    void sexpr(const SExpr &expr);
+    // Ends a toplevel expression
+    void newline();
+    void flush();
+
+  private:
+    // Space before each element, newline before each element or newline
+    // before all but the first element
+    enum class Separator { Space, Newline, NewlineAfterFirst };
+    struct Frame {
+        size_t childIndent;
+        Separator separator;
+        bool first;
+    };
+    std::ostream &os;
+    bool pretty;
+    std::string buffer;
+    std::vector<Frame> frames;
+    size_t beginElement();
+    void maybeFlush();
+};
 } // namespace sexpr
 
 sexpr::SExprRef sexprFromString(std::string value);
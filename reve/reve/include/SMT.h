@@ -11,16 +11,19 @@
 #pragma once
 
 #include "SExpr.h"
+#include "Symbol.h"
 #include "Type.h"
 
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Instruction.h"
 
 #include <map>
 #include <set>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 
 #include "z3++.h"
 
@@ -29,19 +32,19 @@ namespace smt {
 // forward declare
 class SortedVar;
 class SMTExpr;
+class LetInliner;
 using SharedSMTRef = std::shared_ptr<SMTExpr>;
 
-using AssignmentVec =
-    llvm::SmallVector<std::pair<std::string, SharedSMTRef>, 3>;
+using AssignmentVec = llvm::SmallVector<std::pair<Symbol, SharedSMTRef>, 3>;
 
 struct AssignmentGroup {
     // A list of independent assignments that should be bound in a single let.
     AssignmentVec assgns;
     AssignmentGroup() {}
-    AssignmentGroup(std::string name, SharedSMTRef val) {
+    AssignmentGroup(Symbol name, SharedSMTRef val) {
         assgns.push_back({name, val});
     }
-    AssignmentGroup(std::pair<std::string, SharedSMTRef> def) {
+    AssignmentGroup(std::pair<Symbol, SharedSMTRef> def) {
         assgns.push_back(std::move(def));
     }
     AssignmentGroup(AssignmentVec assgns) : assgns(std::move(assgns)) {}
@@ -60,6 +63,36 @@ struct Z3DefineFun {
     z3::expr e;
 };
 
+// Memoizes the translation of expressions to z3 by their identity so that
+// shared subexpressions and repeated clauses are only translated once. Lets
+// and quantifiers that shadow a name open a new scope, the translations of
+// expressions below them are only reused within that scope.
+//
+// The cache must not outlive the expressions it has been used for and has to
+// be cleared when the declarations or definitions change.
+class Z3TranslationCache {
+  public:
+    auto lookup(const SMTExpr &expr) const -> const z3::expr *;
+    void insert(const SMTExpr &expr, z3::expr translation);
+    // Returns the previous scope which has to be passed to exitScope
+    auto enterScope() -> unsigned;
+    void exitScope(unsigned previousScope);
+    void clear();
+    auto size() const -> size_t { return translations.size(); }
+
+  private:
+    using Key = std::pair<const SMTExpr *, unsigned>;
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return std::hash<const SMTExpr *>()(key.first) ^
+                   (static_cast<size_t>(key.second) << 1);
+        }
+    };
+    std::unordered_map<Key, z3::expr, KeyHash> translations;
+    unsigned scope = 0;
+    unsigned nextScope = 1;
+};
+
 class SetLogic;
 class Assert;
 class TypedVariable;
@@ -82,58 +115,160 @@ class Comment;
 class VarDecl;
 
 struct SMTVisitor;
+
+// Remaining output of SMTExpr::writeSMTLib. Expressions write their leading
+// tokens directly and schedule their subexpressions and closing parentheses
+// here instead of writing them recursively. The items scheduled by one
+// expression are written in the order it has added them, before any item
+// that was still pending when the expression was written.
+class SMTLibSchedule {
+  public:
+    void write(const SMTExpr &expr) { items.push_back({&expr, {}, 0}); }
+    // Opens an application of head to the given number of arguments
+    void openApply(llvm::StringRef head, size_t argCount) {
+        items.push_back({nullptr, head, argCount});
+    }
+    void close() { items.push_back({nullptr, {}, 0}); }
+    void run(sexpr::SExprWriter &writer);
+
+  private:
+    // Closes the current list if neither expr nor head are set
+    struct Item {
+        const SMTExpr *expr;
+        llvm::StringRef head;
+        size_t argCount;
+    };
+    // Stack of the items that have not been written yet, the next one is at
+    // the back. run reverses the items scheduled by an expression to put
+    // them in this order.
+    std::vector<Item> items;
+};
+
+// Allows using llvm::isa and llvm::dyn_cast on SMT expressions
+enum class SMTExprKind {
+    SetLogic,
+    Assert,
+    TypedVariable,
+    Forall,
+    CheckSat,
+    GetModel,
+    Let,
+    ConstantFP,
+    ConstantInt,
+    ConstantBool,
+    ConstantString,
+    Op,
+    FPCmp,
+    BinaryFPOperator,
+    TypeCast,
+    Query,
+    FunDecl,
+    FunDef,
+    Comment,
+    VarDecl
+};
+
 class SMTExpr : public std::enable_shared_from_this<SMTExpr> {
   public:
     SMTExpr(const SMTExpr & /*unused*/) = default;
     SMTExpr &operator=(SMTExpr &) = delete;
     SMTExpr() = default;
     virtual ~SMTExpr() = default;
-    virtual std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const = 0;
-    virtual sexpr::SExprRef toSExpr() const = 0;
-    virtual std::vector<SharedSMTRef> splitConjunctions();
-    // TODO implement using visitor
-    virtual SharedSMTRef
-    mergeImplications(std::vector<SharedSMTRef> conditions);
+    virtual SMTExprKind getKind() const = 0;
+    // None of the following traversals recurse on the call stack, so the
+    // depth of an expression, e.g. of a long chain of lets, is only limited
+    // by the available memory.
+    auto accept(SMTVisitor &visitor) const -> std::shared_ptr<SMTExpr>;
+    // Direct subexpressions. For lets the bound values come before the body.
+    auto children() const -> std::vector<SharedSMTRef>;
+    virtual size_t childCount() const { return 0; }
+    virtual auto child(size_t index) const -> const SharedSMTRef &;
+    // Copy of this expression with the subexpressions returned by children()
+    // replaced by the given ones
+    virtual SharedSMTRef withChildren(std::vector<SharedSMTRef> newChildren);
+    auto toSExpr() const -> sexpr::SExprRef;
+    // Builds the SExpr of this expression from the SExprs of its children
+    virtual sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const = 0;
+    // Writes the same text as toSExpr()->serialize without building the
+    // SExpr
+    void writeSMTLib(sexpr::SExprWriter &writer) const;
+    // Writes the leading tokens of this expression and schedules the
+    // remaining output. The default implementation writes toSExpr.
+    virtual void scheduleSMTLib(sexpr::SExprWriter &writer,
+                                SMTLibSchedule &schedule) const;
+    auto splitConjunctions() -> std::vector<SharedSMTRef>;
+    auto mergeImplications(std::vector<SharedSMTRef> conditions)
+        -> SharedSMTRef;
     virtual std::unique_ptr<const HeapInfo> heapInfo() const;
-    virtual SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments);
+    // Substitute all let bindings. Shared subexpressions are only rewritten
+    // once per scope so this is linear in the size of the expression DAG.
+    auto inlineLets() -> SharedSMTRef;
     virtual void toZ3(z3::context &cxt, z3::solver &solver,
                       llvm::StringMap<z3::expr> &nameMap,
-                      llvm::StringMap<Z3DefineFun> &defineFunMap) const;
+                      llvm::StringMap<Z3DefineFun> &defineFunMap,
+                      Z3TranslationCache &cache) const;
+    // Translations of expressions with subexpressions are looked up in and
+    // added to the cache, everything else is passed to translateToZ3.
+    auto toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  Z3TranslationCache &cache) const -> z3::expr;
+    // Translates this expression given the translations of its children.
+    // Names bound by lets and quantifiers are already in nameMap.
     virtual z3::expr
-    toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-             const llvm::StringMap<Z3DefineFun> &defineFunMap) const;
+    translateToZ3(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  llvm::ArrayRef<z3::expr> operands) const;
     // Needed because we compile without rtti and thereby can’t use a dynamic
     // cast to check the type
     virtual bool isConstantFalse() const { return false; }
+
+  protected:
+    // Drops the reference to a subexpression. Expressions with children call
+    // this from their destructor so that destroying a deep expression does
+    // not recurse on the call stack.
+    static void releaseChild(SharedSMTRef &expr);
 };
 
 using SMTRef = std::unique_ptr<SMTExpr>;
-auto makeAssignment(std::string name, std::unique_ptr<SMTExpr> val)
+auto makeAssignment(Symbol name, std::unique_ptr<SMTExpr> val)
     -> std::unique_ptr<AssignmentGroup>;
 
 class SetLogic : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::SetLogic; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::SetLogic;
+    }
     explicit SetLogic(std::string logic) : logic(std::move(logic)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
+    void toZ3(z3::context &cxt, z3::solver &solver,
+              llvm::StringMap<z3::expr> &nameMap,
+              llvm::StringMap<Z3DefineFun> &defineFunMap,
+              Z3TranslationCache &cache) const override;
     std::string logic;
 };
 
 class Assert : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::Assert; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::Assert;
+    }
     std::shared_ptr<SMTExpr> expr;
     explicit Assert(std::shared_ptr<SMTExpr> expr) : expr(std::move(expr)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
-    SharedSMTRef
-    mergeImplications(std::vector<SharedSMTRef> conditions) override;
-    std::vector<SharedSMTRef> splitConjunctions() override;
-    SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments) override;
+    ~Assert() override;
+    size_t childCount() const override;
+    auto child(size_t index) const -> const SharedSMTRef & override;
+    SharedSMTRef withChildren(std::vector<SharedSMTRef> newChildren) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     void toZ3(z3::context &cxt, z3::solver &solver,
               llvm::StringMap<z3::expr> &nameMap,
-              llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+              llvm::StringMap<Z3DefineFun> &defineFunMap,
+              Z3TranslationCache &cache) const override;
 };
 
 // TypedVariable is simply a reference to a variable with a type attached to it,
@@ -141,31 +276,36 @@ class Assert : public SMTExpr {
 // forall
 class TypedVariable : public SMTExpr {
   public:
-    std::string name;
+    SMTExprKind getKind() const override { return SMTExprKind::TypedVariable; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::TypedVariable;
+    }
+    Symbol name;
     Type type;
-    TypedVariable(std::string name, Type type)
+    TypedVariable(Symbol name, Type type)
         : name(std::move(name)), type(std::move(type)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
     std::unique_ptr<const HeapInfo> heapInfo() const override;
-    sexpr::SExprRef toSExpr() const override;
-    SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     z3::expr
-    toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-             const llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+    translateToZ3(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  llvm::ArrayRef<z3::expr> operands) const override;
 };
 
 class SortedVar {
   public:
-    std::string name;
+    Symbol name;
     Type type;
-    SortedVar(std::string name, Type type)
+    SortedVar(Symbol name, Type type)
         : name(std::move(name)), type(std::move(type)) {}
     sexpr::SExprRef toSExpr() const;
+    void writeSMTLib(sexpr::SExprWriter &writer) const;
 };
 
 inline bool operator<(const SortedVar &lhs, const SortedVar &rhs) {
-    return lhs.name < rhs.name;
+    return lhs.name.str() < rhs.name.str();
 }
 
 inline bool operator>(const SortedVar &lhs, const SortedVar &rhs) {
@@ -190,39 +330,63 @@ inline bool operator!=(const SortedVar &lhs, const SortedVar &rhs) {
 
 class Forall : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::Forall; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::Forall;
+    }
     std::vector<SortedVar> vars;
     std::shared_ptr<SMTExpr> expr;
     Forall(std::vector<SortedVar> vars, std::shared_ptr<SMTExpr> expr)
         : vars(std::move(vars)), expr(std::move(expr)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
-    SharedSMTRef
-    mergeImplications(std::vector<SharedSMTRef> conditions) override;
-    std::vector<SharedSMTRef> splitConjunctions() override;
-    SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments) override;
+    ~Forall() override;
+    size_t childCount() const override;
+    auto child(size_t index) const -> const SharedSMTRef & override;
+    SharedSMTRef withChildren(std::vector<SharedSMTRef> newChildren) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
+    z3::expr
+    translateToZ3(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  llvm::ArrayRef<z3::expr> operands) const override;
 };
 
 class CheckSat : public SMTExpr {
   public:
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    SMTExprKind getKind() const override { return SMTExprKind::CheckSat; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::CheckSat;
+    }
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     void toZ3(z3::context &cxt, z3::solver &solver,
               llvm::StringMap<z3::expr> &nameMap,
-              llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+              llvm::StringMap<Z3DefineFun> &defineFunMap,
+              Z3TranslationCache &cache) const override;
 };
 
 class GetModel : public SMTExpr {
   public:
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    SMTExprKind getKind() const override { return SMTExprKind::GetModel; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::GetModel;
+    }
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     void toZ3(z3::context &cxt, z3::solver &solver,
               llvm::StringMap<z3::expr> &nameMap,
-              llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+              llvm::StringMap<Z3DefineFun> &defineFunMap,
+              Z3TranslationCache &cache) const override;
 };
 
 class Let : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::Let; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::Let;
+    }
     AssignmentGroup defs;
     std::shared_ptr<SMTExpr> expr;
     Let(AssignmentGroup defs, std::shared_ptr<SMTExpr> expr)
@@ -233,48 +397,64 @@ class Let : public SMTExpr {
             defs.assgns.push_back(def);
         }
     }
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
-    SharedSMTRef
-    mergeImplications(std::vector<SharedSMTRef> conditions) override;
-    std::vector<SharedSMTRef> splitConjunctions() override;
-    SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments) override;
+    ~Let() override;
+    size_t childCount() const override;
+    auto child(size_t index) const -> const SharedSMTRef & override;
+    SharedSMTRef withChildren(std::vector<SharedSMTRef> newChildren) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     z3::expr
-    toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-             const llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+    translateToZ3(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  llvm::ArrayRef<z3::expr> operands) const override;
 };
 
 // We could unify these in a generic type but it’s probably not worth the
 // trouble
 class ConstantFP : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::ConstantFP; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::ConstantFP;
+    }
     llvm::APFloat value;
     explicit ConstantFP(const llvm::APFloat value) : value(value) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
 };
 
 class ConstantInt : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::ConstantInt; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::ConstantInt;
+    }
     llvm::APInt value;
     explicit ConstantInt(const llvm::APInt value) : value(value) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     z3::expr
-    toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-             const llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+    translateToZ3(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  llvm::ArrayRef<z3::expr> operands) const override;
 };
 
 class ConstantBool : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::ConstantBool; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::ConstantBool;
+    }
     bool value;
     explicit ConstantBool(bool value) : value(value) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     z3::expr
-    toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-             const llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+    translateToZ3(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  llvm::ArrayRef<z3::expr> operands) const override;
     bool isConstantFalse() const override { return !value; }
 };
 
@@ -282,43 +462,56 @@ class ConstantBool : public SMTExpr {
 // just be included literally
 class ConstantString : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::ConstantString; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::ConstantString;
+    }
     std::string value;
     explicit ConstantString(std::string value) : value(value) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override; //  {
-    SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     z3::expr
-    toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-             const llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+    translateToZ3(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  llvm::ArrayRef<z3::expr> operands) const override;
 };
 
 class Op : public SMTExpr {
   public:
-    std::string opName;
+    SMTExprKind getKind() const override { return SMTExprKind::Op; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::Op;
+    }
+    Symbol opName;
     std::vector<std::shared_ptr<SMTExpr>> args;
     // whether to instantiate arrays for eldarica or not
     bool instantiate;
-    Op(std::string opName, std::vector<std::shared_ptr<SMTExpr>> args)
+    Op(Symbol opName, std::vector<std::shared_ptr<SMTExpr>> args)
         : opName(std::move(opName)), args(std::move(args)), instantiate(true) {}
-    Op(std::string opName, std::vector<std::shared_ptr<SMTExpr>> args,
+    Op(Symbol opName, std::vector<std::shared_ptr<SMTExpr>> args,
        bool instantiate)
         : opName(std::move(opName)), args(std::move(args)),
           instantiate(instantiate) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
-    SharedSMTRef
-    mergeImplications(std::vector<SharedSMTRef> conditions) override;
-    std::vector<SharedSMTRef> splitConjunctions() override;
-    SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments) override;
+    ~Op() override;
+    size_t childCount() const override;
+    auto child(size_t index) const -> const SharedSMTRef & override;
+    SharedSMTRef withChildren(std::vector<SharedSMTRef> newChildren) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     z3::expr
-    toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-             const llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+    translateToZ3(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  llvm::ArrayRef<z3::expr> operands) const override;
 };
 
 class FPCmp : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::FPCmp; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::FPCmp;
+    }
     enum class Predicate {
         False,
         OEQ,
@@ -346,14 +539,21 @@ class FPCmp : public SMTExpr {
     SharedSMTRef op1;
     FPCmp(Predicate op, Type type, SharedSMTRef op0, SharedSMTRef op1)
         : op(op), type(std::move(type)), op0(op0), op1(op1) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
-    SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments) override;
+    ~FPCmp() override;
+    size_t childCount() const override;
+    auto child(size_t index) const -> const SharedSMTRef & override;
+    SharedSMTRef withChildren(std::vector<SharedSMTRef> newChildren) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
 };
 
 class BinaryFPOperator : public SMTExpr {
   public:
+    SMTExprKind getKind() const override {
+        return SMTExprKind::BinaryFPOperator;
+    }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::BinaryFPOperator;
+    }
     enum class Opcode { FAdd, FSub, FMul, FDiv, FRem };
     Opcode op;
     Type type;
@@ -363,14 +563,19 @@ class BinaryFPOperator : public SMTExpr {
                      std::shared_ptr<SMTExpr> op1)
         : op(std::move(op)), type(std::move(type)), op0(std::move(op0)),
           op1(std::move(op1)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
-    SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments) override;
+    ~BinaryFPOperator() override;
+    size_t childCount() const override;
+    auto child(size_t index) const -> const SharedSMTRef & override;
+    SharedSMTRef withChildren(std::vector<SharedSMTRef> newChildren) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
 };
 
 class TypeCast : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::TypeCast; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::TypeCast;
+    }
     llvm::Instruction::CastOps op;
     Type sourceType;
     Type destType;
@@ -380,22 +585,28 @@ class TypeCast : public SMTExpr {
              std::shared_ptr<SMTExpr> operand)
         : op(std::move(op)), sourceType(std::move(sourceType)),
           destType(std::move(destType)), operand(std::move(operand)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
-    SharedSMTRef
-    inlineLets(std::map<std::string, SharedSMTRef> assignments) override;
+    ~TypeCast() override;
+    size_t childCount() const override;
+    auto child(size_t index) const -> const SharedSMTRef & override;
+    SharedSMTRef withChildren(std::vector<SharedSMTRef> newChildren) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
     z3::expr
-    toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &,
-             const llvm::StringMap<Z3DefineFun> &funMap) const override;
+    translateToZ3(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                  const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  llvm::ArrayRef<z3::expr> operands) const override;
 };
 
 class Query : public SMTExpr {
-    std::string queryName;
-
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::Query; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::Query;
+    }
+    std::string queryName;
     Query(std::string queryName) : queryName(std::move(queryName)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
 };
 
 auto stringExpr(llvm::StringRef name) -> std::unique_ptr<ConstantString>;
@@ -404,65 +615,99 @@ auto makeSMTRef(std::shared_ptr<SMTExpr> arg) -> std::shared_ptr<SMTExpr>;
 auto makeSMTRef(std::string arg) -> std::shared_ptr<SMTExpr>;
 
 template <typename... Args>
-auto makeOp(std::string opName, Args... args) -> std::unique_ptr<Op> {
+auto makeOp(Symbol opName, Args... args) -> std::unique_ptr<Op> {
     std::vector<std::shared_ptr<SMTExpr>> args_ = {
         makeSMTRef(std::move(args))...};
     return std::make_unique<Op>(opName, args_);
 }
 
-auto makeOp(std::string opName, std::vector<std::string> args)
+auto makeOp(Symbol opName, std::vector<std::string> args)
     -> std::unique_ptr<const Op>;
 
 class FunDecl : public SMTExpr {
   public:
-    std::string funName;
+    SMTExprKind getKind() const override { return SMTExprKind::FunDecl; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::FunDecl;
+    }
+    Symbol funName;
     std::vector<Type> inTypes;
     Type outType;
 
-    FunDecl(std::string funName, std::vector<Type> inTypes, Type outType)
+    FunDecl(Symbol funName, std::vector<Type> inTypes, Type outType)
         : funName(std::move(funName)), inTypes(std::move(inTypes)),
           outType(std::move(outType)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
+    void toZ3(z3::context &cxt, z3::solver &solver,
+              llvm::StringMap<z3::expr> &nameMap,
+              llvm::StringMap<Z3DefineFun> &defineFunMap,
+              Z3TranslationCache &cache) const override;
 };
 
 class FunDef : public SMTExpr {
   public:
-    std::string funName;
+    SMTExprKind getKind() const override { return SMTExprKind::FunDef; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::FunDef;
+    }
+    Symbol funName;
     std::vector<SortedVar> args;
     Type outType;
     std::shared_ptr<SMTExpr> body;
 
-    FunDef(std::string funName, std::vector<SortedVar> args, Type outType,
+    FunDef(Symbol funName, std::vector<SortedVar> args, Type outType,
            std::shared_ptr<SMTExpr> body)
         : funName(std::move(funName)), args(std::move(args)),
           outType(std::move(outType)), body(std::move(body)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    ~FunDef() override;
+    size_t childCount() const override;
+    auto child(size_t index) const -> const SharedSMTRef & override;
+    SharedSMTRef withChildren(std::vector<SharedSMTRef> newChildren) override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     void toZ3(z3::context &cxt, z3::solver &solver,
               llvm::StringMap<z3::expr> &nameMap,
-              llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+              llvm::StringMap<Z3DefineFun> &defineFunMap,
+              Z3TranslationCache &cache) const override;
 };
 
 class Comment : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::Comment; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::Comment;
+    }
     std::string val;
 
     Comment(std::string val) : val(std::move(val)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
+    void toZ3(z3::context &cxt, z3::solver &solver,
+              llvm::StringMap<z3::expr> &nameMap,
+              llvm::StringMap<Z3DefineFun> &defineFunMap,
+              Z3TranslationCache &cache) const override;
 };
 
 class VarDecl : public SMTExpr {
   public:
+    SMTExprKind getKind() const override { return SMTExprKind::VarDecl; }
+    static bool classof(const SMTExpr *expr) {
+        return expr->getKind() == SMTExprKind::VarDecl;
+    }
     SortedVar var;
 
     VarDecl(SortedVar var) : var(std::move(var)) {}
-    std::shared_ptr<SMTExpr> accept(SMTVisitor &visitor) const override;
-    sexpr::SExprRef toSExpr() const override;
+    sexpr::SExprRef assembleSExpr(sexpr::SExprVec operands) const override;
+    void scheduleSMTLib(sexpr::SExprWriter &writer,
+                        SMTLibSchedule &schedule) const override;
     void toZ3(z3::context &cxt, z3::solver &solver,
               llvm::StringMap<z3::expr> &nameMap,
-              llvm::StringMap<Z3DefineFun> &defineFunMap) const override;
+              llvm::StringMap<Z3DefineFun> &defineFunMap,
+              Z3TranslationCache &cache) const override;
 };
 
 // This visitor first does a top-down traversal and calls 'dispatch' on each
@@ -558,6 +803,42 @@ struct SMTVisitor {
     }
 };
 
+// Environment used by inlineLets. Bindings are kept in a stack per name and
+// removed again when their scope is left instead of copying the environment
+// for every subexpression. Each scope has a unique id which together with the
+// address of a node identifies the result of inlining that node.
+class LetInliner {
+    // nullptr marks a name that is bound by a quantifier and thereby shadows
+    // outer let bindings
+    SymbolMap<llvm::SmallVector<SharedSMTRef, 1>> bindings;
+    std::vector<Symbol> boundNames;
+    struct Scope {
+        unsigned id;
+        size_t boundNamesBegin;
+    };
+    std::vector<Scope> scopes;
+    unsigned nextScopeId = 1;
+    using MemoKey = std::pair<const SMTExpr *, unsigned>;
+    struct MemoKeyHash {
+        size_t operator()(const MemoKey &key) const {
+            return std::hash<const SMTExpr *>()(key.first) ^
+                   (std::hash<unsigned>()(key.second) << 1);
+        }
+    };
+    std::unordered_map<MemoKey, SharedSMTRef, MemoKeyHash> memo;
+
+  public:
+    LetInliner() : scopes({{0, 0}}) {}
+    // Inline the lets in expr using the current bindings
+    auto inlineLets(SMTExpr &expr) -> SharedSMTRef;
+    auto lookup(const Symbol &name) const -> SharedSMTRef;
+    void enterScope();
+    void exitScope();
+    // Bindings only affect the current scope
+    void bind(const Symbol &name, SharedSMTRef value);
+    void shadow(const Symbol &name) { bind(name, nullptr); }
+};
+
 auto nestLets(SharedSMTRef clause, llvm::ArrayRef<AssignmentGroup> defs)
     -> SharedSMTRef;
 
@@ -0,0 +1,34 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include "MonoPair.h"
+#include "Opts.h"
+
+#include "llvm/IR/Module.h"
+
+// The cache maps a hash of everything that influences the generated SMT to
+// the serialized SMT. This allows skipping SMT generation and serialization
+// for programs that have been verified before.
+
+// Computes the cache key from the preprocessed modules and the options. The
+// options for SMT generation are taken from SMTGenerationOpts so it has to be
+// initialized already.
+auto smtCacheKey(MonoPair<const llvm::Module &> modules,
+                 const llreve::opts::PreprocessOpts &preprocessOpts,
+                 const llreve::opts::FileOptions &fileOpts,
+                 const llreve::opts::SerializeOpts &serializeOpts,
+                 llvm::StringRef version) -> std::string;
+// Returns true and sets smt if there is an entry for the key
+auto lookupSMTCache(llvm::StringRef cacheDir, llvm::StringRef key,
+                    std::string &smt) -> bool;
+auto storeSMTCache(llvm::StringRef cacheDir, llvm::StringRef key,
+                   llvm::StringRef smt) -> void;
@@ -0,0 +1,86 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include "SMT.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+
+#include <utility>
+#include <vector>
+
+namespace smt {
+
+// Base for passes used with traversePostOrder. Result is the value computed
+// for each expression. Apart from the hooks below, a pass has to provide
+//
+//   auto enter(Expr &expr) -> llvm::Optional<Result>
+//     Called when expr is reached. If a result is returned, the children of
+//     expr are skipped, e.g. for leaves or memoized expressions.
+//   auto leave(Expr &expr, std::vector<Result> results) -> Result
+//     Called with the results of the traversed children.
+//
+// where Expr is either SMTExpr or const SMTExpr.
+template <typename ResultT> struct PostOrderPass {
+    using Result = ResultT;
+    // Indices of the children that are traversed, all of them by default
+    auto traversedChildren(const SMTExpr &expr) -> std::pair<size_t, size_t> {
+        return {0, expr.childCount()};
+    }
+    // Called before the child at the given index is traversed, results
+    // contains the results of the children traversed so far
+    void beforeChild(const SMTExpr & /* unused */, size_t /* unused */,
+                     llvm::ArrayRef<Result> /* unused */) {}
+};
+
+// Post-order traversal using an explicit stack so that arbitrarily deep
+// expressions can be traversed without exhausting the call stack
+template <typename Pass, typename Expr>
+auto traversePostOrder(Expr &root, Pass &pass) -> typename Pass::Result {
+    using Result = typename Pass::Result;
+    struct Frame {
+        Expr *expr;
+        size_t nextChild;
+        size_t endChild;
+        std::vector<Result> results;
+    };
+    std::vector<Frame> stack;
+    auto push = [&stack, &pass](Expr &expr) {
+        auto range = pass.traversedChildren(expr);
+        stack.push_back({&expr, range.first, range.second, {}});
+    };
+    llvm::Optional<Result> result = pass.enter(root);
+    if (!result) {
+        push(root);
+    }
+    while (!stack.empty()) {
+        Frame &frame = stack.back();
+        if (result) {
+            frame.results.push_back(std::move(*result));
+            result.reset();
+        }
+        if (frame.nextChild < frame.endChild) {
+            size_t index = frame.nextChild++;
+            pass.beforeChild(*frame.expr, index, frame.results);
+            Expr &child = *frame.expr->child(index);
+            result = pass.enter(child);
+            if (!result) {
+                push(child);
+            }
+        } else {
+            result = pass.leave(*frame.expr, std::move(frame.results));
+            stack.pop_back();
+        }
+    }
+    return std::move(*result);
+}
+}
@@ -10,11 +10,41 @@
 
 #pragma once
 
+#include "BoundedQueue.h"
 #include "Opts.h"
 #include "SMT.h"
 
+#include <ostream>
+#include <thread>
+
 void serializeSMT(std::vector<smt::SharedSMTRef> smtExprs, bool muZ,
                   llreve::opts::SerializeOpts opts);
+// Same as above but writes to the given stream ignoring opts.OutputFileName
+void serializeSMT(std::vector<smt::SharedSMTRef> smtExprs, bool muZ,
+                  llreve::opts::SerializeOpts opts, std::ostream &outFile);
+// Write already serialized SMT to the output file or stdout
+void writeSerializedSMT(const std::string &smt,
+                        const llreve::opts::SerializeOpts &opts);
+
+// Serializes toplevel expressions while they are still being generated. Each
+// expression is handed to a separate thread which rewrites it and writes it to
+// the output, after which it is released. Expressions are written in the order
+// they have been pushed. The muZ format needs to know all variables before the
+// first clause, so only the SMT-Horn format is supported.
+class StreamingSerializer {
+    llreve::opts::SerializeOpts opts;
+    BoundedQueue<smt::SharedSMTRef> queue;
+    std::thread consumer;
+
+  public:
+    // capacity limits the number of expressions waiting to be serialized
+    StreamingSerializer(llreve::opts::SerializeOpts opts, std::ostream &outFile,
+                        size_t capacity);
+    ~StreamingSerializer();
+    void push(smt::SharedSMTRef expr);
+    // Wait until everything that has been pushed is written
+    void finish();
+};
 
 // Remove forall and collect quantified variables. These variables are then
 // declared as global variables for Z3.
@@ -0,0 +1,33 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+// Runs a single verification job. The arguments follow the usual command line
+// conventions, i.e. argv[0] is the name of the executable. The return value is
+// used as the exit code of the job.
+using JobRunner = std::function<int(int argc, const char **argv)>;
+
+// Jobs are JSON objects on a single line, e.g.
+//   {"id": 1, "files": ["a.c", "b.c"], "fun": "f", "args": ["-heap"]}
+// For each job one line is written back containing the id, the exit code and
+// everything the job printed to stdout:
+//   {"id": 1, "exit_code": 0, "output": "..."}
+// Every job is run in a forked copy of the server so global state can’t leak
+// between jobs and errors only terminate the job.
+
+// Serve jobs read from stdin, responses are written to stdout.
+auto serveStdin(const char *exeName, const JobRunner &runJob) -> int;
+// Serve jobs on a unix domain socket. Connections are handled one at a time.
+auto serveSocket(const char *exeName, const std::string &socketPath,
+                 const JobRunner &runJob) -> int;
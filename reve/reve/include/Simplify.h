@@ -0,0 +1,40 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include "SMT.h"
+
+#include <ostream>
+
+namespace smt {
+
+struct SimplificationStats {
+    // Operations on literals that have been replaced by their result
+    unsigned foldedConstants = 0;
+    // and, or, =>, ite that have been simplified because of literal operands
+    unsigned simplifiedConnectives = 0;
+    unsigned removedDoubleNegations = 0;
+    // Assertions that have been dropped because they are trivially true
+    unsigned removedAssertions = 0;
+    void print(std::ostream &out) const;
+};
+
+// Fold constants, remove literals from boolean connectives and flatten nested
+// conjunctions and disjunctions. The result is equivalent to expr.
+auto simplify(const SMTExpr &expr, SimplificationStats &stats) -> SharedSMTRef;
+// Same as above but returns nullptr if expr is an assertion that is trivially
+// true and can be dropped
+auto simplifyAssertion(const SMTExpr &expr, SimplificationStats &stats)
+    -> SharedSMTRef;
+auto simplifyAssertions(std::vector<SharedSMTRef> exprs,
+                        SimplificationStats &stats)
+    -> std::vector<SharedSMTRef>;
+}
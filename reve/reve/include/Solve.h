@@ -0,0 +1,20 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include "SMT.h"
+
+enum class SolveResult { Equal, NotEqual, Unknown };
+
+// Solve the horn clauses produced by generateSMT using the fixedpoint engine
+// of Z3 directly instead of going through an external solver process.
+auto solveSMT(const std::vector<smt::SharedSMTRef> &smtExprs) -> SolveResult;
+auto solveResultName(SolveResult result) -> const char *;
@@ -0,0 +1,105 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace smt {
+
+// An interned name. All symbols with the same name share a single string in a
+// global pool, so copying, comparing and hashing a symbol only involves a
+// pointer. Creating a symbol from a string has to look it up in the pool. The
+// lookup is thread safe and only takes a lock the first time a thread sees a
+// name, but it still hashes the name, so symbols should be kept around instead
+// of being recreated from their names.
+//
+// There is deliberately no operator< since the order of the pointers depends on
+// the order in which names have been interned. Use str() if the order is
+// observable.
+class Symbol {
+    const std::string *name;
+
+  public:
+    Symbol();
+    Symbol(llvm::StringRef name);
+    Symbol(const std::string &name) : Symbol(llvm::StringRef(name)) {}
+    Symbol(const char *name) : Symbol(llvm::StringRef(name)) {}
+
+    const std::string &str() const { return *name; }
+    // Unique for every name as long as the process is running
+    uintptr_t id() const { return reinterpret_cast<uintptr_t>(name); }
+    operator const std::string &() const { return *name; }
+    operator llvm::StringRef() const { return *name; }
+    bool empty() const { return name->empty(); }
+    size_t size() const { return name->size(); }
+
+    friend bool operator==(const Symbol &lhs, const Symbol &rhs) {
+        return lhs.name == rhs.name;
+    }
+    friend bool operator==(const Symbol &lhs, const char *rhs) {
+        return *lhs.name == rhs;
+    }
+    friend bool operator==(const Symbol &lhs, const std::string &rhs) {
+        return *lhs.name == rhs;
+    }
+    friend bool operator==(const Symbol &lhs, llvm::StringRef rhs) {
+        return llvm::StringRef(*lhs.name) == rhs;
+    }
+    template <typename T>
+    friend bool operator==(const T &lhs, const Symbol &rhs) {
+        return rhs == lhs;
+    }
+    friend bool operator!=(const Symbol &lhs, const Symbol &rhs) {
+        return lhs.name != rhs.name;
+    }
+    template <typename T>
+    friend bool operator!=(const Symbol &lhs, const T &rhs) {
+        return !(lhs == rhs);
+    }
+    template <typename T>
+    friend bool operator!=(const T &lhs, const Symbol &rhs) {
+        return !(rhs == lhs);
+    }
+    friend std::string operator+(const Symbol &lhs, const std::string &rhs) {
+        return *lhs.name + rhs;
+    }
+    friend std::string operator+(const std::string &lhs, const Symbol &rhs) {
+        return lhs + *rhs.name;
+    }
+    friend std::string operator+(const Symbol &lhs, const char *rhs) {
+        return *lhs.name + rhs;
+    }
+    friend std::string operator+(const char *lhs, const Symbol &rhs) {
+        return lhs + *rhs.name;
+    }
+    friend std::ostream &operator<<(std::ostream &os, const Symbol &symbol) {
+        return os << *symbol.name;
+    }
+};
+}
+
+namespace std {
+template <> struct hash<smt::Symbol> {
+    size_t operator()(const smt::Symbol &symbol) const {
+        return std::hash<uintptr_t>()(symbol.id());
+    }
+};
+}
+
+namespace smt {
+template <typename T> using SymbolMap = std::unordered_map<Symbol, T>;
+}
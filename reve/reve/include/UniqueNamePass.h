@@ -11,16 +11,18 @@
 #pragma once
 
 #include <map>
+#include <string>
 
 #include "llvm/IR/PassManager.h"
 #include "llvm/IR/Value.h"
 
 class UniqueNamePass : public llvm::PassInfoMixin<UniqueNamePass> {
   public:
+    explicit UniqueNamePass(std::string prefix) : Prefix(std::move(prefix)) {}
     llvm::PreservedAnalyses run(llvm::Function &F,
                                 llvm::FunctionAnalysisManager &am);
-    // I haven’t figured out how to pass parameters to a pass
-    static std::string Prefix;
+    // Not static so both programs can be preprocessed concurrently
+    std::string Prefix;
 };
 
 void makePrefixed(llvm::Value &Val, std::string Prefix,
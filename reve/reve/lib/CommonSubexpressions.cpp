@@ -0,0 +1,340 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#include "CommonSubexpressions.h"
+
+#include "HashCons.h"
+#include "SMTTraversal.h"
+
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+using std::make_shared;
+using std::string;
+using std::vector;
+
+namespace smt {
+
+// Smaller terms are not worth a separate definition
+static const unsigned minGlobalSize = 6;
+static const unsigned minLocalSize = 3;
+
+static const std::set<string> boolOps = {
+    "and",   "or",    "not",   "=>",    "=",     "distinct", "<",
+    "<=",    ">",     ">=",    "bvslt", "bvsle", "bvsgt",    "bvsge",
+    "bvult", "bvule", "bvugt", "bvuge"};
+
+struct TermInfo {
+    // Number of nodes if the term is written as a tree
+    unsigned size = 1;
+    // The term only consists of variables and literals
+    bool closed = true;
+    bool hasVariables = false;
+    // Number of assertions containing the term
+    unsigned assertions = 0;
+    // Number of references to the term in the last assertion
+    unsigned occurrences = 0;
+    size_t lastAssertion = 0;
+};
+
+using TermInfoMap = std::unordered_map<const SMTExpr *, TermInfo>;
+
+static bool isBinder(const SMTExpr &expr) {
+    return llvm::isa<Forall>(expr) || llvm::isa<Let>(expr);
+}
+
+static bool isLiteral(const SMTExpr &expr) {
+    return llvm::isa<ConstantInt>(expr) || llvm::isa<ConstantBool>(expr) ||
+           llvm::isa<ConstantFP>(expr);
+}
+
+static bool hasBoolResult(const SMTExpr &expr) {
+    if (llvm::isa<FPCmp>(expr)) {
+        return true;
+    }
+    if (const auto op = llvm::dyn_cast<Op>(&expr)) {
+        return boolOps.count(op->opName.str()) > 0;
+    }
+    return false;
+}
+
+// Assertions have the form (assert (forall (vars) body)) where the forall is
+// omitted if there are no variables. Returns nullptr for other commands.
+static SharedSMTRef clauseBody(const SMTExpr &expr) {
+    const auto assertion = llvm::dyn_cast<Assert>(&expr);
+    if (!assertion) {
+        return nullptr;
+    }
+    if (const auto forall = llvm::dyn_cast<Forall>(assertion->expr.get())) {
+        return forall->expr;
+    }
+    return assertion->expr;
+}
+
+static SharedSMTRef withClauseBody(const SMTExpr &expr, SharedSMTRef body) {
+    const auto &assertion = llvm::cast<Assert>(expr);
+    if (const auto forall = llvm::dyn_cast<Forall>(assertion.expr.get())) {
+        return make_shared<Assert>(make_shared<Forall>(forall->vars, body));
+    }
+    return make_shared<Assert>(body);
+}
+
+// The expressions are DAGs after interning. A term that is reached again
+// within the same assertion only increments its count, its children are not
+// visited again.
+struct CollectTermsPass : PostOrderPass<const TermInfo *> {
+    size_t assertion;
+    TermInfoMap &terms;
+    CollectTermsPass(size_t assertion, TermInfoMap &terms)
+        : assertion(assertion), terms(terms) {}
+
+    auto enter(const SMTExpr &expr) -> llvm::Optional<const TermInfo *> {
+        auto inserted = terms.insert({&expr, TermInfo()});
+        TermInfo &term = inserted.first->second;
+        if (!inserted.second && term.lastAssertion == assertion) {
+            ++term.occurrences;
+            return &term;
+        }
+        term.lastAssertion = assertion;
+        term.occurrences = 1;
+        ++term.assertions;
+        if (isBinder(expr)) {
+            // Terms below binders can reference the bound variables
+            term.closed = false;
+            return &term;
+        }
+        if (expr.childCount() == 0) {
+            term.closed = llvm::isa<TypedVariable>(expr) || isLiteral(expr);
+            term.hasVariables = llvm::isa<TypedVariable>(expr);
+            return &term;
+        }
+        return llvm::None;
+    }
+    auto leave(const SMTExpr &expr, vector<const TermInfo *> results)
+        -> const TermInfo * {
+        unsigned size = 1;
+        bool closed = true;
+        bool hasVariables = false;
+        for (const TermInfo *childTerm : results) {
+            size += childTerm->size;
+            closed = closed && childTerm->closed;
+            hasVariables = hasVariables || childTerm->hasVariables;
+        }
+        // References into an unordered_map stay valid when it grows
+        TermInfo &term = terms.at(&expr);
+        term.size = size;
+        term.closed = closed;
+        term.hasVariables = hasVariables;
+        return &term;
+    }
+};
+
+static void collectTerms(const SMTExpr &expr, size_t assertion,
+                         TermInfoMap &terms) {
+    CollectTermsPass pass(assertion, terms);
+    traversePostOrder(expr, pass);
+}
+
+// Only the collected variables are of interest, every expression simply
+// returns itself
+struct CollectVariablesPass : PostOrderPass<const SMTExpr *> {
+    std::set<SortedVar> &vars;
+    std::unordered_set<const SMTExpr *> visited;
+    explicit CollectVariablesPass(std::set<SortedVar> &vars) : vars(vars) {}
+
+    auto enter(const SMTExpr &expr) -> llvm::Optional<const SMTExpr *> {
+        if (!visited.insert(&expr).second) {
+            return &expr;
+        }
+        if (const auto var = llvm::dyn_cast<TypedVariable>(&expr)) {
+            vars.insert({var->name, var->type});
+            return &expr;
+        }
+        return llvm::None;
+    }
+    auto leave(const SMTExpr &expr, vector<const SMTExpr *> /* unused */)
+        -> const SMTExpr * {
+        return &expr;
+    }
+};
+
+static void collectVariables(const SMTExpr &expr, std::set<SortedVar> &vars) {
+    CollectVariablesPass pass(vars);
+    traversePostOrder(expr, pass);
+}
+
+// Replaces the children of expr by the rewritten ones and only allocates a new
+// node if one of them has changed.
+static SharedSMTRef rewriteChildren(SMTExpr &expr,
+                                    vector<SharedSMTRef> newChildren) {
+    bool changed = false;
+    for (size_t i = 0; i < newChildren.size(); ++i) {
+        changed = changed || newChildren[i] != expr.child(i);
+    }
+    if (!changed) {
+        return expr.shared_from_this();
+    }
+    return expr.withChildren(std::move(newChildren));
+}
+
+struct GlobalDefinitions : PostOrderPass<SharedSMTRef> {
+    const TermInfoMap &terms;
+    std::unordered_map<const SMTExpr *, SharedSMTRef> replacements;
+    vector<SharedSMTRef> funDefs;
+    explicit GlobalDefinitions(const TermInfoMap &terms) : terms(terms) {}
+
+    bool isCandidate(const SMTExpr &expr, const TermInfo &term) const {
+        return term.assertions >= 2 && term.size >= minGlobalSize &&
+               term.closed && term.hasVariables && hasBoolResult(expr);
+    }
+
+    SharedSMTRef define(const SharedSMTRef &expr) {
+        std::set<SortedVar> vars;
+        collectVariables(*expr, vars);
+        string name = "CSE_" + std::to_string(funDefs.size());
+        vector<SharedSMTRef> args;
+        for (const auto &var : vars) {
+            args.push_back(make_shared<TypedVariable>(var.name, var.type));
+        }
+        funDefs.push_back(make_shared<FunDef>(
+            name, vector<SortedVar>(vars.begin(), vars.end()), boolType(),
+            expr));
+        return make_shared<Op>(name, std::move(args));
+    }
+
+    auto enter(SMTExpr &expr) -> llvm::Optional<SharedSMTRef> {
+        auto replacementIt = replacements.find(&expr);
+        if (replacementIt != replacements.end()) {
+            return replacementIt->second;
+        }
+        if (isCandidate(expr, terms.at(&expr))) {
+            SharedSMTRef result = define(expr.shared_from_this());
+            replacements.insert({&expr, result});
+            return result;
+        }
+        if (isBinder(expr) || expr.childCount() == 0) {
+            return expr.shared_from_this();
+        }
+        return llvm::None;
+    }
+    auto leave(SMTExpr &expr, vector<SharedSMTRef> results) -> SharedSMTRef {
+        SharedSMTRef result = rewriteChildren(expr, std::move(results));
+        replacements.insert({&expr, result});
+        return result;
+    }
+};
+
+struct LocalBindings : PostOrderPass<SharedSMTRef> {
+    const TermInfoMap &terms;
+    std::unordered_map<const SMTExpr *, SharedSMTRef> replacements;
+    // In the order in which they depend on each other
+    vector<AssignmentGroup> defs;
+    explicit LocalBindings(const TermInfoMap &terms) : terms(terms) {}
+
+    auto enter(SMTExpr &expr) -> llvm::Optional<SharedSMTRef> {
+        auto replacementIt = replacements.find(&expr);
+        if (replacementIt != replacements.end()) {
+            return replacementIt->second;
+        }
+        if (isBinder(expr) || expr.childCount() == 0) {
+            return expr.shared_from_this();
+        }
+        return llvm::None;
+    }
+    auto leave(SMTExpr &expr, vector<SharedSMTRef> results) -> SharedSMTRef {
+        const TermInfo &term = terms.at(&expr);
+        SharedSMTRef result = rewriteChildren(expr, std::move(results));
+        if (term.occurrences >= 2 && term.size >= minLocalSize) {
+            string name = "cse_" + std::to_string(defs.size());
+            defs.emplace_back(name, std::move(result));
+            result = stringExpr(name);
+        }
+        replacements.insert({&expr, result});
+        return result;
+    }
+};
+
+// expr has to be interned
+static SharedSMTRef bindInterned(const SharedSMTRef &expr) {
+    SharedSMTRef body = clauseBody(*expr);
+    if (!body) {
+        return expr;
+    }
+    TermInfoMap terms;
+    collectTerms(*body, 0, terms);
+    LocalBindings bindings(terms);
+    SharedSMTRef newBody = traversePostOrder(*body, bindings);
+    if (bindings.defs.empty()) {
+        return expr;
+    }
+    return withClauseBody(*expr, nestLets(newBody, bindings.defs));
+}
+
+auto eliminateCommonSubexpressions(vector<SharedSMTRef> exprs)
+    -> vector<SharedSMTRef> {
+    HashConsTable hashCons;
+    for (auto &expr : exprs) {
+        expr = hashCons.intern(*expr);
+    }
+
+    TermInfoMap terms;
+    for (size_t i = 0; i < exprs.size(); ++i) {
+        if (auto body = clauseBody(*exprs[i])) {
+            // Assertion indices start at 1 so that they differ from the
+            // default of lastAssertion
+            collectTerms(*body, i + 1, terms);
+        }
+    }
+    GlobalDefinitions globals(terms);
+    vector<SharedSMTRef> result;
+    bool definitionsPlaced = false;
+    for (auto &expr : exprs) {
+        SharedSMTRef body = clauseBody(*expr);
+        if (!body) {
+            result.push_back(std::move(expr));
+            continue;
+        }
+        if (!definitionsPlaced) {
+            // Reserve the position, the definitions are only known after all
+            // assertions have been rewritten
+            result.push_back(nullptr);
+            definitionsPlaced = true;
+        }
+        SharedSMTRef newBody = traversePostOrder(*body, globals);
+        result.push_back(
+            newBody == body ? std::move(expr) : withClauseBody(*expr, newBody));
+    }
+    terms.clear();
+
+    vector<SharedSMTRef> output;
+    for (auto &expr : result) {
+        if (!expr) {
+            output.insert(output.end(), globals.funDefs.begin(),
+                          globals.funDefs.end());
+        } else if (llvm::isa<Assert>(*expr)) {
+            // Rewritten assertions have to be interned again to find the
+            // local duplicates
+            output.push_back(bindInterned(hashCons.intern(*expr)));
+        } else {
+            output.push_back(std::move(expr));
+        }
+    }
+    return output;
+}
+
+auto bindCommonSubexpressions(SharedSMTRef expr) -> SharedSMTRef {
+    if (!llvm::isa<Assert>(*expr)) {
+        return expr;
+    }
+    HashConsTable hashCons;
+    return bindInterned(hashCons.intern(*expr));
+}
+}
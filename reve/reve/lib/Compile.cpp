@@ -12,11 +12,23 @@
 
 #include "Helper.h"
 
+#include "clang/Basic/Version.h"
 #include "clang/Driver/Compilation.h"
 #include "clang/Driver/Tool.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
 #include "clang/Frontend/FrontendDiagnostic.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <thread>
+#include <tuple>
 
 using clang::CodeGenAction;
 using clang::CompilerInstance;
@@ -36,8 +48,9 @@ using namespace llreve::opts;
 
 MonoPair<unique_ptr<llvm::Module>>
 compileToModules(const char *exeName, InputOpts &opts,
-                 std::pair<CodeGenAction &, CodeGenAction &> actions) {
-    executeCodeGenActions(exeName, opts, actions);
+                 std::pair<CodeGenAction &, CodeGenAction &> actions,
+                 DriverSetup *driverSetup) {
+    executeCodeGenActions(exeName, opts, actions, driverSetup);
 
     unique_ptr<llvm::Module> mod1 = actions.first.takeModule();
     unique_ptr<llvm::Module> mod2 = actions.second.takeModule();
@@ -52,26 +65,55 @@ compileToModules(const char *exeName, InputOpts &opts,
 /// CodeGenActions
 void executeCodeGenActions(
     const char *exeName, InputOpts &opts,
-    std::pair<CodeGenAction &, CodeGenAction &> actions) {
-    auto diags = initializeDiagnostics();
-    auto driver = initializeDriver(*diags);
+    std::pair<CodeGenAction &, CodeGenAction &> actions,
+    DriverSetup *driverSetup) {
+    DriverSetup localDriverSetup;
+    if (!driverSetup) {
+        localDriverSetup = initializeDriverSetup();
+        driverSetup = &localDriverSetup;
+    }
     auto args = initializeArgs(exeName, opts);
 
-    unique_ptr<Compilation> comp(driver->BuildCompilation(args));
+    unique_ptr<Compilation> comp(driverSetup->driver->BuildCompilation(args));
     if (!comp) {
         logError("Couldn’t initiate compilation\n");
         exit(1);
     }
 
-    auto cmdArgsOrError = getCmd(*comp, *diags);
+    auto cmdArgsOrError = getCmd(*comp, *driverSetup->diags);
     if (!cmdArgsOrError) {
         logError("Couldn’t get cmd args\n");
         exit(1);
     }
     auto cmdArgs = cmdArgsOrError.get();
 
-    executeCodeGenAction(cmdArgs.first, *diags, actions.first);
-    executeCodeGenAction(cmdArgs.second, *diags, actions.second);
+    // The two frontends are independent so they run concurrently. Each of
+    // them gets its own diagnostics engine and the actions use separate
+    // LLVMContexts. The diagnostics are buffered and printed in order once
+    // both frontends are done, so they don’t interleave. Exiting while the
+    // other thread is still inside clang is not safe, so failures are only
+    // reported after joining.
+    string diagOutput1;
+    string diagOutput2;
+    llvm::raw_string_ostream diagStream1(diagOutput1);
+    llvm::raw_string_ostream diagStream2(diagOutput2);
+    auto diags1 = initializeDiagnostics(diagStream1);
+    auto diags2 = initializeDiagnostics(diagStream2);
+    bool success2 = false;
+    std::thread secondFrontend(
+        [&cmdArgs, &diags2, &diagStream2, &actions, &opts, &success2] {
+            success2 =
+                executeCodeGenAction(cmdArgs.second, *diags2, actions.second,
+                                     opts.PCHCacheDir, diagStream2);
+        });
+    bool success1 = executeCodeGenAction(cmdArgs.first, *diags1, actions.first,
+                                         opts.PCHCacheDir, diagStream1);
+    secondFrontend.join();
+    llvm::errs() << diagStream1.str() << diagStream2.str();
+    if (!success1 || !success2) {
+        logError("Couldn’t execute action\n");
+        exit(1);
+    }
 }
 
 static ArgStringList filterCC1Args(const ArgStringList &ccArgs) {
@@ -86,25 +128,337 @@ static ArgStringList filterCC1Args(const ArgStringList &ccArgs) {
 }
 
 /// Build the CodeGenAction corresponding to the arguments
-void executeCodeGenAction(const ArgStringList &ccArgs,
-                          clang::DiagnosticsEngine &diags, CodeGenAction &act) {
+bool executeCodeGenAction(const ArgStringList &ccArgs,
+                          clang::DiagnosticsEngine &diags, CodeGenAction &act,
+                          llvm::StringRef pchCacheDir,
+                          llvm::raw_ostream &diagOutput) {
     ArgStringList filteredCcArgs = filterCC1Args(ccArgs);
     auto ci = std::make_unique<CompilerInvocation>();
     CompilerInvocation::CreateFromArgs(
         *ci, filteredCcArgs.data(),
         filteredCcArgs.data() + filteredCcArgs.size(), diags);
     ci->getFrontendOpts().DisableFree = false;
+    if (!pchCacheDir.empty() && ci->getFrontendOpts().Inputs.size() == 1 &&
+        ci->getFrontendOpts().Inputs.front().isFile()) {
+        string inputFile = ci->getFrontendOpts().Inputs.front().getFile();
+        size_t preambleEnd;
+        string pch = getPrecompiledPreamble(ccArgs, diags, inputFile,
+                                            pchCacheDir, preambleEnd,
+                                            diagOutput);
+        auto input = llvm::MemoryBuffer::getFile(inputFile);
+        if (!pch.empty() && input) {
+            // The precompiled header replaces the #include directives at the
+            // start of the input. They are blanked out so the locations in
+            // the rest of the file stay the same.
+            string contents = (*input)->getBuffer().str();
+            for (size_t i = 0; i < preambleEnd; ++i) {
+                if (contents[i] != '\n' && contents[i] != '\r') {
+                    contents[i] = ' ';
+                }
+            }
+            ci->getPreprocessorOpts().ImplicitPCHInclude = pch;
+            // The manifest has already compared the contents of the files
+            // the header depends on. Clang would compare their modification
+            // times and reject the header if they have only been touched.
+            // The options are part of the cache key.
+            ci->getPreprocessorOpts().DisablePCHValidation = true;
+            ci->getPreprocessorOpts().addRemappedFile(
+                inputFile,
+                llvm::MemoryBuffer::getMemBufferCopy(contents, inputFile)
+                    .release());
+        }
+    }
     CompilerInstance clang;
     clang.setInvocation(std::move(ci));
-    clang.createDiagnostics();
-    if (!clang.hasDiagnostics()) {
-        logError("Couldn’t enable diagnostics\n");
-        exit(1);
+    clang.createDiagnostics(new clang::TextDiagnosticPrinter(
+        diagOutput, &clang.getDiagnosticOpts()));
+    // This may run on a separate thread, so errors are reported by the caller
+    return clang.hasDiagnostics() && clang.ExecuteAction(act);
+}
+
+// Collect the #include directives at the start of a file, only blank lines
+// and comments may appear between them. Quoted includes are resolved
+// relative to the directory of the file since the prefix header containing
+// them is stored in the cache. Returns the offset after the last directive.
+static size_t scanPreamble(llvm::StringRef contents, llvm::StringRef dir,
+                           string &prefixHeader) {
+    size_t preambleEnd = 0;
+    bool inComment = false;
+    size_t pos = 0;
+    while (pos < contents.size()) {
+        size_t lineEnd = contents.find('\n', pos);
+        if (lineEnd == llvm::StringRef::npos) {
+            lineEnd = contents.size();
+        }
+        llvm::StringRef line = contents.slice(pos, lineEnd).rtrim("\r");
+        pos = lineEnd + 1;
+        // Continued lines are rare enough to simply end the preamble
+        if (line.endswith("\\")) {
+            break;
+        }
+        string code;
+        for (size_t i = 0; i < line.size(); ++i) {
+            if (inComment) {
+                if (line.substr(i).startswith("*/")) {
+                    inComment = false;
+                    code += ' ';
+                    ++i;
+                }
+            } else if (line.substr(i).startswith("/*")) {
+                inComment = true;
+                ++i;
+            } else if (line.substr(i).startswith("//")) {
+                break;
+            } else {
+                code += line[i];
+            }
+        }
+        llvm::StringRef directive = llvm::StringRef(code).trim();
+        if (directive.empty()) {
+            continue;
+        }
+        // A directive followed by an unterminated comment can’t be removed
+        // from the input without removing the start of the comment
+        if (inComment || !directive.startswith("#")) {
+            break;
+        }
+        directive = directive.drop_front().ltrim();
+        if (!directive.startswith("include")) {
+            break;
+        }
+        directive = directive.drop_front(strlen("include")).ltrim();
+        if (directive.size() < 3 ||
+            !((directive.front() == '"' && directive.back() == '"') ||
+              (directive.front() == '<' && directive.back() == '>'))) {
+            break;
+        }
+        llvm::StringRef header = directive.drop_front().drop_back();
+        llvm::SmallString<256> localHeader(dir);
+        llvm::sys::path::append(localHeader, header);
+        if (directive.front() == '"' && !llvm::sys::path::is_absolute(header) &&
+            llvm::sys::fs::exists(localHeader)) {
+            llvm::sys::fs::make_absolute(localHeader);
+            prefixHeader += "#include \"" + localHeader.str().str() + "\"\n";
+        } else {
+            prefixHeader += "#include " + directive.str() + "\n";
+        }
+        preambleEnd = std::min(pos, contents.size());
     }
-    if (!clang.ExecuteAction(act)) {
-        logError("Couldn’t execute action\n");
-        exit(1);
+    return preambleEnd;
+}
+
+static bool writeFileAtomically(llvm::StringRef path,
+                                llvm::StringRef contents) {
+    llvm::SmallString<256> tmpPath;
+    int fd;
+    if (llvm::sys::fs::createUniqueFile(path + ".tmp-%%%%%%%%", fd, tmpPath)) {
+        return false;
     }
+    {
+        llvm::raw_fd_ostream os(fd, true);
+        os << contents;
+    }
+    return !llvm::sys::fs::rename(tmpPath, path);
+}
+
+// Read the files listed in a make style dependency file
+static bool readDependencyFile(llvm::StringRef path,
+                               std::vector<string> &dependencies) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        return false;
+    }
+    llvm::StringRef contents = (*buffer)->getBuffer();
+    // Skip the target
+    size_t colon = contents.find(": ");
+    if (colon == llvm::StringRef::npos) {
+        return false;
+    }
+    string current;
+    for (size_t i = colon + 2; i < contents.size(); ++i) {
+        char c = contents[i];
+        if (c == '\\' && i + 1 < contents.size() &&
+            (contents[i + 1] == ' ' || contents[i + 1] == '#')) {
+            current += contents[++i];
+        } else if (c == '$' && i + 1 < contents.size() &&
+                   contents[i + 1] == '$') {
+            current += contents[++i];
+        } else if (c == '\\' || isspace(static_cast<unsigned char>(c))) {
+            if (!current.empty()) {
+                dependencies.push_back(current);
+                current.clear();
+            }
+        } else {
+            current += c;
+        }
+    }
+    if (!current.empty()) {
+        dependencies.push_back(current);
+    }
+    return true;
+}
+
+static bool contentHash(llvm::StringRef path, string &hash) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        return false;
+    }
+    llvm::MD5 md5;
+    md5.update((*buffer)->getBuffer());
+    llvm::MD5::MD5Result result;
+    md5.final(result);
+    llvm::SmallString<32> hashString;
+    llvm::MD5::stringifyResult(result, hashString);
+    hash = hashString.str().str();
+    return true;
+}
+
+// The manifest lists the precompiled header followed by the MD5 hash of the
+// contents and the path of every file it has been built from. Modification
+// times are not used since checkouts and build systems touch files without
+// changing them.
+static string readManifest(llvm::StringRef manifestPath) {
+    auto buffer = llvm::MemoryBuffer::getFile(manifestPath);
+    if (!buffer) {
+        return "";
+    }
+    llvm::SmallVector<llvm::StringRef, 32> lines;
+    (*buffer)->getBuffer().split(lines, '\n', -1, false);
+    if (lines.empty() || !llvm::sys::fs::exists(lines.front())) {
+        return "";
+    }
+    for (llvm::StringRef line : llvm::makeArrayRef(lines).drop_front()) {
+        llvm::StringRef expectedHash, path;
+        std::tie(expectedHash, path) = line.split(' ');
+        string hash;
+        if (!contentHash(path, hash) || hash != expectedHash) {
+            return "";
+        }
+    }
+    return lines.front().str();
+}
+
+static bool writeManifest(llvm::StringRef manifestPath, llvm::StringRef pch,
+                          const std::vector<string> &dependencies) {
+    string manifest = pch.str() + "\n";
+    for (const string &dependency : dependencies) {
+        llvm::SmallString<256> path(dependency);
+        llvm::sys::fs::make_absolute(path);
+        string hash;
+        if (!contentHash(path, hash)) {
+            return false;
+        }
+        manifest += hash + " " + path.str().str() + "\n";
+    }
+    return writeFileAtomically(manifestPath, manifest);
+}
+
+// The options of the compilation without the name of the input, so inputs
+// with the same includes can share the precompiled header
+static void hashOptions(llvm::MD5 &hash, const ArgStringList &ccArgs,
+                        llvm::StringRef inputFile) {
+    for (size_t i = 0; i < ccArgs.size(); ++i) {
+        llvm::StringRef arg = ccArgs[i];
+        if (arg == "-main-file-name") {
+            ++i;
+        } else if (arg != inputFile) {
+            hash.update(arg);
+            hash.update(llvm::StringRef("", 1));
+        }
+    }
+}
+
+string getPrecompiledPreamble(const ArgStringList &ccArgs,
+                              DiagnosticsEngine &diags,
+                              llvm::StringRef inputFile,
+                              llvm::StringRef pchCacheDir,
+                              size_t &preambleEnd,
+                              llvm::raw_ostream &diagOutput) {
+    preambleEnd = 0;
+    auto input = llvm::MemoryBuffer::getFile(inputFile);
+    if (!input) {
+        return "";
+    }
+    llvm::SmallString<256> inputDir(inputFile);
+    llvm::sys::fs::make_absolute(inputDir);
+    llvm::sys::path::remove_filename(inputDir);
+    string prefixHeaderContents;
+    size_t end =
+        scanPreamble((*input)->getBuffer(), inputDir, prefixHeaderContents);
+    if (end == 0) {
+        return "";
+    }
+
+    llvm::MD5 hash;
+    hash.update(clang::getClangFullVersion());
+    hash.update(llvm::sys::getProcessTriple());
+    llvm::SmallString<256> workingDir;
+    llvm::sys::fs::current_path(workingDir);
+    hash.update(workingDir);
+    hashOptions(hash, ccArgs, inputFile);
+    hash.update(prefixHeaderContents);
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    llvm::SmallString<32> key;
+    llvm::MD5::stringifyResult(result, key);
+
+    llvm::SmallString<256> manifest(pchCacheDir);
+    llvm::sys::path::append(manifest, key.str() + ".manifest");
+    string pch = readManifest(manifest);
+    if (!pch.empty()) {
+        preambleEnd = end;
+        return pch;
+    }
+
+    // Each build writes to a new file, the manifest is only replaced once the
+    // header is complete so concurrent compilations never see a partial one
+    llvm::SmallString<256> prefixHeader(pchCacheDir);
+    llvm::sys::path::append(prefixHeader, key.str() + ".h");
+    llvm::SmallString<256> pchModel(pchCacheDir);
+    llvm::sys::path::append(pchModel, key.str() + "-%%%%%%%%.pch");
+    llvm::SmallString<256> pchPath;
+    if (llvm::sys::fs::create_directories(pchCacheDir) ||
+        !writeFileAtomically(prefixHeader, prefixHeaderContents) ||
+        llvm::sys::fs::createUniqueFile(pchModel, pchPath)) {
+        diagOutput << "WARNING: Couldn’t write to the precompiled header "
+                      "cache\n";
+        return "";
+    }
+    string dependencyFile = pchPath.str().str() + ".d";
+    // Use the options of the actual compilation, otherwise the precompiled
+    // header would be rejected
+    ArgStringList filteredCcArgs = filterCC1Args(ccArgs);
+    auto ci = std::make_unique<CompilerInvocation>();
+    CompilerInvocation::CreateFromArgs(
+        *ci, filteredCcArgs.data(),
+        filteredCcArgs.data() + filteredCcArgs.size(), diags);
+    ci->getFrontendOpts().DisableFree = false;
+    ci->getFrontendOpts().Inputs.clear();
+    ci->getFrontendOpts().Inputs.push_back(
+        clang::FrontendInputFile(prefixHeader, clang::InputKind::C));
+    ci->getFrontendOpts().OutputFile = pchPath.str().str();
+    ci->getFrontendOpts().ProgramAction = clang::frontend::GeneratePCH;
+    ci->getDependencyOutputOpts().OutputFile = dependencyFile;
+    ci->getDependencyOutputOpts().Targets = {"pch"};
+    ci->getDependencyOutputOpts().IncludeSystemHeaders = true;
+    CompilerInstance clang;
+    clang.setInvocation(std::move(ci));
+    clang.createDiagnostics(new clang::TextDiagnosticPrinter(
+        diagOutput, &clang.getDiagnosticOpts()));
+    clang::GeneratePCHAction act;
+    std::vector<string> dependencies;
+    bool success = clang.hasDiagnostics() && clang.ExecuteAction(act) &&
+                   readDependencyFile(dependencyFile, dependencies) &&
+                   writeManifest(manifest, pchPath, dependencies);
+    llvm::sys::fs::remove(dependencyFile);
+    if (!success) {
+        llvm::sys::fs::remove(pchPath);
+        diagOutput << "WARNING: Couldn’t build precompiled header, continuing "
+                      "without it\n";
+        return "";
+    }
+    preambleEnd = end;
+    return pchPath.str().str();
 }
 
 /// Initialize the argument vector to produce the llvm assembly for
@@ -132,11 +486,10 @@ std::vector<const char *> initializeArgs(const char *exeName, InputOpts &opts) {
 }
 
 /// Set up the diagnostics engine
-unique_ptr<DiagnosticsEngine> initializeDiagnostics() {
+unique_ptr<DiagnosticsEngine> initializeDiagnostics(llvm::raw_ostream &os) {
     const IntrusiveRefCntPtr<clang::DiagnosticOptions> diagOpts =
         new clang::DiagnosticOptions();
-    auto diagClient =
-        new clang::TextDiagnosticPrinter(llvm::errs(), &*diagOpts);
+    auto diagClient = new clang::TextDiagnosticPrinter(os, &*diagOpts);
     const IntrusiveRefCntPtr<clang::DiagnosticIDs> diagId(
         new clang::DiagnosticIDs());
     return std::make_unique<DiagnosticsEngine>(diagId, &*diagOpts, diagClient);
@@ -159,6 +512,13 @@ unique_ptr<Driver> initializeDriver(DiagnosticsEngine &diags) {
     return driver;
 }
 
+DriverSetup initializeDriverSetup() {
+    DriverSetup driverSetup;
+    driverSetup.diags = initializeDiagnostics();
+    driverSetup.driver = initializeDriver(*driverSetup.diags);
+    return driverSetup;
+}
+
 /// This creates the compilations commands to compile to assembly
 ErrorOr<MonoPair<ArgStringList>> getCmd(Compilation &comp,
                                         DiagnosticsEngine &diags) {
@@ -0,0 +1,585 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#include "ConeOfInfluence.h"
+
+#include "SMTTraversal.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace smt {
+
+// Inlining a predicate that is used several times would copy its definition
+// once per use
+static const unsigned maxInlinedUses = 1;
+
+enum class Polarity { Positive, Negative, Mixed };
+
+struct Occurrences {
+    // Occurrences in the conclusion
+    unsigned positive = 0;
+    // Occurrences in the premises
+    unsigned negative = 0;
+    // Occurrences below operators other than the boolean connectives
+    unsigned mixed = 0;
+    bool defines() const { return positive > 0 || mixed > 0; }
+    bool uses() const { return negative > 0 || mixed > 0; }
+};
+
+using OccurrenceMap = SymbolMap<Occurrences>;
+
+struct HornSystem {
+    std::unordered_set<Symbol> predicates;
+    // In the order of their declarations
+    vector<Symbol> predicateOrder;
+    std::unordered_set<Symbol> queries;
+    vector<OccurrenceMap> occurrences;
+
+    bool isQuery(size_t clause) const {
+        for (const auto &occurrence : occurrences.at(clause)) {
+            if (occurrence.second.defines() &&
+                queries.find(occurrence.first) == queries.end()) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static Polarity flip(Polarity polarity) {
+    switch (polarity) {
+    case Polarity::Positive:
+        return Polarity::Negative;
+    case Polarity::Negative:
+        return Polarity::Positive;
+    case Polarity::Mixed:
+        return Polarity::Mixed;
+    }
+    return Polarity::Mixed;
+}
+
+// Polarity of the child at the given index of an expression with the given
+// polarity
+static Polarity childPolarity(const SMTExpr &expr, size_t index,
+                              Polarity polarity) {
+    if (const auto op = llvm::dyn_cast<Op>(&expr)) {
+        if (op->opName == "and" || op->opName == "or") {
+            return polarity;
+        }
+        if (op->opName == "not" ||
+            (op->opName == "=>" && index + 1 < op->args.size())) {
+            return flip(polarity);
+        }
+        if (op->opName == "=>") {
+            return polarity;
+        }
+        return Polarity::Mixed;
+    }
+    if (const auto let = llvm::dyn_cast<Let>(&expr)) {
+        // The definitions come before the body
+        return index < let->defs.assgns.size() ? Polarity::Mixed : polarity;
+    }
+    if (llvm::isa<Assert>(expr) || llvm::isa<Forall>(expr)) {
+        return polarity;
+    }
+    return Polarity::Mixed;
+}
+
+// Only the occurrences are of interest, every expression simply returns itself
+struct CollectOccurrencesPass : PostOrderPass<const SMTExpr *> {
+    const HornSystem &system;
+    OccurrenceMap &occurrences;
+    // Polarities of the expressions on the traversal stack
+    vector<Polarity> polarities;
+    // Polarity of the expression that is entered next
+    Polarity nextPolarity;
+    CollectOccurrencesPass(Polarity polarity, const HornSystem &system,
+                           OccurrenceMap &occurrences)
+        : system(system), occurrences(occurrences), nextPolarity(polarity) {}
+
+    auto enter(const SMTExpr &expr) -> llvm::Optional<const SMTExpr *> {
+        if (const auto op = llvm::dyn_cast<Op>(&expr)) {
+            if (system.predicates.count(op->opName) > 0) {
+                auto &occurrence = occurrences[op->opName];
+                switch (nextPolarity) {
+                case Polarity::Positive:
+                    ++occurrence.positive;
+                    break;
+                case Polarity::Negative:
+                    ++occurrence.negative;
+                    break;
+                case Polarity::Mixed:
+                    ++occurrence.mixed;
+                    break;
+                }
+            }
+        }
+        if (expr.childCount() == 0) {
+            return &expr;
+        }
+        polarities.push_back(nextPolarity);
+        return llvm::None;
+    }
+    void beforeChild(const SMTExpr &expr, size_t index,
+                     llvm::ArrayRef<const SMTExpr *> /* unused */) {
+        nextPolarity = childPolarity(expr, index, polarities.back());
+    }
+    auto leave(const SMTExpr &expr, vector<const SMTExpr *> /* unused */)
+        -> const SMTExpr * {
+        polarities.pop_back();
+        return &expr;
+    }
+};
+
+static void collectOccurrences(const SMTExpr &expr, Polarity polarity,
+                               const HornSystem &system,
+                               OccurrenceMap &occurrences) {
+    CollectOccurrencesPass pass(polarity, system, occurrences);
+    traversePostOrder(expr, pass);
+}
+
+static HornSystem analyzeHornSystem(const vector<SharedSMTRef> &exprs) {
+    HornSystem system;
+    for (const auto &expr : exprs) {
+        if (const auto funDecl = llvm::dyn_cast<FunDecl>(expr.get())) {
+            if (funDecl->outType.getTag() == TypeTag::Bool) {
+                system.predicates.insert(funDecl->funName);
+                system.predicateOrder.push_back(funDecl->funName);
+            }
+        } else if (const auto query = llvm::dyn_cast<Query>(expr.get())) {
+            system.queries.insert(query->queryName);
+        }
+    }
+    system.occurrences.resize(exprs.size());
+    for (size_t i = 0; i < exprs.size(); ++i) {
+        if (exprs[i] && llvm::isa<Assert>(*exprs[i])) {
+            collectOccurrences(*exprs[i], Polarity::Positive, system,
+                               system.occurrences[i]);
+        }
+    }
+    return system;
+}
+
+static bool isClause(const SharedSMTRef &expr) {
+    return expr && llvm::isa<Assert>(*expr);
+}
+
+auto pruneUnreachableClauses(vector<SharedSMTRef> exprs)
+    -> vector<SharedSMTRef> {
+    HornSystem system = analyzeHornSystem(exprs);
+    SymbolMap<vector<size_t>> definitions;
+    std::unordered_set<Symbol> needed(system.queries.begin(),
+                                      system.queries.end());
+    vector<Symbol> worklist;
+    auto markUses = [&](size_t clause) {
+        for (const auto &occurrence : system.occurrences[clause]) {
+            if (occurrence.second.uses() &&
+                needed.insert(occurrence.first).second) {
+                worklist.push_back(occurrence.first);
+            }
+        }
+    };
+    bool hasQuery = false;
+    for (size_t i = 0; i < exprs.size(); ++i) {
+        if (!isClause(exprs[i])) {
+            continue;
+        }
+        for (const auto &occurrence : system.occurrences[i]) {
+            if (occurrence.second.defines()) {
+                definitions[occurrence.first].push_back(i);
+            }
+        }
+        if (system.isQuery(i)) {
+            hasQuery = true;
+            markUses(i);
+        }
+    }
+    if (!hasQuery) {
+        return exprs;
+    }
+    while (!worklist.empty()) {
+        Symbol predicate = worklist.back();
+        worklist.pop_back();
+        for (size_t clause : definitions[predicate]) {
+            markUses(clause);
+        }
+    }
+
+    // A clause can be kept because of a mixed occurrence of a needed
+    // predicate and still mention predicates that are not needed, so the
+    // declarations of all predicates in the kept clauses are kept
+    vector<bool> keepClause(exprs.size(), false);
+    std::unordered_set<Symbol> referenced;
+    for (size_t i = 0; i < exprs.size(); ++i) {
+        if (!isClause(exprs[i])) {
+            continue;
+        }
+        bool keep = system.isQuery(i);
+        for (const auto &occurrence : system.occurrences[i]) {
+            if (occurrence.second.defines() &&
+                needed.count(occurrence.first) > 0) {
+                keep = true;
+            }
+        }
+        if (keep) {
+            keepClause[i] = true;
+            for (const auto &occurrence : system.occurrences[i]) {
+                referenced.insert(occurrence.first);
+            }
+        }
+    }
+
+    vector<SharedSMTRef> result;
+    for (size_t i = 0; i < exprs.size(); ++i) {
+        bool keep = true;
+        if (const auto funDecl = llvm::dyn_cast<FunDecl>(exprs[i].get())) {
+            keep = system.predicates.count(funDecl->funName) == 0 ||
+                   needed.count(funDecl->funName) > 0 ||
+                   referenced.count(funDecl->funName) > 0;
+        } else if (isClause(exprs[i])) {
+            keep = keepClause[i];
+        }
+        if (keep) {
+            result.push_back(std::move(exprs[i]));
+        }
+    }
+    return result;
+}
+
+// Names bound by lets and nested quantifiers
+struct CollectBindersVisitor : SMTVisitor {
+    std::set<string> names;
+    void dispatch(Let &let) override {
+        for (const auto &def : let.defs.assgns) {
+            names.insert(def.first);
+        }
+    }
+    void dispatch(Forall &forall) override {
+        for (const auto &var : forall.vars) {
+            names.insert(var.name);
+        }
+    }
+};
+
+// Replaces free variables by expressions and renames bound variables
+struct InstantiateVisitor : SMTVisitor {
+    const SymbolMap<SharedSMTRef> &substitution;
+    const SymbolMap<Symbol> &binderNames;
+    InstantiateVisitor(const SymbolMap<SharedSMTRef> &substitution,
+                       const SymbolMap<Symbol> &binderNames)
+        : substitution(substitution), binderNames(binderNames) {}
+
+    SharedSMTRef lookup(Symbol name, SharedSMTRef expr) {
+        auto substIt = substitution.find(name);
+        if (substIt != substitution.end()) {
+            return substIt->second;
+        }
+        auto binderIt = binderNames.find(name);
+        if (binderIt != binderNames.end()) {
+            return stringExpr(binderIt->second);
+        }
+        return expr;
+    }
+    shared_ptr<SMTExpr> reassemble(TypedVariable &var) override {
+        return lookup(var.name, var.shared_from_this());
+    }
+    // Some variables are still referenced using ConstantString
+    shared_ptr<SMTExpr> reassemble(ConstantString &str) override {
+        return lookup(str.value, str.shared_from_this());
+    }
+    void dispatch(Let &let) override {
+        for (auto &def : let.defs.assgns) {
+            def.first = binderNames.at(def.first);
+        }
+    }
+    void dispatch(Forall &forall) override {
+        for (auto &var : forall.vars) {
+            var.name = binderNames.at(var.name);
+        }
+    }
+};
+
+// A definition of a predicate is a clause whose body is a chain of lets and
+// implications ending in the predicate. Returns the conclusion.
+static const Op *conclusion(const SMTExpr &expr) {
+    if (const auto let = llvm::dyn_cast<Let>(&expr)) {
+        return conclusion(*let->expr);
+    }
+    if (const auto op = llvm::dyn_cast<Op>(&expr)) {
+        if (op->opName == "=>" && op->args.size() == 2) {
+            return conclusion(*op->args[1]);
+        }
+        return op;
+    }
+    return nullptr;
+}
+
+// Turns the implication chain into a conjunction and replaces the conclusion
+// by the given expression. If replacement is nullptr the conclusion is
+// dropped.
+static SharedSMTRef toPremise(const SharedSMTRef &expr,
+                              SharedSMTRef replacement) {
+    if (const auto let = llvm::dyn_cast<Let>(expr.get())) {
+        return make_shared<Let>(let->defs,
+                                toPremise(let->expr, std::move(replacement)));
+    }
+    const auto &op = llvm::cast<Op>(*expr);
+    if (op.opName == "=>" && op.args.size() == 2) {
+        if (!replacement && conclusion(*op.args[1]) == op.args[1].get()) {
+            return op.args[0];
+        }
+        return makeOp("and", op.args[0],
+                      toPremise(op.args[1], std::move(replacement)));
+    }
+    if (!replacement) {
+        return make_shared<ConstantBool>(true);
+    }
+    return replacement;
+}
+
+class PredicateInliner {
+    // Appended to variables of inlined clauses to keep them apart. This is
+    // shared by all inliners since they can modify the same clause.
+    unsigned &freshIndex;
+
+    Symbol fresh(const Symbol &name) {
+        return name + "_inl" + std::to_string(freshIndex++);
+    }
+
+  public:
+    Symbol predicate;
+    vector<SortedVar> vars;
+    SharedSMTRef body;
+    std::set<string> binders;
+
+    PredicateInliner(Symbol predicate, unsigned &freshIndex)
+        : freshIndex(freshIndex), predicate(predicate) {}
+
+    // Checks that the clause has the structure expected by instantiate
+    bool setDefinition(const Assert &clause) {
+        body = clause.expr;
+        vars.clear();
+        if (const auto forall = llvm::dyn_cast<Forall>(body.get())) {
+            vars = forall->vars;
+            body = forall->expr;
+        }
+        const Op *head = conclusion(*body);
+        if (!head || head->opName != predicate) {
+            return false;
+        }
+        CollectBindersVisitor collectBinders;
+        body->accept(collectBinders);
+        binders = std::move(collectBinders.names);
+        for (const auto &var : vars) {
+            if (binders.count(var.name) > 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Premise equivalent to predicate(args). The variables that are not
+    // determined by args are appended to newVars.
+    SharedSMTRef instantiate(const vector<SharedSMTRef> &args,
+                             vector<SortedVar> &newVars) {
+        const Op *head = conclusion(*body);
+        SymbolMap<SharedSMTRef> substitution;
+        vector<size_t> equalities;
+        std::set<string> varNames;
+        for (const auto &var : vars) {
+            varNames.insert(var.name);
+        }
+        for (size_t i = 0; i < head->args.size(); ++i) {
+            const auto var = llvm::dyn_cast<TypedVariable>(head->args[i].get());
+            if (var && varNames.count(var->name) > 0 &&
+                substitution.find(var->name) == substitution.end()) {
+                substitution.insert({var->name, args.at(i)});
+            } else {
+                equalities.push_back(i);
+            }
+        }
+        for (const auto &var : vars) {
+            if (substitution.find(var.name) == substitution.end()) {
+                SortedVar newVar(fresh(var.name), var.type);
+                substitution.insert(
+                    {var.name, make_shared<TypedVariable>(newVar.name,
+                                                          newVar.type)});
+                newVars.push_back(newVar);
+            }
+        }
+        SymbolMap<Symbol> binderNames;
+        for (const auto &name : binders) {
+            binderNames.insert({name, fresh(name)});
+        }
+        InstantiateVisitor instantiateVisitor(substitution, binderNames);
+        SharedSMTRef instance = body->accept(instantiateVisitor);
+        const Op *instanceHead = conclusion(*instance);
+        vector<SharedSMTRef> conditions;
+        for (size_t i : equalities) {
+            conditions.push_back(
+                makeOp("=", instanceHead->args.at(i), args.at(i)));
+        }
+        SharedSMTRef replacement;
+        if (conditions.size() == 1) {
+            replacement = conditions.front();
+        } else if (conditions.size() > 1) {
+            replacement = make_shared<Op>("and", conditions);
+        }
+        return toPremise(instance, replacement);
+    }
+
+    // Replace all applications of the predicate in expr
+    SharedSMTRef inlineInto(const SharedSMTRef &expr,
+                            vector<SortedVar> &newVars) {
+        struct InlinePass : PostOrderPass<SharedSMTRef> {
+            PredicateInliner &inliner;
+            vector<SortedVar> &newVars;
+            InlinePass(PredicateInliner &inliner, vector<SortedVar> &newVars)
+                : inliner(inliner), newVars(newVars) {}
+
+            auto enter(SMTExpr &expr) -> llvm::Optional<SharedSMTRef> {
+                if (const auto op = llvm::dyn_cast<Op>(&expr)) {
+                    if (op->opName == inliner.predicate) {
+                        return inliner.instantiate(op->args, newVars);
+                    }
+                }
+                if (expr.childCount() == 0) {
+                    return expr.shared_from_this();
+                }
+                return llvm::None;
+            }
+            auto leave(SMTExpr &expr, vector<SharedSMTRef> results)
+                -> SharedSMTRef {
+                bool changed = false;
+                for (size_t i = 0; i < results.size(); ++i) {
+                    changed = changed || results[i] != expr.child(i);
+                }
+                return changed ? expr.withChildren(std::move(results))
+                               : expr.shared_from_this();
+            }
+        };
+        InlinePass pass(*this, newVars);
+        return traversePostOrder(*expr, pass);
+    }
+
+    SharedSMTRef inlineIntoClause(const Assert &clause) {
+        vector<SortedVar> clauseVars;
+        SharedSMTRef clauseBody = clause.expr;
+        if (const auto forall = llvm::dyn_cast<Forall>(clauseBody.get())) {
+            clauseVars = forall->vars;
+            clauseBody = forall->expr;
+        }
+        SharedSMTRef newBody = inlineInto(clauseBody, clauseVars);
+        if (clauseVars.empty()) {
+            return make_shared<Assert>(newBody);
+        }
+        return make_shared<Assert>(make_shared<Forall>(clauseVars, newBody));
+    }
+};
+
+// Predicates whose heap arguments would have to be compared using an
+// equality are not inlined since the instantiation of arrays would turn it
+// into a quantifier in the premise.
+static bool hasComplexHeapArguments(const PredicateInliner &inliner) {
+    const Op *head = conclusion(*inliner.body);
+    for (const auto &arg : head->args) {
+        if (arg->heapInfo() && !llvm::isa<TypedVariable>(*arg)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+auto inlineSingleDefinitionPredicates(vector<SharedSMTRef> exprs)
+    -> vector<SharedSMTRef> {
+    std::unordered_set<Symbol> inlined;
+    unsigned freshIndex = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        HornSystem system = analyzeHornSystem(exprs);
+        SymbolMap<vector<size_t>> definitions;
+        SymbolMap<vector<size_t>> uses;
+        SymbolMap<bool> mixed;
+        for (size_t i = 0; i < exprs.size(); ++i) {
+            for (const auto &occurrence : system.occurrences[i]) {
+                if (occurrence.second.defines()) {
+                    definitions[occurrence.first].push_back(i);
+                }
+                if (occurrence.second.uses()) {
+                    uses[occurrence.first].push_back(i);
+                }
+                if (occurrence.second.mixed > 0) {
+                    mixed[occurrence.first] = true;
+                }
+            }
+        }
+        // Clauses that have been changed in this round
+        std::set<size_t> dirty;
+        for (const auto &predicate : system.predicateOrder) {
+            if (system.queries.count(predicate) > 0 || mixed[predicate]) {
+                continue;
+            }
+            const auto &predicateDefs = definitions[predicate];
+            const auto &predicateUses = uses[predicate];
+            if (predicateDefs.size() != 1 ||
+                predicateUses.size() > maxInlinedUses) {
+                continue;
+            }
+            size_t definition = predicateDefs.front();
+            const auto &defOccurrences = system.occurrences[definition];
+            if (defOccurrences.at(predicate).positive != 1 ||
+                defOccurrences.at(predicate).negative != 0 ||
+                dirty.count(definition) > 0) {
+                continue;
+            }
+            bool usesDirty = false;
+            for (size_t use : predicateUses) {
+                usesDirty = usesDirty || dirty.count(use) > 0;
+            }
+            if (usesDirty) {
+                continue;
+            }
+            PredicateInliner inliner(predicate, freshIndex);
+            const auto &definingClause = llvm::cast<Assert>(*exprs[definition]);
+            if (!inliner.setDefinition(definingClause) ||
+                hasComplexHeapArguments(inliner)) {
+                continue;
+            }
+            for (size_t use : predicateUses) {
+                exprs[use] =
+                    inliner.inlineIntoClause(llvm::cast<Assert>(*exprs[use]));
+                dirty.insert(use);
+            }
+            exprs[definition] = nullptr;
+            dirty.insert(definition);
+            inlined.insert(predicate);
+            changed = true;
+        }
+        exprs.erase(std::remove(exprs.begin(), exprs.end(), nullptr),
+                    exprs.end());
+    }
+
+    vector<SharedSMTRef> result;
+    for (auto &expr : exprs) {
+        const auto funDecl = llvm::dyn_cast<FunDecl>(expr.get());
+        if (!funDecl || inlined.count(funDecl->funName) == 0) {
+            result.push_back(std::move(expr));
+        }
+    }
+    return result;
+}
+}
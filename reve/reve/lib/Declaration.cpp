@@ -23,8 +23,7 @@ relationalFunctionDeclarations(MonoPair<const llvm::Function *> functions,
         getFunctionArguments(functions, analysisResults);
     const auto freeVarsMap = getFreeVarsMap(functions, analysisResults);
     vector<SharedSMTRef> declarations;
-    for (const auto &pathMapIt : pathMap) {
-        const Mark startIndex = pathMapIt.first;
+    for (const Mark startIndex : pathMap.startMarks()) {
         const auto &fixedInvariants =
             SMTGenerationOpts::getInstance().FunctionalRelationalInvariants;
         nestedLookup(fixedInvariants, functions, startIndex,
@@ -56,8 +55,7 @@ functionalFunctionDeclarations(const llvm::Function *function,
     const auto freeVarsMap = analysisResults.at(function).freeVariables;
 
     vector<SharedSMTRef> declarations;
-    for (const auto &pathMapIt : pathMap) {
-        const Mark startIndex = pathMapIt.first;
+    for (const Mark startIndex : pathMap.startMarks()) {
         const auto &fixedInvariants =
             SMTGenerationOpts::getInstance().FunctionalFunctionalInvariants;
         nestedLookup(fixedInvariants, function, startIndex,
@@ -89,8 +87,7 @@ vector<SharedSMTRef> relationalIterativeDeclarations(
         getFreeVarsMap(preprocessedFunctions, analysisResults);
 
     vector<SharedSMTRef> declarations;
-    for (const auto &pathMapIt : pathMap) {
-        const Mark startIndex = pathMapIt.first;
+    for (const Mark startIndex : pathMap.startMarks()) {
         if (startIndex != ENTRY_MARK) {
             // ignore entry node, it has the fixed predicate IN_INV
             auto foundIt = SMTGenerationOpts::getInstance()
@@ -85,41 +85,76 @@ static void freeVarsInBlock(llvm::BasicBlock &block,
         }
     }
 }
+static void intersect(set<FreeVar> &vars, const set<FreeVar> &other) {
+    for (auto it = vars.begin(); it != vars.end();) {
+        if (other.find(*it) == other.end()) {
+            it = vars.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 /// Collect the free variables for all paths starting at some mark
-static VariablesResult freeVarsOnPaths(map<Mark, Paths> pathMap) {
+///
+/// Instead of walking every path, the variables constructed on all paths
+/// leading through a node of the DAG are propagated in topological order.
+/// A variable is free if it is used on some path before it is constructed,
+/// so each block is checked once for every incoming edge.
+static VariablesResult freeVarsOnPaths(const vector<PathDAG> &dags) {
     set<FreeVar> freeVars;
     map<Mark, set<FreeVar>> constructedIntersection;
-    for (const auto &paths : pathMap) {
-        for (const auto &path : paths.second) {
-            const llvm::BasicBlock *prev = path.Start;
-            set<FreeVar> constructed;
-
-            freeVarsInBlock(*path.Start, nullptr, freeVars, constructed);
-
-            // now deal with the rest
-            for (const auto &edge : path.Edges) {
-                freeVarsInBlock(*edge.Block, prev, freeVars, constructed);
-                prev = edge.Block;
+    for (const auto &dag : dags) {
+        const auto &nodes = dag.Nodes;
+        // Only nodes on a path ending at a mark are relevant
+        const auto onPath = [&nodes](size_t node) {
+            return !nodes[node].Reaches.empty();
+        };
+        vector<vector<size_t>> predecessors(nodes.size());
+        for (size_t node = 0; node < nodes.size(); ++node) {
+            if (!onPath(node)) {
+                continue;
+            }
+            for (const auto &succ : nodes[node].Successors) {
+                if (onPath(succ.Node)) {
+                    predecessors[succ.Node].push_back(node);
+                }
+            }
+        }
+        // Variables constructed on all paths up to the end of a node
+        vector<set<FreeVar>> constructedAfter(nodes.size());
+        for (size_t node = 0; node < nodes.size(); ++node) {
+            if (!onPath(node)) {
+                continue;
+            }
+            if (node == 0) {
+                freeVarsInBlock(*nodes[node].Block, nullptr, freeVars,
+                                constructedAfter[node]);
+            }
+            bool first = true;
+            for (size_t pred : predecessors[node]) {
+                set<FreeVar> constructed = constructedAfter[pred];
+                freeVarsInBlock(*nodes[node].Block, nodes[pred].Block,
+                                freeVars, constructed);
+                if (first) {
+                    constructedAfter[node] = std::move(constructed);
+                    first = false;
+                } else {
+                    intersect(constructedAfter[node], constructed);
+                }
             }
 
-            // A variable is constructed on a way to a mark if it is constructed
-            // on all paths. We thus have to take the intersection of the
-            // constructed variables.
-            set<FreeVar> newConstructedIntersection;
-            if (constructedIntersection.find(paths.first) ==
-                constructedIntersection.end()) {
-                constructedIntersection.insert(
-                    make_pair(paths.first, constructed));
-                ;
-            } else {
-                std::set_intersection(
-                    constructed.begin(), constructed.end(),
-                    constructedIntersection.at(paths.first).begin(),
-                    constructedIntersection.at(paths.first).end(),
-                    inserter(newConstructedIntersection,
-                             newConstructedIntersection.begin()));
-                constructedIntersection.insert(
-                    make_pair(paths.first, newConstructedIntersection));
+            // A variable is constructed on a way to a mark if it is
+            // constructed on all paths. We thus have to take the
+            // intersection of the constructed variables.
+            for (Mark endMark : nodes[node].EndMarks) {
+                auto constructedIt = constructedIntersection.find(endMark);
+                if (constructedIt == constructedIntersection.end()) {
+                    constructedIntersection.insert(
+                        make_pair(endMark, constructedAfter[node]));
+                } else {
+                    intersect(constructedIt->second, constructedAfter[node]);
+                }
             }
         }
     }
@@ -150,14 +185,13 @@ auto addMemoryArrays(vector<smt::SortedVar> vars, Program prog)
     }
     return vars;
 }
-FreeVarsMap freeVars(PathMap map, vector<smt::SortedVar> funArgs,
+FreeVarsMap freeVars(const PathMap &map, vector<smt::SortedVar> funArgs,
                      Program prog) {
     std::map<Mark, set<SortedVar>> freeVarsMap;
     FreeVarsMap freeVarsMapVect;
     std::map<Mark, std::map<Mark, set<SortedVar>>> constructed;
-    for (const auto &it : map) {
-        const Mark index = it.first;
-        auto freeVarsResult = freeVarsOnPaths(map.at(index));
+    for (const Mark index : map.startMarks()) {
+        auto freeVarsResult = freeVarsOnPaths(map.dags(index));
 
         const auto accessed = addMemoryLocations(freeVarsResult.accessed);
         freeVarsMap.insert(make_pair(index, accessed));
@@ -183,10 +217,8 @@ FreeVarsMap freeVars(PathMap map, vector<smt::SortedVar> funArgs,
     bool changed = true;
     while (changed) {
         changed = false;
-        for (const auto &it : map) {
-            const Mark startIndex = it.first;
-            for (const auto &itInner : it.second) {
-                const Mark endIndex = itInner.first;
+        for (const Mark startIndex : map.startMarks()) {
+            for (const Mark endIndex : map.endMarks(startIndex)) {
                 for (auto var : freeVarsMap.at(endIndex)) {
                     if (constructed.at(startIndex).at(endIndex).find(var) ==
                         constructed.at(startIndex).at(endIndex).end()) {
@@ -11,7 +11,6 @@
 #include "FunctionSMTGeneration.h"
 
 #include "Compat.h"
-#include "Declaration.h"
 #include "FreeVariables.h"
 #include "Invariant.h"
 #include "ModuleSMTGeneration.h"
@@ -20,6 +19,7 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/Operator.h"
+#include "llvm/Support/MathExtras.h"
 
 #include <iostream>
 
@@ -38,6 +38,90 @@ using std::vector;
 using namespace smt;
 using namespace llreve::opts;
 
+static uint64_t pathCount(const PathMap &pathMap, Mark startMark) {
+    uint64_t count = 0;
+    for (const Mark endMark : pathMap.endMarks(startMark)) {
+        count =
+            llvm::SaturatingAdd(count, pathMap.pathCount(startMark, endMark));
+    }
+    return count;
+}
+
+/// The number of clauses in the per-path encoding of a single function
+static uint64_t pathCount(const PathMap &pathMap) {
+    uint64_t count = 0;
+    for (const Mark startMark : pathMap.startMarks()) {
+        count = llvm::SaturatingAdd(count, pathCount(pathMap, startMark));
+    }
+    return count;
+}
+
+/// The number of pairs of paths leaving the same mark
+/**
+This bounds the number of synchronized and forbidden clauses in the per-path
+encoding of a pair of functions. The paths are counted on the DAGs, so this is
+cheap even if the number of paths is not.
+ */
+static uint64_t pathPairCount(const MonoPair<PathMap> &pathMaps) {
+    uint64_t count = 0;
+    for (const Mark startMark : pathMaps.first.startMarks()) {
+        if (!pathMaps.second.hasStartMark(startMark)) {
+            continue;
+        }
+        count = llvm::SaturatingAdd(
+            count,
+            llvm::SaturatingMultiply(pathCount(pathMaps.first, startMark),
+                                     pathCount(pathMaps.second, startMark)));
+    }
+    return count;
+}
+
+/// Fall back to the large-block encoding if the per-path encoding of a
+/// function would exceed the path budget
+static PathEncoding pathEncoding(uint64_t clauseCount,
+                                 llvm::StringRef funName) {
+    const auto &opts = SMTGenerationOpts::getInstance();
+    if (opts.Encoding == PathEncoding::PerPath && opts.PathBudget != 0 &&
+        clauseCount > opts.PathBudget) {
+        logWarning(funName.str() + " needs " + std::to_string(clauseCount) +
+                   " clauses in the per-path encoding, which exceeds the "
+                   "path budget of " +
+                   std::to_string(opts.PathBudget) +
+                   ", using the large-block encoding\n");
+        return PathEncoding::LargeBlock;
+    }
+    return opts.Encoding;
+}
+
+/// Pairs of arguments of the main functions that IN_INV requires to be equal
+/**
+IN_INV pairs the arguments by their position. Only integer arguments are used
+and nothing is returned if the signatures differ, since the positions of the
+arguments would then not match.
+ */
+static ValueEqualities
+equalArguments(MonoPair<const llvm::Function *> functions) {
+    ValueEqualities equalities;
+    if (functions.first->arg_size() != functions.second->arg_size()) {
+        return equalities;
+    }
+    auto arg2 = functions.second->arg_begin();
+    for (const auto &arg1 : functions.first->args()) {
+        const llvm::Type *type1 = arg1.getType();
+        const llvm::Type *type2 = arg2->getType();
+        if (type1->isIntegerTy() && type2->isIntegerTy()) {
+            if (type1->getIntegerBitWidth() != type2->getIntegerBitWidth()) {
+                return {};
+            }
+            equalities.push_back({&arg1, &*arg2});
+        } else if (type1->getTypeID() != type2->getTypeID()) {
+            return {};
+        }
+        ++arg2;
+    }
+    return equalities;
+}
+
 vector<std::unique_ptr<smt::SMTExpr>>
 relationalFunctionAssertions(MonoPair<const llvm::Function *> functions,
                              const AnalysisResultsMap &analysisResults) {
@@ -50,6 +134,8 @@ relationalFunctionAssertions(MonoPair<const llvm::Function *> functions,
     const auto freeVarsMap1 = analysisResults.at(functions.first).freeVariables;
     const auto freeVarsMap2 =
         analysisResults.at(functions.second).freeVariables;
+    const auto encoding = pathEncoding(pathPairCount(pathMaps), funName);
+    PathAssignmentCache cache;
     auto synchronizedPaths = getSynchronizedPaths(
         pathMaps.first, pathMaps.second, freeVarsMap1, freeVarsMap2,
         [&freeVarsMap, funName](Mark startIndex, Mark endIndex) {
@@ -57,7 +143,9 @@ relationalFunctionAssertions(MonoPair<const llvm::Function *> functions,
                 startIndex, endIndex, freeVarsMap.at(startIndex),
                 freeVarsMap.at(endIndex), ProgramSelection::Both, funName,
                 freeVarsMap);
-        });
+        },
+        // The arguments of coupled calls can differ
+        encoding, cache, ValueEqualities());
 
     map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> smtExprs;
     for (auto &it : synchronizedPaths) {
@@ -69,8 +157,9 @@ relationalFunctionAssertions(MonoPair<const llvm::Function *> functions,
         }
     }
 
-    auto forbiddenPaths = getForbiddenPaths(pathMaps, marked, freeVarsMap1,
-                                            freeVarsMap2, funName, false);
+    auto forbiddenPaths =
+        getForbiddenPaths(pathMaps, marked, freeVarsMap1, freeVarsMap2,
+                          funName, false, encoding, cache, ValueEqualities());
     for (auto &it : forbiddenPaths) {
         for (auto &path : it.second) {
             auto clause = forallStartingAt(
@@ -82,8 +171,9 @@ relationalFunctionAssertions(MonoPair<const llvm::Function *> functions,
 
     if (SMTGenerationOpts::getInstance().PerfectSync ==
         PerfectSynchronization::Disabled) {
-        auto stutterPaths = getStutterPaths(pathMaps.first, pathMaps.second,
-                                            freeVarsMap, funName, false);
+        auto stutterPaths =
+            getStutterPaths(pathMaps.first, pathMaps.second, freeVarsMap,
+                            funName, false, encoding, cache);
         for (auto &it : stutterPaths) {
             for (auto &path : it.second) {
                 auto clause = forallStartingAt(
@@ -105,7 +195,8 @@ relationalFunctionAssertions(MonoPair<const llvm::Function *> functions,
 // the assertions since it is never called
 vector<std::unique_ptr<smt::SMTExpr>>
 relationalIterativeAssertions(MonoPair<const llvm::Function *> functions,
-                              const AnalysisResultsMap &analysisResults) {
+                              const AnalysisResultsMap &analysisResults,
+                              bool equalInputs) {
     const auto pathMaps = getPathMaps(functions, analysisResults);
     checkPathMaps(pathMaps.first, pathMaps.second);
     const auto marked = getBlockMarkMaps(functions, analysisResults);
@@ -116,6 +207,10 @@ relationalIterativeAssertions(MonoPair<const llvm::Function *> functions,
     const auto freeVarsMap2 =
         analysisResults.at(functions.second).freeVariables;
     vector<std::unique_ptr<smt::SMTExpr>> smtExprs;
+    const auto encoding = pathEncoding(pathPairCount(pathMaps), funName);
+    PathAssignmentCache cache;
+    const ValueEqualities entryEqualities =
+        equalInputs ? equalArguments(functions) : ValueEqualities();
 
     if (SMTGenerationOpts::getInstance().OnlyRecursive ==
         FunctionEncoding::OnlyRecursive) {
@@ -138,12 +233,14 @@ relationalIterativeAssertions(MonoPair<const llvm::Function *> functions,
                            make_unique<TypedVariable>("END_QUERY", boolType()));
             }
             return endInvariant;
-        });
+        },
+        encoding, cache, entryEqualities);
 
     if (SMTGenerationOpts::getInstance().PerfectSync ==
         PerfectSynchronization::Disabled) {
-        auto stutterPaths = getStutterPaths(pathMaps.first, pathMaps.second,
-                                            freeVarsMap, funName, true);
+        auto stutterPaths =
+            getStutterPaths(pathMaps.first, pathMaps.second, freeVarsMap,
+                            funName, true, encoding, cache);
         synchronizedPaths = mergeVectorMaps(std::move(synchronizedPaths),
                                             std::move(stutterPaths));
     }
@@ -158,8 +255,9 @@ relationalIterativeAssertions(MonoPair<const llvm::Function *> functions,
         }
     }
 
-    auto forbiddenPaths = getForbiddenPaths(pathMaps, marked, freeVarsMap1,
-                                            freeVarsMap2, funName, true);
+    auto forbiddenPaths =
+        getForbiddenPaths(pathMaps, marked, freeVarsMap1, freeVarsMap2,
+                          funName, true, encoding, cache, entryEqualities);
     for (auto &it : forbiddenPaths) {
         for (auto &path : it.second) {
             auto clause = forallStartingAt(
@@ -178,18 +276,51 @@ relationalIterativeAssertions(MonoPair<const llvm::Function *> functions,
  */
 // Generate SMT for all paths
 
+static SharedSMTRef disjunction(vector<SharedSMTRef> disjuncts) {
+    if (disjuncts.size() == 1) {
+        return disjuncts.front();
+    }
+    return make_unique<Op>("or", std::move(disjuncts));
+}
+
+/// Drop the paths whose conditions contradict each other
+/**
+Filtering before building the product avoids clauses that the solver has to
+discharge but that can never be violated. The remaining pairs only need to be
+checked if values of both programs are known to be equal at the start mark.
+ */
+static vector<Path> feasiblePaths(const vector<Path> &paths) {
+    vector<Path> feasible;
+    std::copy_if(paths.begin(), paths.end(), std::back_inserter(feasible),
+                 isFeasible);
+    return feasible;
+}
+
+/// The equalities that hold at the given start mark
+static const ValueEqualities &
+equalitiesAt(Mark startMark, const ValueEqualities &entryEqualities) {
+    static const ValueEqualities noEqualities;
+    return startMark == ENTRY_MARK ? entryEqualities : noEqualities;
+}
+
 static void addSynchronizedPaths(
     Mark startMark, Mark endMark, const std::vector<Path> &paths1,
     const std::vector<Path> &paths2, const FreeVarsMap &freeVarsMap1,
     const FreeVarsMap &freeVarsMap2,
     ReturnInvariantGenerator generateReturnInvariant,
-    map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> &clauses) {
-    for (const auto &path1 : paths1) {
-        for (const auto &path2 : paths2) {
+    map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> &clauses,
+    PathAssignmentCache &cache, const ValueEqualities &equalities) {
+    const auto feasible2 = feasiblePaths(paths2);
+    for (const auto &path1 : feasiblePaths(paths1)) {
+        for (const auto &path2 : feasible2) {
+            if (!equalities.empty() &&
+                !isFeasiblePair(path1, path2, equalities)) {
+                continue;
+            }
             bool returnPath = endMark == EXIT_MARK;
-            const auto assignments1 = assignmentsOnPath(
+            const auto &assignments1 = cache.assignments(
                 path1, Program::First, freeVarsMap1.at(startMark), returnPath);
-            const auto assignments2 = assignmentsOnPath(
+            const auto &assignments2 = cache.assignments(
                 path2, Program::Second, freeVarsMap2.at(startMark), returnPath);
             clauses[{startMark, endMark}].push_back(interleaveAssignments(
                 generateReturnInvariant(startMark, endMark), assignments1,
@@ -198,12 +329,74 @@ static void addSynchronizedPaths(
     }
 }
 
+/// Large-block encoding of the synchronized paths, one clause per mark pair
+static void addMergedSynchronizedPaths(
+    const PathMap &pathMap1, const PathMap &pathMap2,
+    const FreeVarsMap &freeVarsMap1, const FreeVarsMap &freeVarsMap2,
+    ReturnInvariantGenerator generateReturnInvariant,
+    map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> &clauses,
+    PathAssignmentCache &cache, const ValueEqualities &entryEqualities) {
+    for (const Mark startIndex : pathMap1.startMarks()) {
+        const auto endIndices2 = pathMap2.endMarks(startIndex);
+        for (const Mark endIndex : pathMap1.endMarks(startIndex)) {
+            if (endIndices2.find(endIndex) == endIndices2.end()) {
+                continue;
+            }
+            const bool returnPath = endIndex == EXIT_MARK;
+            for (const auto &dag1 : pathMap1.dags(startIndex)) {
+                if (dag1.endMarks().find(endIndex) == dag1.endMarks().end()) {
+                    continue;
+                }
+                const auto merged1 = mergedAssignments(
+                    dag1, endIndex, Program::First,
+                    freeVarsMap1.at(startIndex), returnPath);
+                for (const auto &dag2 : pathMap2.dags(startIndex)) {
+                    if (dag2.endMarks().find(endIndex) ==
+                        dag2.endMarks().end()) {
+                        continue;
+                    }
+                    const auto merged2 = mergedAssignments(
+                        dag2, endIndex, Program::Second,
+                        freeVarsMap2.at(startIndex), returnPath);
+                    if (!merged1 || !merged2) {
+                        addSynchronizedPaths(
+                            startIndex, endIndex, dag1.paths(endIndex),
+                            dag2.paths(endIndex), freeVarsMap1, freeVarsMap2,
+                            generateReturnInvariant, clauses, cache,
+                            equalitiesAt(startIndex, entryEqualities));
+                        continue;
+                    }
+                    SMTRef clause = makeOp(
+                        "=>",
+                        makeOp("and", reachedEnd(*merged1),
+                               reachedEnd(*merged2)),
+                        generateReturnInvariant(startIndex, endIndex));
+                    clause = fastNestLets(std::move(clause),
+                                          merged2->definitions);
+                    clause = fastNestLets(std::move(clause),
+                                          merged1->definitions);
+                    clauses[{startIndex, endIndex}].push_back(
+                        std::move(clause));
+                }
+            }
+        }
+    }
+}
+
 map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>>
 getSynchronizedPaths(const PathMap &pathMap1, const PathMap &pathMap2,
                      const FreeVarsMap &freeVarsMap1,
                      const FreeVarsMap &freeVarsMap2,
-                     ReturnInvariantGenerator generateReturnInvariant) {
+                     ReturnInvariantGenerator generateReturnInvariant,
+                     PathEncoding encoding, PathAssignmentCache &cache,
+                     const ValueEqualities &entryEqualities) {
     map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> clauses;
+    if (encoding == PathEncoding::LargeBlock) {
+        addMergedSynchronizedPaths(pathMap1, pathMap2, freeVarsMap1,
+                                   freeVarsMap2, generateReturnInvariant,
+                                   clauses, cache, entryEqualities);
+        return clauses;
+    }
     for (const auto &pathMapIt : pathMap1) {
         const Mark startIndex = pathMapIt.first;
         for (const auto &innerPathMapIt : pathMapIt.second) {
@@ -212,9 +405,10 @@ getSynchronizedPaths(const PathMap &pathMap1, const PathMap &pathMap2,
                 pathMap2.at(startIndex).end()) {
                 const auto &paths1 = innerPathMapIt.second;
                 const auto &paths2 = pathMap2.at(startIndex).at(endIndex);
-                addSynchronizedPaths(startIndex, endIndex, paths1, paths2,
-                                     freeVarsMap1, freeVarsMap2,
-                                     generateReturnInvariant, clauses);
+                addSynchronizedPaths(
+                    startIndex, endIndex, paths1, paths2, freeVarsMap1,
+                    freeVarsMap2, generateReturnInvariant, clauses, cache,
+                    equalitiesAt(startIndex, entryEqualities));
             }
         }
     }
@@ -222,14 +416,29 @@ getSynchronizedPaths(const PathMap &pathMap1, const PathMap &pathMap2,
     return clauses;
 }
 
+static SMTRef forbiddenClauseHead() {
+    // The datalog input format of Z3 cannot handle clauses whose
+    // head is "false". We need to use the query predicate instead.
+    if (SMTGenerationOpts::getInstance().OutputFormat == SMTFormat::Z3) {
+        return make_unique<TypedVariable>("END_QUERY", boolType());
+    }
+    return make_unique<ConstantBool>(false);
+}
+
 static void addForbiddenPaths(
     Mark startIndex, Mark endIndex1, Mark endIndex2,
     const std::vector<Path> &paths1, const std::vector<Path> &paths2,
     const FreeVarsMap &freeVarsMap1, const FreeVarsMap &freeVarsMap2,
     const MonoPair<BidirBlockMarkMap> &marked,
-    map<Mark, vector<std::unique_ptr<smt::SMTExpr>>> &pathExprs) {
-    for (const Path &path1 : paths1) {
-        for (const Path &path2 : paths2) {
+    map<Mark, vector<std::unique_ptr<smt::SMTExpr>>> &pathExprs,
+    PathAssignmentCache &cache, const ValueEqualities &equalities) {
+    const auto feasible2 = feasiblePaths(paths2);
+    for (const Path &path1 : feasiblePaths(paths1)) {
+        for (const Path &path2 : feasible2) {
+            if (!equalities.empty() &&
+                !isFeasiblePair(path1, path2, equalities)) {
+                continue;
+            }
             const auto endBlocks =
                 makeMonoPair(path1, path2).map<llvm::BasicBlock *>(lastBlock);
             const auto endIndices = makeMonoPair(
@@ -240,34 +449,101 @@ static void addForbiddenPaths(
                      PerfectSynchronization::Enabled ||
                  (startIndex != endIndex1 && // no cycles
                   startIndex != endIndex2))) {
-                const auto smt2 = assignmentsOnPath(path2, Program::Second,
-                                                    freeVarsMap2.at(startIndex),
-                                                    endIndex2 == EXIT_MARK);
-                const auto smt1 = assignmentsOnPath(path1, Program::First,
-                                                    freeVarsMap1.at(startIndex),
-                                                    endIndex1 == EXIT_MARK);
-                // The datalog input format of Z3 cannot handle clauses whose
-                // head is "false". We need to use the query predicate instead.
-                unique_ptr<SMTExpr> clauseHead =
-                    SMTGenerationOpts::getInstance().OutputFormat ==
-                            SMTFormat::Z3
-                        ? unique_ptr<SMTExpr>(make_unique<TypedVariable>("END_QUERY", boolType()))
-                        : unique_ptr<SMTExpr>(make_unique<ConstantBool>(false));
+                const auto &smt2 = cache.assignments(
+                    path2, Program::Second, freeVarsMap2.at(startIndex),
+                    endIndex2 == EXIT_MARK);
+                const auto &smt1 = cache.assignments(
+                    path1, Program::First, freeVarsMap1.at(startIndex),
+                    endIndex1 == EXIT_MARK);
                 // We need to interleave here, to match calls to
                 // extern functions.
-                auto smt = interleaveAssignments(std::move(clauseHead), smt1, smt2);
+                auto smt =
+                    interleaveAssignments(forbiddenClauseHead(), smt1, smt2);
                 pathExprs[startIndex].push_back(std::move(smt));
             }
         }
     }
 };
 
+/// Large-block encoding of the forbidden paths between two DAGs
+static void addMergedForbiddenPaths(
+    Mark startIndex, Mark endIndex1, Mark endIndex2, const PathDAG &dag1,
+    const PathDAG &dag2, const FreeVarsMap &freeVarsMap1,
+    const FreeVarsMap &freeVarsMap2, const MonoPair<BidirBlockMarkMap> &marked,
+    map<Mark, vector<std::unique_ptr<smt::SMTExpr>>> &pathExprs,
+    PathAssignmentCache &cache, const ValueEqualities &equalities) {
+    if (SMTGenerationOpts::getInstance().PerfectSync ==
+            PerfectSynchronization::Disabled &&
+        (startIndex == endIndex1 || startIndex == endIndex2)) {
+        return;
+    }
+    const auto merged1 =
+        mergedAssignments(dag1, endIndex1, Program::First,
+                          freeVarsMap1.at(startIndex), endIndex1 == EXIT_MARK);
+    const auto merged2 =
+        mergedAssignments(dag2, endIndex2, Program::Second,
+                          freeVarsMap2.at(startIndex), endIndex2 == EXIT_MARK);
+    if (!merged1 || !merged2) {
+        addForbiddenPaths(startIndex, endIndex1, endIndex2,
+                          dag1.paths(endIndex1), dag2.paths(endIndex2),
+                          freeVarsMap1, freeVarsMap2, marked, pathExprs,
+                          cache, equalities);
+        return;
+    }
+    vector<SharedSMTRef> forbidden;
+    for (const auto &end1 : merged1->ends) {
+        for (const auto &end2 : merged2->ends) {
+            if (intersection(marked.first.BlockToMarksMap.at(end1.first),
+                             marked.second.BlockToMarksMap.at(end2.first))
+                    .empty()) {
+                forbidden.push_back(makeOp("and", end1.second, end2.second));
+            }
+        }
+    }
+    if (forbidden.empty()) {
+        return;
+    }
+    SMTRef clause =
+        makeOp("=>", disjunction(std::move(forbidden)), forbiddenClauseHead());
+    clause = fastNestLets(std::move(clause), merged2->definitions);
+    clause = fastNestLets(std::move(clause), merged1->definitions);
+    pathExprs[startIndex].push_back(std::move(clause));
+}
+
 map<Mark, vector<std::unique_ptr<smt::SMTExpr>>>
 getForbiddenPaths(const MonoPair<PathMap> &pathMaps,
                   const MonoPair<BidirBlockMarkMap> &marked,
                   const FreeVarsMap &freeVarsMap1,
-                  const FreeVarsMap &freeVarsMap2, string funName, bool main) {
+                  const FreeVarsMap &freeVarsMap2, string funName, bool main,
+                  PathEncoding encoding, PathAssignmentCache &cache,
+                  const ValueEqualities &entryEqualities) {
     map<Mark, vector<std::unique_ptr<smt::SMTExpr>>> pathExprs;
+    if (encoding == PathEncoding::LargeBlock) {
+        for (const Mark startIndex : pathMaps.first.startMarks()) {
+            for (const Mark endIndex1 : pathMaps.first.endMarks(startIndex)) {
+                for (const Mark endIndex2 :
+                     pathMaps.second.endMarks(startIndex)) {
+                    if (endIndex1 == endIndex2) {
+                        continue;
+                    }
+                    for (const auto &dag1 : pathMaps.first.dags(startIndex)) {
+                        for (const auto &dag2 :
+                             pathMaps.second.dags(startIndex)) {
+                            if (dag1.endMarks().count(endIndex1) &&
+                                dag2.endMarks().count(endIndex2)) {
+                                addMergedForbiddenPaths(
+                                    startIndex, endIndex1, endIndex2, dag1,
+                                    dag2, freeVarsMap1, freeVarsMap2, marked,
+                                    pathExprs, cache,
+                                    equalitiesAt(startIndex, entryEqualities));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return pathExprs;
+    }
     for (const auto &pathMapIt : pathMaps.first) {
         const Mark startIndex = pathMapIt.first;
         for (const auto &pathsLeadingTo1 : pathMapIt.second) {
@@ -278,7 +554,9 @@ getForbiddenPaths(const MonoPair<PathMap> &pathMaps,
                     addForbiddenPaths(startIndex, endIndex1, endIndex2,
                                       pathsLeadingTo1.second,
                                       pathsLeadingTo2.second, freeVarsMap1,
-                                      freeVarsMap2, marked, pathExprs);
+                                      freeVarsMap2, marked, pathExprs, cache,
+                                      equalitiesAt(startIndex,
+                                                   entryEqualities));
                 }
             }
         }
@@ -296,30 +574,65 @@ functionalFunctionAssertions(const llvm::Function *f,
     const auto funArgs = analysisResults.at(f).functionArguments;
     const auto freeVarsMap = analysisResults.at(f).freeVariables;
     return nonmutualPaths(pathMap, freeVarsMap, prog, funName, returnType,
-                          getFunctionNumeralConstraints(f, prog));
+                          getFunctionNumeralConstraints(f, prog),
+                          pathEncoding(pathCount(pathMap), funName));
 }
 vector<std::unique_ptr<smt::SMTExpr>> nonmutualPaths(
     const PathMap &pathMap, const FreeVarsMap &freeVarsMap, Program prog,
     string funName, const llvm::Type *returnType,
-    vector<std::unique_ptr<smt::SMTExpr>> functionNumeralConstraints) {
+    vector<std::unique_ptr<smt::SMTExpr>> functionNumeralConstraints,
+    PathEncoding encoding) {
     map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> smtExprs;
-    for (const auto &pathMapIt : pathMap) {
-        const Mark startIndex = pathMapIt.first;
-        for (const auto &innerPathMapIt : pathMapIt.second) {
-            const Mark endIndex = innerPathMapIt.first;
-            for (const auto &path : innerPathMapIt.second) {
-                SMTRef endInvariant1 = functionalCouplingPredicate(
-                    startIndex, endIndex, freeVarsMap.at(startIndex),
-                    freeVarsMap.at(endIndex), asSelection(prog), funName,
-                    freeVarsMap);
-                const auto defs =
-                    assignmentsOnPath(path, prog, freeVarsMap.at(startIndex),
-                                      endIndex == EXIT_MARK);
-                auto clause = forallStartingAt(
-                    nonmutualSMT(std::move(endInvariant1), defs, prog),
-                    freeVarsMap.at(startIndex), startIndex, asSelection(prog),
-                    funName, false);
-                smtExprs[{startIndex, endIndex}].push_back(std::move(clause));
+    const auto endInvariant = [&](Mark startIndex, Mark endIndex) {
+        return functionalCouplingPredicate(
+            startIndex, endIndex, freeVarsMap.at(startIndex),
+            freeVarsMap.at(endIndex), asSelection(prog), funName, freeVarsMap);
+    };
+    const auto addClause = [&](Mark startIndex, Mark endIndex, SMTRef body) {
+        auto clause =
+            forallStartingAt(std::move(body), freeVarsMap.at(startIndex),
+                             startIndex, asSelection(prog), funName, false);
+        smtExprs[{startIndex, endIndex}].push_back(std::move(clause));
+    };
+    const auto addPaths = [&](Mark startIndex, Mark endIndex,
+                              const Paths &paths) {
+        for (const auto &path : paths) {
+            const auto defs =
+                assignmentsOnPath(path, prog, freeVarsMap.at(startIndex),
+                                  endIndex == EXIT_MARK);
+            addClause(startIndex, endIndex,
+                      nonmutualSMT(endInvariant(startIndex, endIndex), defs,
+                                   prog));
+        }
+    };
+    if (encoding == PathEncoding::LargeBlock) {
+        for (const Mark startIndex : pathMap.startMarks()) {
+            for (const Mark endIndex : pathMap.endMarks(startIndex)) {
+                for (const auto &dag : pathMap.dags(startIndex)) {
+                    if (dag.endMarks().find(endIndex) ==
+                        dag.endMarks().end()) {
+                        continue;
+                    }
+                    const auto merged = mergedAssignments(
+                        dag, endIndex, prog, freeVarsMap.at(startIndex),
+                        endIndex == EXIT_MARK);
+                    if (!merged) {
+                        addPaths(startIndex, endIndex, dag.paths(endIndex));
+                        continue;
+                    }
+                    addClause(startIndex, endIndex,
+                              fastNestLets(makeOp("=>", reachedEnd(*merged),
+                                                  endInvariant(startIndex,
+                                                               endIndex)),
+                                           merged->definitions));
+                }
+            }
+        }
+    } else {
+        for (const auto &pathMapIt : pathMap) {
+            for (const auto &innerPathMapIt : pathMapIt.second) {
+                addPaths(pathMapIt.first, innerPathMapIt.first,
+                         innerPathMapIt.second);
             }
         }
     }
@@ -344,36 +657,48 @@ static void appendStutterArguments(
     }
 }
 
+/// The clause head for a path on which only one program loops
+static SMTRef stutterEndInvariant(Mark loopMark, llvm::StringRef functionName,
+                                  Program loopingProgram,
+                                  const FreeVarsMap &freeVarsMap,
+                                  const PathMap &otherPathMap, bool iterative,
+                                  PathEncoding encoding,
+                                  PathAssignmentCache &cache) {
+    const int progIndex = programIndex(loopingProgram);
+    const auto waitingArgs =
+        filterVars(swapIndex(progIndex), freeVarsMap.at(loopMark));
+    const auto loopingArgs = filterVars(progIndex, freeVarsMap.at(loopMark));
+    vector<SortedVar> couplingPredicateArguments;
+    // Depending on which program we are looking at
+    appendStutterArguments(loopingProgram, loopingArgs, waitingArgs,
+                           std::back_inserter(couplingPredicateArguments));
+    SMTRef endInvariant;
+    if (iterative) {
+        endInvariant = iterativeCouplingPredicate(
+            loopMark, couplingPredicateArguments, functionName);
+    } else {
+        endInvariant = functionalCouplingPredicate(
+            loopMark, loopMark, freeVarsMap.at(loopMark),
+            couplingPredicateArguments, ProgramSelection::Both, functionName,
+            freeVarsMap);
+    }
+    return getDontLoopInvariant(std::move(endInvariant), loopMark,
+                                otherPathMap, freeVarsMap,
+                                swapProgram(loopingProgram), encoding, cache);
+}
+
 static void
 addStutterPaths(Mark loopMark, const std::vector<Path> &loopingPaths,
                 llvm::StringRef functionName, Program loopingProgram,
                 const FreeVarsMap &freeVarsMap, const PathMap &otherPathMap,
                 map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> &clauses,
-                bool iterative) {
-    const int progIndex = programIndex(loopingProgram);
+                bool iterative, PathEncoding encoding,
+                PathAssignmentCache &cache) {
     for (const auto &path : loopingPaths) {
-        const auto waitingArgs =
-            filterVars(swapIndex(progIndex), freeVarsMap.at(loopMark));
-        const auto loopingArgs =
-            filterVars(progIndex, freeVarsMap.at(loopMark));
-        vector<SortedVar> couplingPredicateArguments;
-        // Depending on which program we are looking at
-        appendStutterArguments(loopingProgram, loopingArgs, waitingArgs,
-                               std::back_inserter(couplingPredicateArguments));
-        SMTRef endInvariant;
-        if (iterative) {
-            endInvariant = iterativeCouplingPredicate(
-                loopMark, couplingPredicateArguments, functionName);
-        } else {
-            endInvariant = functionalCouplingPredicate(
-                loopMark, loopMark, freeVarsMap.at(loopMark),
-                couplingPredicateArguments, ProgramSelection::Both,
-                functionName, freeVarsMap);
-        }
-        SMTRef dontLoopInvariant = getDontLoopInvariant(
-            std::move(endInvariant), loopMark, otherPathMap, freeVarsMap,
-            swapProgram(loopingProgram));
-        const auto defs = assignmentsOnPath(
+        SMTRef dontLoopInvariant = stutterEndInvariant(
+            loopMark, functionName, loopingProgram, freeVarsMap, otherPathMap,
+            iterative, encoding, cache);
+        const auto &defs = cache.assignments(
             path, loopingProgram,
             filterVars(programIndex(loopingProgram), freeVarsMap.at(loopMark)),
             false);
@@ -382,11 +707,50 @@ addStutterPaths(Mark loopMark, const std::vector<Path> &loopingPaths,
     }
 }
 
+/// Large-block encoding of the looping paths of one program
+static void addMergedStutterPaths(
+    Mark loopMark, const PathDAG &dag, llvm::StringRef functionName,
+    Program loopingProgram, const FreeVarsMap &freeVarsMap,
+    const PathMap &otherPathMap,
+    map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> &clauses,
+    bool iterative, PathEncoding encoding, PathAssignmentCache &cache) {
+    const auto merged = mergedAssignments(
+        dag, loopMark, loopingProgram,
+        filterVars(programIndex(loopingProgram), freeVarsMap.at(loopMark)),
+        false);
+    if (!merged) {
+        addStutterPaths(loopMark, dag.paths(loopMark), functionName,
+                        loopingProgram, freeVarsMap, otherPathMap, clauses,
+                        iterative, encoding, cache);
+        return;
+    }
+    SMTRef clause =
+        makeOp("=>", reachedEnd(*merged),
+               stutterEndInvariant(loopMark, functionName, loopingProgram,
+                                   freeVarsMap, otherPathMap, iterative,
+                                   encoding, cache));
+    clauses[{loopMark, loopMark}].push_back(
+        fastNestLets(std::move(clause), merged->definitions));
+}
+
 static map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>>
 stutterPathsForProg(const PathMap &pathMap, const PathMap &otherPathMap,
                     const FreeVarsMap &freeVarsMap, Program prog,
-                    string funName, bool iterative) {
+                    string funName, bool iterative, PathEncoding encoding,
+                    PathAssignmentCache &cache) {
     map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> clauses;
+    if (encoding == PathEncoding::LargeBlock) {
+        for (const Mark loopMark : pathMap.startMarks()) {
+            for (const auto &dag : pathMap.dags(loopMark)) {
+                if (dag.endMarks().find(loopMark) != dag.endMarks().end()) {
+                    addMergedStutterPaths(loopMark, dag, funName, prog,
+                                          freeVarsMap, otherPathMap, clauses,
+                                          iterative, encoding, cache);
+                }
+            }
+        }
+        return clauses;
+    }
     for (const auto &pathMapIt : pathMap) {
         const Mark startMark = pathMapIt.first;
         for (const auto &pathsLeadingTo : pathMapIt.second) {
@@ -394,7 +758,8 @@ stutterPathsForProg(const PathMap &pathMap, const PathMap &otherPathMap,
             if (startMark == endMark) {
                 // we found a loop
                 addStutterPaths(startMark, pathsLeadingTo.second, funName, prog,
-                                freeVarsMap, otherPathMap, clauses, iterative);
+                                freeVarsMap, otherPathMap, clauses, iterative,
+                                encoding, cache);
             }
         }
     }
@@ -403,11 +768,14 @@ stutterPathsForProg(const PathMap &pathMap, const PathMap &otherPathMap,
 
 map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>>
 getStutterPaths(const PathMap &pathMap1, const PathMap &pathMap2,
-                const FreeVarsMap &freeVarsMap, string funName, bool main) {
-    auto firstPaths = stutterPathsForProg(pathMap1, pathMap2, freeVarsMap,
-                                          Program::First, funName, main);
-    auto secondPaths = stutterPathsForProg(pathMap2, pathMap1, freeVarsMap,
-                                           Program::Second, funName, main);
+                const FreeVarsMap &freeVarsMap, string funName, bool main,
+                PathEncoding encoding, PathAssignmentCache &cache) {
+    auto firstPaths =
+        stutterPathsForProg(pathMap1, pathMap2, freeVarsMap, Program::First,
+                            funName, main, encoding, cache);
+    auto secondPaths =
+        stutterPathsForProg(pathMap2, pathMap1, freeVarsMap, Program::Second,
+                            funName, main, encoding, cache);
     return mergeVectorMaps(std::move(firstPaths), std::move(secondPaths));
 }
 
@@ -450,6 +818,168 @@ vector<AssignmentCallBlock> assignmentsOnPath(const Path &path, Program prog,
     return allDefs;
 }
 
+const vector<AssignmentCallBlock> &
+PathAssignmentCache::assignments(const Path &path, Program prog,
+                                 const vector<SortedVar> &freeVars,
+                                 bool toEnd) {
+    Key key{prog, toEnd, path.Start, {}, {}};
+    key.edges.reserve(path.Edges.size());
+    for (const auto &edge : path.Edges) {
+        key.edges.emplace_back(edge.Cond.get(), edge.Block);
+    }
+    key.freeVars.reserve(freeVars.size());
+    for (const auto &var : freeVars) {
+        key.freeVars.push_back(var.name);
+    }
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        it = cache
+                 .emplace(std::move(key),
+                          assignmentsOnPath(path, prog, freeVars, toEnd))
+                 .first;
+    }
+    return it->second;
+}
+
+static bool containsCall(const vector<DefOrCallInfo> &defs) {
+    return std::any_of(defs.begin(), defs.end(), [](const auto &def) {
+        return def.tag == DefOrCallInfoTag::Call;
+    });
+}
+
+static string reachedName(Program prog, size_t node) {
+    return "reach$" + std::to_string(programIndex(prog)) + "_b" +
+           std::to_string(node);
+}
+
+/// Merge all paths of a DAG ending at a mark into one block of assignments
+/**
+Every block gets a boolean that holds if it is executed and the assignments of
+all blocks are bound in topological order. Phi nodes select their value based
+on the edge that has been taken. If a variable that is already bound is
+assigned in a block, the assignment only takes effect if the block is executed.
+Calls can’t be merged in this way, in that case nothing is returned.
+ */
+llvm::Optional<MergedPaths> mergedAssignments(const PathDAG &dag, Mark endMark,
+                                              Program prog,
+                                              const vector<SortedVar> &freeVars,
+                                              bool toEnd) {
+    const auto &nodes = dag.Nodes;
+    MergedPaths merged;
+    // Types of the variables which are bound so far and may be reassigned
+    map<string, Type> boundTypes;
+    for (const auto &var : freeVars) {
+        merged.definitions.emplace_back(
+            var.name, make_unique<TypedVariable>(var.name + "_old", var.type));
+        boundTypes.insert({var.name, var.type});
+    }
+    std::set<string> bound;
+    for (const auto &var : freeVars) {
+        bound.insert(var.name);
+    }
+
+    vector<SharedSMTRef> reached(nodes.size());
+    // The conditions under which the incoming edges of a node are taken
+    vector<vector<std::pair<size_t, SharedSMTRef>>> incoming(nodes.size());
+    for (size_t node = 0; node < nodes.size(); ++node) {
+        if (nodes[node].Reaches.find(endMark) == nodes[node].Reaches.end()) {
+            continue;
+        }
+        const llvm::BasicBlock &block = *nodes[node].Block;
+        if (node == 0) {
+            reached[node] = make_unique<ConstantBool>(true);
+        } else {
+            vector<SharedSMTRef> edges;
+            for (const auto &edge : incoming[node]) {
+                edges.push_back(edge.second);
+            }
+            const string name = reachedName(prog, node);
+            merged.definitions.emplace_back(name,
+                                            disjunction(std::move(edges)));
+            reached[node] = make_unique<TypedVariable>(name, boolType());
+        }
+
+        const bool end =
+            nodes[node].EndMarks.find(endMark) != nodes[node].EndMarks.end();
+        vector<AssignmentGroup> groups;
+        if (node != 0) {
+            // Select the value of each phi node based on the incoming edge
+            AssignmentVec phiAssgns;
+            for (const auto &instr : block) {
+                if (!llvm::isa<llvm::PHINode>(instr)) {
+                    break;
+                }
+                AssignmentVec selected;
+                for (const auto &edge : makeReverse(incoming[node])) {
+                    for (auto &group : instrAssignment(
+                             instr, nodes[edge.first].Block, prog)) {
+                        for (size_t i = 0; i < group->assgns.size(); ++i) {
+                            auto &assgn = group->assgns[i];
+                            if (i >= selected.size()) {
+                                selected.push_back(assgn);
+                            } else {
+                                selected[i].second = makeOp(
+                                    "ite", edge.second, assgn.second,
+                                    selected[i].second);
+                            }
+                        }
+                    }
+                }
+                phiAssgns.append(selected.begin(), selected.end());
+            }
+            groups.emplace_back(std::move(phiAssgns));
+        }
+        auto defs = blockAssignments(block, nullptr, end && !toEnd, prog);
+        if (containsCall(defs)) {
+            return llvm::None;
+        }
+        for (auto &def : defs) {
+            groups.push_back(std::move(*def.definition));
+        }
+
+        for (auto &group : groups) {
+            for (auto &assgn : group.assgns) {
+                const string &name = assgn.first;
+                if (bound.find(name) != bound.end()) {
+                    auto type = boundTypes.find(name);
+                    if (type == boundTypes.end()) {
+                        return llvm::None;
+                    }
+                    assgn.second = makeOp(
+                        "ite", reached[node], assgn.second,
+                        make_unique<TypedVariable>(name, type->second));
+                }
+            }
+            for (const auto &assgn : group.assgns) {
+                bound.insert(assgn.first);
+            }
+            merged.definitions.push_back(std::move(group));
+        }
+
+        if (end) {
+            merged.ends.emplace_back(nodes[node].Block, reached[node]);
+        }
+        for (const auto &succ : nodes[node].Successors) {
+            SharedSMTRef taken = reached[node];
+            if (succ.Cond && node == 0) {
+                taken = succ.Cond->toSmt();
+            } else if (succ.Cond) {
+                taken = makeOp("and", reached[node], succ.Cond->toSmt());
+            }
+            incoming[succ.Node].emplace_back(node, std::move(taken));
+        }
+    }
+    return merged;
+}
+
+SharedSMTRef reachedEnd(const MergedPaths &merged) {
+    vector<SharedSMTRef> ends;
+    for (const auto &end : merged.ends) {
+        ends.push_back(end.second);
+    }
+    return disjunction(std::move(ends));
+}
+
 std::unique_ptr<smt::SMTExpr>
 addAssignments(std::unique_ptr<smt::SMTExpr> end,
                llvm::ArrayRef<AssignmentBlock> assignments) {
@@ -784,8 +1314,7 @@ SplitAssignments splitAssignmentsFromCalls(
         vector<AssignmentGroup> currentDefinitions;
         for (auto &defOrCall : assignments.definitions) {
             if (defOrCall.tag == DefOrCallInfoTag::Def) {
-                currentDefinitions.emplace_back(
-                    std::move(*defOrCall.definition));
+                currentDefinitions.emplace_back(*defOrCall.definition);
             } else {
                 currentAssignmentsList.emplace_back(
                     std::move(currentDefinitions), std::move(condition));
@@ -794,7 +1323,7 @@ SplitAssignments splitAssignmentsFromCalls(
                     std::move(currentAssignmentsList));
                 currentAssignmentsList.clear();
                 condition = nullptr;
-                callInfos.emplace_back(std::move(*defOrCall.callInfo));
+                callInfos.emplace_back(*defOrCall.callInfo);
             }
         }
         currentAssignmentsList.emplace_back(std::move(currentDefinitions),
@@ -812,9 +1341,9 @@ void checkPathMaps(const PathMap &map1, const PathMap &map2) {
 }
 
 bool mapSubset(const PathMap &map1, const PathMap &map2) {
-    for (const auto &Pair : map1) {
-        if (map2.find(Pair.first) == map2.end()) {
-            logError("Mark '" + Pair.first.toString() +
+    for (const Mark mark : map1.startMarks()) {
+        if (!map2.hasStartMark(mark)) {
+            logError("Mark '" + mark.toString() +
                      "' doesn’t exist in both files\n");
             return false;
         }
@@ -824,23 +1353,42 @@ bool mapSubset(const PathMap &map1, const PathMap &map2) {
 
 SMTRef getDontLoopInvariant(SMTRef endClause, Mark startIndex,
                             const PathMap &pathMap, const FreeVarsMap &freeVars,
-                            Program prog) {
+                            Program prog, PathEncoding encoding,
+                            PathAssignmentCache &cache) {
     SMTRef clause = std::move(endClause);
-    vector<Path> dontLoopPaths;
-    for (auto pathMapIt : pathMap.at(startIndex)) {
-        if (pathMapIt.first == startIndex) {
-            for (auto path : pathMapIt.second) {
-                dontLoopPaths.push_back(path);
+    const auto loopVars =
+        filterVars(programIndex(prog), freeVars.at(startIndex));
+    vector<SharedSMTRef> dontLoopExprs;
+    const auto addPaths = [&](const Paths &dontLoopPaths) {
+        for (const auto &path : dontLoopPaths) {
+            const auto &defs = cache.assignments(path, prog, loopVars, false);
+            auto smt =
+                nonmutualSMT(make_unique<ConstantBool>(false), defs, prog);
+            dontLoopExprs.push_back(std::move(smt));
+        }
+    };
+    if (encoding == PathEncoding::LargeBlock) {
+        for (const auto &dag : pathMap.dags(startIndex)) {
+            if (dag.endMarks().find(startIndex) == dag.endMarks().end()) {
+                continue;
+            }
+            const auto merged =
+                mergedAssignments(dag, startIndex, prog, loopVars, false);
+            if (!merged) {
+                addPaths(dag.paths(startIndex));
+                continue;
+            }
+            dontLoopExprs.push_back(
+                fastNestLets(makeOp("=>", reachedEnd(*merged),
+                                    make_unique<ConstantBool>(false)),
+                             merged->definitions));
+        }
+    } else {
+        for (const auto &pathMapIt : pathMap.at(startIndex)) {
+            if (pathMapIt.first == startIndex) {
+                addPaths(pathMapIt.second);
             }
         }
-    }
-    vector<SharedSMTRef> dontLoopExprs;
-    for (auto path : dontLoopPaths) {
-        auto defs = assignmentsOnPath(
-            path, prog, filterVars(programIndex(prog), freeVars.at(startIndex)),
-            false);
-        auto smt = nonmutualSMT(make_unique<ConstantBool>(false), defs, prog);
-        dontLoopExprs.push_back(std::move(smt));
     }
     if (!dontLoopExprs.empty()) {
         auto andExpr = make_unique<Op>("and", dontLoopExprs);
@@ -865,54 +1413,6 @@ auto addMemory(vector<SharedSMTRef> &implArgs)
     };
 }
 
-void generateRelationalFunctionSMT(
-    MonoPair<const llvm::Function *> preprocessedFunction,
-    const AnalysisResultsMap &analysisResults, vector<SharedSMTRef> &assertions,
-    vector<SharedSMTRef> &declarations) {
-    auto newAssertions =
-        relationalFunctionAssertions(preprocessedFunction, analysisResults);
-    auto newDeclarations =
-        relationalFunctionDeclarations(preprocessedFunction, analysisResults);
-    assertions.insert(assertions.end(),
-                      std::make_move_iterator(newAssertions.begin()),
-                      std::make_move_iterator(newAssertions.end()));
-    declarations.insert(declarations.end(),
-                        std::make_move_iterator(newDeclarations.begin()),
-                        std::make_move_iterator(newDeclarations.end()));
-}
-void generateFunctionalFunctionSMT(const llvm::Function *preprocessedFunction,
-                                   const AnalysisResultsMap &analysisResults,
-                                   Program prog,
-                                   vector<SharedSMTRef> &assertions,
-                                   vector<SharedSMTRef> &declarations) {
-    auto newAssertions = functionalFunctionAssertions(preprocessedFunction,
-                                                      analysisResults, prog);
-    auto newDeclarations = functionalFunctionDeclarations(
-        preprocessedFunction, analysisResults, prog);
-    assertions.insert(assertions.end(),
-                      std::make_move_iterator(newAssertions.begin()),
-                      std::make_move_iterator(newAssertions.end()));
-    declarations.insert(declarations.end(),
-                        std::make_move_iterator(newDeclarations.begin()),
-                        std::make_move_iterator(newDeclarations.end()));
-}
-
-void generateRelationalIterativeSMT(
-    MonoPair<const llvm::Function *> preprocessedFunctions,
-    const AnalysisResultsMap &analysisResults, vector<SharedSMTRef> &assertions,
-    vector<SharedSMTRef> &declarations) {
-    auto newAssertions =
-        relationalIterativeAssertions(preprocessedFunctions, analysisResults);
-    auto newDeclarations =
-        relationalIterativeDeclarations(preprocessedFunctions, analysisResults);
-    assertions.insert(assertions.end(),
-                      std::make_move_iterator(newAssertions.begin()),
-                      std::make_move_iterator(newAssertions.end()));
-    declarations.insert(declarations.end(),
-                        std::make_move_iterator(newDeclarations.begin()),
-                        std::make_move_iterator(newDeclarations.end()));
-}
-
 vector<std::unique_ptr<smt::SMTExpr>> clauseMapToClauseVector(
     map<MarkPair, vector<std::unique_ptr<smt::SMTExpr>>> clauseMap, bool main,
     ProgramSelection programSelection,
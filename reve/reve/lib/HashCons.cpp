@@ -0,0 +1,186 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#include "HashCons.h"
+
+#include <algorithm>
+#include <sstream>
+
+using std::shared_ptr;
+using std::string;
+
+namespace smt {
+
+// Keys consist of a tag identifying the node type followed by the fields of
+// the node. Children are already interned when their parent is looked up so
+// they are identified by their address, names by the id of their symbol.
+
+static void appendString(string &key, llvm::StringRef str) {
+    key.append(str.data(), str.size());
+    key += '\0';
+}
+
+static void appendNumber(string &key, uint64_t n) {
+    key.append(reinterpret_cast<const char *>(&n), sizeof(n));
+}
+
+static void appendSymbol(string &key, const Symbol &symbol) {
+    appendNumber(key, symbol.id());
+}
+
+static void appendChild(string &key, const SharedSMTRef &child) {
+    appendNumber(key, reinterpret_cast<uintptr_t>(child.get()));
+}
+
+static void appendType(string &key, const Type &type) {
+    switch (type.getTag()) {
+    case TypeTag::Bool:
+        key += 'b';
+        break;
+    case TypeTag::Int:
+        key += 'i';
+        appendNumber(key, type.unsafeBitWidth());
+        break;
+    case TypeTag::Float:
+    case TypeTag::Array: {
+        // Rare enough that going through the SExpr does not matter
+        std::ostringstream out;
+        type.toSExpr()->serialize(out, 0, false);
+        key += 't';
+        appendString(key, out.str());
+        break;
+    }
+    }
+}
+
+static void appendAPInt(string &key, const llvm::APInt &value) {
+    appendNumber(key, value.getBitWidth());
+    appendString(key, value.toString(16, false));
+}
+
+struct HashConsVisitor : SMTVisitor {
+    HashConsTable &table;
+    explicit HashConsVisitor(HashConsTable &table) : table(table) {}
+    shared_ptr<SMTExpr> reassemble(TypedVariable &var) override {
+        string key = "v";
+        appendSymbol(key, var.name);
+        appendType(key, var.type);
+        return table.lookup(std::move(key), var.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(Forall &forall) override {
+        string key = "A";
+        appendNumber(key, forall.vars.size());
+        for (const auto &var : forall.vars) {
+            appendSymbol(key, var.name);
+            appendType(key, var.type);
+        }
+        appendChild(key, forall.expr);
+        return table.lookup(std::move(key), forall.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(Let &let) override {
+        string key = "l";
+        appendNumber(key, let.defs.assgns.size());
+        for (const auto &def : let.defs.assgns) {
+            appendSymbol(key, def.first);
+            appendChild(key, def.second);
+        }
+        appendChild(key, let.expr);
+        return table.lookup(std::move(key), let.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(ConstantFP &constant) override {
+        string key = "f";
+        appendAPInt(key, constant.value.bitcastToAPInt());
+        return table.lookup(std::move(key), constant.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(ConstantInt &constant) override {
+        string key = "n";
+        appendAPInt(key, constant.value);
+        return table.lookup(std::move(key), constant.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(ConstantBool &constant) override {
+        string key = constant.value ? "T" : "F";
+        return table.lookup(std::move(key), constant.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(ConstantString &str) override {
+        string key = "s";
+        appendString(key, str.value);
+        return table.lookup(std::move(key), str.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(Op &op) override {
+        string key = op.instantiate ? "o" : "O";
+        appendSymbol(key, op.opName);
+        appendNumber(key, op.args.size());
+        for (const auto &arg : op.args) {
+            appendChild(key, arg);
+        }
+        return table.lookup(std::move(key), op.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(FPCmp &cmp) override {
+        string key = "c";
+        appendNumber(key, static_cast<uint64_t>(cmp.op));
+        appendType(key, cmp.type);
+        appendChild(key, cmp.op0);
+        appendChild(key, cmp.op1);
+        return table.lookup(std::move(key), cmp.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(BinaryFPOperator &binOp) override {
+        string key = "B";
+        appendNumber(key, static_cast<uint64_t>(binOp.op));
+        appendType(key, binOp.type);
+        appendChild(key, binOp.op0);
+        appendChild(key, binOp.op1);
+        return table.lookup(std::move(key), binOp.shared_from_this());
+    }
+    shared_ptr<SMTExpr> reassemble(TypeCast &cast) override {
+        string key = "C";
+        appendNumber(key, static_cast<uint64_t>(cast.op));
+        appendType(key, cast.sourceType);
+        appendType(key, cast.destType);
+        appendChild(key, cast.operand);
+        return table.lookup(std::move(key), cast.shared_from_this());
+    }
+};
+
+SharedSMTRef HashConsTable::intern(const SMTExpr &expr) {
+    HashConsVisitor visitor(*this);
+    return expr.accept(visitor);
+}
+
+SharedSMTRef HashConsTable::lookup(string key, SharedSMTRef expr) {
+    auto &entry = table[std::move(key)];
+    if (auto canonical = entry.lock()) {
+        return canonical;
+    }
+    entry = expr;
+    if (table.size() >= sweepThreshold) {
+        sweep();
+    }
+    return expr;
+}
+
+size_t HashConsTable::size() const {
+    return static_cast<size_t>(
+        std::count_if(table.begin(), table.end(),
+                      [](const auto &entry) { return !entry.second.expired(); }));
+}
+
+// Drop entries whose expressions have been freed. The threshold grows with
+// the number of live entries so sweeping takes amortized constant time.
+void HashConsTable::sweep() {
+    for (auto it = table.begin(); it != table.end();) {
+        if (it->second.expired()) {
+            it = table.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    sweepThreshold = std::max<size_t>(1024, 2 * table.size());
+}
+}
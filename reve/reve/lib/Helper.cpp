@@ -16,6 +16,8 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Operator.h"
 
+#include <mutex>
+
 using std::make_unique;
 using std::set;
 using std::string;
@@ -79,6 +81,10 @@ SMTRef instrNameOrVal(const llvm::Value *val, const llvm::Type *ty) {
 
 int typeSize(llvm::Type *Ty, const llvm::DataLayout &layout) {
     if (SMTGenerationOpts::getInstance().ByteHeap == ByteHeapOpt::Enabled) {
+        // The DataLayout caches struct layouts lazily so concurrent queries
+        // during parallel SMT generation have to be serialized
+        static std::mutex layoutMutex;
+        std::lock_guard<std::mutex> lock(layoutMutex);
         return static_cast<int>(layout.getTypeAllocSize(Ty));
     }
     if (auto IntTy = llvm::dyn_cast<llvm::IntegerType>(Ty)) {
@@ -140,8 +140,8 @@ SMTRef iterativeCouplingPredicate(Mark EndIndex, vector<SortedVar> FreeVars,
                                      stringExpr(resultName(Program::Second))};
         for (const auto &arg : FreeVars) {
             // No stack in output
-            if (arg.name.compare(0, 5, "STACK") &&
-                arg.name.compare(0, 2, "SP")) {
+            if (arg.name.str().compare(0, 5, "STACK") &&
+                arg.name.str().compare(0, 2, "SP")) {
                 args.push_back(typedVariableFromSortedVar(arg));
             }
         }
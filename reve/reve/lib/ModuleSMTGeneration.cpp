@@ -11,14 +11,17 @@
 #include "ModuleSMTGeneration.h"
 
 #include "Compat.h"
+#include "Declaration.h"
 #include "FixedAbstraction.h"
 #include "FunctionSMTGeneration.h"
+#include "HashCons.h"
 #include "Helper.h"
 #include "Invariant.h"
 #include "Memory.h"
 #include "Slicing.h"
 
 #include "llvm/IR/Constants.h"
+#include "llvm/Support/ThreadPool.h"
 
 using std::make_unique;
 using std::shared_ptr;
@@ -32,6 +35,42 @@ using namespace llreve::opts;
 vector<SharedSMTRef> generateSMT(MonoPair<const llvm::Module &> modules,
                                  const AnalysisResultsMap &analysisResults,
                                  FileOptions fileOpts) {
+    vector<SharedSMTRef> smtExprs;
+    vector<SharedSMTRef> footer = generateSMTStreaming(
+        modules, analysisResults, fileOpts,
+        [&smtExprs](vector<SharedSMTRef> header) {
+            smtExprs = std::move(header);
+        },
+        [&smtExprs](SharedSMTRef assertion) {
+            smtExprs.push_back(std::move(assertion));
+        },
+        InvariantDeclarations::Include);
+    smtExprs.insert(smtExprs.end(), footer.begin(), footer.end());
+    return smtExprs;
+}
+
+// We only need to generate a relational abstraction if both program call a
+// function transitively since we will never couple calls otherwise
+static bool needsRelationalAbstraction(MonoPair<llvm::Function *> funPair) {
+    const auto &smtOpts = SMTGenerationOpts::getInstance();
+    auto isCalledFromMain =
+        callsTransitively(*smtOpts.MainFunctions.first, *funPair.first) &&
+        callsTransitively(*smtOpts.MainFunctions.second, *funPair.second);
+    // Main is abstracted using an iterative encoding except for the case
+    // where OnlyRecursive is enabled
+    auto onlyRecursiveMain =
+        funPair == smtOpts.MainFunctions &&
+        smtOpts.OnlyRecursive == FunctionEncoding::OnlyRecursive;
+    return !hasMutualFixedAbstraction(funPair) &&
+           (onlyRecursiveMain || isCalledFromMain);
+}
+
+vector<SharedSMTRef> generateSMTStreaming(
+    MonoPair<const llvm::Module &> modules,
+    const AnalysisResultsMap &analysisResults, FileOptions fileOpts,
+    const std::function<void(vector<SharedSMTRef>)> &emitHeader,
+    const std::function<void(SharedSMTRef)> &emitAssertion,
+    InvariantDeclarations invariantDeclarations) {
     std::vector<SharedSMTRef> declarations;
     std::vector<SortedVar> variableDeclarations;
     SMTGenerationOpts &smtOpts = SMTGenerationOpts::getInstance();
@@ -61,37 +100,14 @@ vector<SharedSMTRef> generateSMT(MonoPair<const llvm::Module &> modules,
     // perform better than a recursive encoding
     generateSMTForMainFunctions(modules, analysisResults, fileOpts, assertions,
                                 declarations);
-
-    for (auto &funPair : smtOpts.CoupledFunctions) {
-        // We only need to generate a relational abstraction if both program
-        // call a function transitively since we will never couple calls
-        // otherwise
-        auto isCalledFromMain =
-            callsTransitively(*smtOpts.MainFunctions.first, *funPair.first) &&
-            callsTransitively(*smtOpts.MainFunctions.second, *funPair.second);
-        // Main is abstracted using an iterative encoding except for the case
-        // where OnlyRecursive is enabled
-        auto onlyRecursiveMain =
-            funPair == smtOpts.MainFunctions &&
-            smtOpts.OnlyRecursive == FunctionEncoding::OnlyRecursive;
-        if (!hasMutualFixedAbstraction(funPair) &&
-            (onlyRecursiveMain || isCalledFromMain)) {
-            if (funPair.first->getName() == "__criterion") {
-                auto newSmtExprs = slicingAssertion(funPair, analysisResults);
-                assertions.insert(assertions.end(), newSmtExprs.begin(),
-                                  newSmtExprs.end());
-            } else {
-                generateRelationalFunctionSMT(funPair, analysisResults,
-                                              assertions, declarations);
-            }
-        }
+    // The declarations of the invariants only depend on the analysis results,
+    // so the complete header is known before the first assertion is emitted
+    if (invariantDeclarations == InvariantDeclarations::Include) {
+        auto newDeclarations =
+            generateInvariantDeclarations(modules, analysisResults);
+        declarations.insert(declarations.end(), newDeclarations.begin(),
+                            newDeclarations.end());
     }
-    generateFunctionalAbstractions(modules.first, smtOpts.MainFunctions.first,
-                                   analysisResults, Program::First, assertions,
-                                   declarations);
-    generateFunctionalAbstractions(modules.second, smtOpts.MainFunctions.second,
-                                   analysisResults, Program::Second, assertions,
-                                   declarations);
 
     smtExprs.insert(smtExprs.end(), declarations.begin(), declarations.end());
     if (SMTGenerationOpts::getInstance().Invert) {
@@ -108,20 +124,94 @@ vector<SharedSMTRef> generateSMT(MonoPair<const llvm::Module &> modules,
             make_unique<VarDecl>(SortedVar("PROGRAM_1", boolType())));
         smtExprs.push_back(
             make_unique<VarDecl>(SortedVar("PROGRAM_2", boolType())));
-        smtExprs.push_back(
-            make_unique<Assert>(make_unique<Op>("or", assertions)));
+    }
+    emitHeader(std::move(smtExprs));
+
+    // Paths of different functions and marks repeat the same subterms (heap
+    // selects, argument equalities, …). With -hash-cons the assertions are
+    // interned, which shares them between the assertions that are alive at the
+    // same time and reduces the memory used while they are collected. The
+    // sharing only lasts until the assertions are rewritten, since the
+    // rewriting passes copy the nodes, so it is only worth the copy made by
+    // interning if many assertions are collected. This runs on the main thread
+    // in the order of the jobs.
+    HashConsTable hashCons;
+    auto intern = [&](vector<SharedSMTRef> &newAssertions) {
+        if (!smtOpts.HashCons) {
+            return;
+        }
+        for (auto &assertion : newAssertions) {
+            assertion = hashCons.intern(*assertion);
+        }
+    };
+    // In inverted mode all assertions are combined in a single disjunction so
+    // they can only be emitted at the end
+    auto emitAssertions = [&](vector<SharedSMTRef> &newAssertions) {
+        intern(newAssertions);
+        if (smtOpts.Invert) {
+            assertions.insert(assertions.end(), newAssertions.begin(),
+                              newAssertions.end());
+        } else {
+            for (auto &assertion : newAssertions) {
+                emitAssertion(make_unique<Assert>(std::move(assertion)));
+            }
+        }
+        newAssertions.clear();
+    };
+    if (smtOpts.Invert) {
+        intern(assertions);
     } else {
-        for (const auto &assertion : assertions) {
-            smtExprs.push_back(make_unique<Assert>(assertion));
+        emitAssertions(assertions);
+    }
+
+    // The abstractions of the coupled and uncoupled functions are independent
+    // of each other. Every job writes to separate vectors which are merged in
+    // the order of the jobs so the result does not depend on scheduling.
+    vector<GenerationJob> jobs;
+    for (auto &funPair : smtOpts.CoupledFunctions) {
+        if (!needsRelationalAbstraction(funPair)) {
+            continue;
+        }
+        if (funPair.first->getName() == "__criterion") {
+            jobs.emplace_back([funPair, &analysisResults](
+                vector<SharedSMTRef> &jobAssertions) {
+                auto newSmtExprs = slicingAssertion(funPair, analysisResults);
+                jobAssertions.insert(jobAssertions.end(), newSmtExprs.begin(),
+                                     newSmtExprs.end());
+            });
+        } else {
+            jobs.emplace_back([funPair, &analysisResults](
+                vector<SharedSMTRef> &jobAssertions) {
+                auto newAssertions =
+                    relationalFunctionAssertions(funPair, analysisResults);
+                jobAssertions.insert(
+                    jobAssertions.end(),
+                    std::make_move_iterator(newAssertions.begin()),
+                    std::make_move_iterator(newAssertions.end()));
+            });
         }
     }
+    addFunctionalAbstractionJobs(modules.first, smtOpts.MainFunctions.first,
+                                 analysisResults, Program::First, jobs);
+    addFunctionalAbstractionJobs(modules.second, smtOpts.MainFunctions.second,
+                                 analysisResults, Program::Second, jobs);
+    runGenerationJobs(jobs, smtOpts.Threads,
+                      [&emitAssertions](GenerationJob &job) {
+                          emitAssertions(job.assertions);
+                      });
+
+    vector<SharedSMTRef> footer;
+    if (SMTGenerationOpts::getInstance().Invert) {
+        footer.push_back(
+            make_unique<Assert>(make_unique<Op>("or", assertions)));
+    }
     if (smtOpts.OutputFormat == SMTFormat::Z3) {
-        smtExprs.push_back(make_unique<Query>("END_QUERY"));
+        footer.push_back(make_unique<Query>("END_QUERY"));
     } else {
-        smtExprs.push_back(make_unique<CheckSat>());
-        smtExprs.push_back(make_unique<GetModel>());
+        footer.push_back(make_unique<CheckSat>());
+        footer.push_back(make_unique<GetModel>());
     }
-    return smtExprs;
+    return footer;
 }
 
 void generateSMTForMainFunctions(MonoPair<const llvm::Module &> modules,
@@ -144,22 +234,121 @@ void generateSMTForMainFunctions(MonoPair<const llvm::Module &> modules,
         declarations.push_back(initPredicateComment(*inInv));
         assertions.push_back(initImplication(*inInv));
     }
-    generateRelationalIterativeSMT(smtOpts.MainFunctions, analysisResults,
-                                   assertions, declarations);
+    // A custom relation replaces the equalities of the inputs unless it is
+    // marked as additional
+    auto newAssertions = relationalIterativeAssertions(
+        smtOpts.MainFunctions, analysisResults,
+        !fileOpts.InRelation || fileOpts.AdditionalInRelation);
+    assertions.insert(assertions.end(),
+                      std::make_move_iterator(newAssertions.begin()),
+                      std::make_move_iterator(newAssertions.end()));
+}
+
+static bool needsFunctionalAbstraction(const llvm::Function &fun,
+                                       const llvm::Function &mainFunction) {
+    return !isLlreveIntrinsic(fun) && !hasFixedAbstraction(fun) &&
+           callsTransitively(mainFunction, fun);
+}
+
+vector<SharedSMTRef>
+generateInvariantDeclarations(MonoPair<const llvm::Module &> modules,
+                              const AnalysisResultsMap &analysisResults) {
+    const auto &smtOpts = SMTGenerationOpts::getInstance();
+    vector<SharedSMTRef> declarations = relationalIterativeDeclarations(
+        smtOpts.MainFunctions, analysisResults);
+    auto append = [&declarations](vector<SharedSMTRef> newDeclarations) {
+        declarations.insert(declarations.end(), newDeclarations.begin(),
+                            newDeclarations.end());
+    };
+    // The order matches the one of the generation jobs
+    for (auto &funPair : smtOpts.CoupledFunctions) {
+        if (needsRelationalAbstraction(funPair) &&
+            funPair.first->getName() != "__criterion") {
+            append(relationalFunctionDeclarations(funPair, analysisResults));
+        }
+    }
+    for (auto &fun : modules.first) {
+        if (needsFunctionalAbstraction(fun, *smtOpts.MainFunctions.first)) {
+            append(functionalFunctionDeclarations(&fun, analysisResults,
+                                                  Program::First));
+        }
+    }
+    for (auto &fun : modules.second) {
+        if (needsFunctionalAbstraction(fun, *smtOpts.MainFunctions.second)) {
+            append(functionalFunctionDeclarations(&fun, analysisResults,
+                                                  Program::Second));
+        }
+    }
+    return declarations;
 }
 
 void generateFunctionalAbstractions(
     const llvm::Module &module, const llvm::Function *mainFunction,
     const AnalysisResultsMap &analysisResults, Program prog,
-    std::vector<smt::SharedSMTRef> &assertions,
-    std::vector<smt::SharedSMTRef> &declarations) {
+    std::vector<smt::SharedSMTRef> &assertions) {
     for (auto &fun : module) {
-        if (!isLlreveIntrinsic(fun) && !hasFixedAbstraction(fun) &&
-            callsTransitively(*mainFunction, fun)) {
-            generateFunctionalFunctionSMT(&fun, analysisResults, prog,
-                                          assertions, declarations);
+        if (needsFunctionalAbstraction(fun, *mainFunction)) {
+            auto newAssertions =
+                functionalFunctionAssertions(&fun, analysisResults, prog);
+            assertions.insert(assertions.end(),
+                              std::make_move_iterator(newAssertions.begin()),
+                              std::make_move_iterator(newAssertions.end()));
+        }
+    }
+}
+
+void addFunctionalAbstractionJobs(const llvm::Module &module,
+                                  const llvm::Function *mainFunction,
+                                  const AnalysisResultsMap &analysisResults,
+                                  Program prog,
+                                  std::vector<GenerationJob> &jobs) {
+    for (auto &fun : module) {
+        if (needsFunctionalAbstraction(fun, *mainFunction)) {
+            const llvm::Function *funPtr = &fun;
+            jobs.emplace_back([funPtr, &analysisResults, prog](
+                vector<SharedSMTRef> &jobAssertions) {
+                auto newAssertions =
+                    functionalFunctionAssertions(funPtr, analysisResults, prog);
+                jobAssertions.insert(
+                    jobAssertions.end(),
+                    std::make_move_iterator(newAssertions.begin()),
+                    std::make_move_iterator(newAssertions.end()));
+            });
+        }
+    }
+}
+
+void runGenerationJobs(std::vector<GenerationJob> &jobs, unsigned threads,
+                       const std::function<void(GenerationJob &)> &finished) {
+    if (threads <= 1 || jobs.size() <= 1) {
+        for (auto &job : jobs) {
+            job.generate(job.assertions);
+            finished(job);
+        }
+        return;
+    }
+    threads = std::min(threads, static_cast<unsigned>(jobs.size()));
+    llvm::ThreadPool pool(threads);
+    // Results are consumed in the order of the jobs, so only a few jobs are
+    // allowed to run ahead of the consumer. Otherwise the results of all jobs
+    // could be alive at the same time.
+    const size_t window = 2 * static_cast<size_t>(threads);
+    vector<std::shared_future<void>> results(jobs.size());
+    auto submit = [&pool, &jobs, &results](size_t i) {
+        GenerationJob &job = jobs[i];
+        results[i] = pool.async([&job] { job.generate(job.assertions); });
+    };
+    for (size_t i = 0; i < std::min(window, jobs.size()); ++i) {
+        submit(i);
+    }
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        results[i].wait();
+        finished(jobs[i]);
+        if (i + window < jobs.size()) {
+            submit(i + window);
         }
     }
+    pool.wait();
 }
 
 SMTRef select_Declaration() {
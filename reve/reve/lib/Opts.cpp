@@ -44,7 +44,8 @@ void SMTGenerationOpts::initialize(
     set<MonoPair<const llvm::Function *>> assumeEquivalent,
     set<MonoPair<llvm::Function *>> coupledFunctions,
     map<const llvm::Function *, int> functionNumerals,
-    MonoPair<map<int, const llvm::Function *>> reversedFunctionNumerals) {
+    MonoPair<map<int, const llvm::Function *>> reversedFunctionNumerals,
+    PathEncoding encoding, uint64_t pathBudget) {
     SMTGenerationOpts &i = getInstance();
     i.MainFunctions = mainFunctions;
     i.Heap = heap;
@@ -67,6 +68,8 @@ void SMTGenerationOpts::initialize(
     i.CoupledFunctions = coupledFunctions;
     i.FunctionNumerals = functionNumerals;
     i.ReversedFunctionNumerals = reversedFunctionNumerals;
+    i.Encoding = encoding;
+    i.PathBudget = pathBudget;
 }
 
 void parseCommandLineArguments(int argc, const char **argv) {
@@ -13,9 +13,13 @@
 #include "Helper.h"
 #include "InferMarks.h"
 
+#include <algorithm>
 #include <iostream>
 
+#include "llvm/ADT/Optional.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/MathExtras.h"
 
 using std::make_shared;
 using std::unique_ptr;
@@ -46,123 +50,229 @@ PathMap PathAnalysis::run(llvm::Function &fun,
     return pathMap;
 }
 
-PathMap findPaths(BidirBlockMarkMap markedBlocks) {
-    PathMap MyPaths;
-    for (auto BBTuple : markedBlocks.MarkToBlocksMap) {
+PathMap findPaths(const BidirBlockMarkMap &markedBlocks) {
+    std::map<Mark, std::vector<PathDAG>> DAGs;
+    for (const auto &BBTuple : markedBlocks.MarkToBlocksMap) {
         // don't start at return instructäions
         if (BBTuple.first != EXIT_MARK && BBTuple.first != UNREACHABLE_MARK) {
             for (auto BB : BBTuple.second) {
-                const std::map<Mark, Paths> NewPaths =
-                    findPathsStartingAt(BBTuple.first, BB, markedBlocks);
-                for (auto NewPathTuple : NewPaths) {
-                    MyPaths[BBTuple.first][NewPathTuple.first].insert(
-                        MyPaths[BBTuple.first][NewPathTuple.first].end(),
-                        NewPathTuple.second.begin(), NewPathTuple.second.end());
-                }
+                DAGs[BBTuple.first].emplace_back(BBTuple.first, BB,
+                                                 markedBlocks);
             }
         }
     }
-    return MyPaths;
+    return PathMap(std::move(DAGs));
 }
 
-std::map<Mark, Paths> findPathsStartingAt(Mark For, llvm::BasicBlock *BB,
-                                          BidirBlockMarkMap BidirBlockMarkMap) {
-    std::map<Mark, Paths> FoundPaths;
-    const auto MyPaths = traverse(BB, BidirBlockMarkMap, true, {});
-    for (auto &PathIt : MyPaths) {
-        set<Mark> Indices;
-        if (PathIt.empty()) {
-            Indices.insert(EXIT_MARK);
+namespace {
+// Depth-first construction of a PathDAG. Nodes are appended in post order and
+// memoized per block so every block is only visited once.
+struct DAGBuilder {
+    Mark StartMark;
+    llvm::BasicBlock *Start;
+    const BidirBlockMarkMap &MarkedBlocks;
+    std::vector<PathDAG::Node> Nodes;
+    std::map<const llvm::BasicBlock *, size_t> Visited;
+    std::set<const llvm::BasicBlock *> OnStack;
+
+    size_t visit(llvm::BasicBlock *BB, bool First);
+    void addSuccessor(std::vector<PathDAG::Successor> &Successors,
+                      std::shared_ptr<Condition> Cond,
+                      llvm::BasicBlock *BB) {
+        Successors.push_back({std::move(Cond), visit(BB, false)});
+    }
+};
+}
+
+size_t DAGBuilder::visit(llvm::BasicBlock *BB, bool First) {
+    if (!First) {
+        auto VisitedIt = Visited.find(BB);
+        if (VisitedIt != Visited.end()) {
+            return VisitedIt->second;
+        }
+    }
+    PathDAG::Node Node;
+    Node.Block = BB;
+    if ((!First && isMarked(*BB, MarkedBlocks)) ||
+        isReturn(*BB, MarkedBlocks)) {
+        if (First) {
+            Node.EndMarks.insert(EXIT_MARK);
         } else {
-            Indices = BidirBlockMarkMap.BlockToMarksMap.at(PathIt.back().Block);
+            for (auto Index : MarkedBlocks.BlockToMarksMap.at(BB)) {
+                // don't allow paths to the same node but with a different mark
+                if (!(BB == Start && Index != StartMark)) {
+                    Node.EndMarks.insert(Index);
+                }
+            }
         }
-        for (auto Index : Indices) {
-            // don't allow paths to the same node but with a different mark
-            if (PathIt.empty() ||
-                !(PathIt.back().Block == BB && Index != For)) {
-                FoundPaths[Index].push_back(Path(BB, PathIt));
+    } else {
+        if (OnStack.find(BB) != OnStack.end()) {
+            logErrorData("Found cycle at block:\n", *BB);
+            exit(1);
+        }
+        OnStack.insert(BB);
+        auto TermInst = BB->getTerminator();
+        if (auto BranchInst = llvm::dyn_cast<llvm::BranchInst>(TermInst)) {
+            if (BranchInst->isUnconditional()) {
+                addSuccessor(Node.Successors, nullptr,
+                             BranchInst->getSuccessor(0));
+            } else {
+                addSuccessor(Node.Successors,
+                             make_shared<BooleanCondition>(
+                                 BranchInst->getCondition(), true),
+                             BranchInst->getSuccessor(0));
+                addSuccessor(Node.Successors,
+                             make_shared<BooleanCondition>(
+                                 BranchInst->getCondition(), false),
+                             BranchInst->getSuccessor(1));
+            }
+        } else if (auto SwitchInst =
+                       llvm::dyn_cast<llvm::SwitchInst>(TermInst)) {
+            std::vector<llvm::APInt> Vals;
+            for (auto Case : SwitchInst->cases()) {
+                Vals.push_back(Case.getCaseValue()->getValue());
+                addSuccessor(Node.Successors,
+                             make_shared<SwitchCondition>(
+                                 SwitchInst->getCondition(),
+                                 Case.getCaseValue()->getValue()),
+                             Case.getCaseSuccessor());
             }
+            // Handle default case separately
+            addSuccessor(Node.Successors,
+                         make_shared<SwitchDefault>(SwitchInst->getCondition(),
+                                                    Vals),
+                         SwitchInst->getDefaultDest());
+        } else {
+            logWarningData("Unknown terminator\n", *TermInst);
         }
+        OnStack.erase(BB);
+    }
+    Node.Reaches = Node.EndMarks;
+    for (const auto &Succ : Node.Successors) {
+        const auto &SuccReaches = Nodes[Succ.Node].Reaches;
+        Node.Reaches.insert(SuccReaches.begin(), SuccReaches.end());
     }
-    return FoundPaths;
+    Nodes.push_back(std::move(Node));
+    if (!First) {
+        Visited[BB] = Nodes.size() - 1;
+    }
+    return Nodes.size() - 1;
 }
 
-Paths_ traverse(llvm::BasicBlock *BB, BidirBlockMarkMap MarkedBlocks,
-                bool First, std::set<const llvm::BasicBlock *> Visited) {
-    std::set<std::string> Constructed;
-    if ((!First && isMarked(*BB, MarkedBlocks)) ||
-        isReturn(*BB, MarkedBlocks)) {
-        Paths_ MyPaths;
-        MyPaths.push_back(Path_());
-        return MyPaths;
-    }
-    if (Visited.find(BB) != Visited.end()) {
-        logErrorData("Found cycle at block:\n", *BB);
-        exit(1);
-    }
-    Visited.insert(BB);
-    auto TermInst = BB->getTerminator();
-    if (auto BranchInst = llvm::dyn_cast<llvm::BranchInst>(TermInst)) {
-        if (BranchInst->isUnconditional()) {
-            auto TraversedPaths = traverse(BranchInst->getSuccessor(0),
-                                           MarkedBlocks, false, Visited);
-            for (auto &P : TraversedPaths) {
-                P.insert(P.begin(), Edge(nullptr, BranchInst->getSuccessor(0)));
-            }
-            return TraversedPaths;
-        }
-        auto TraversedPaths0 =
-            traverse(BranchInst->getSuccessor(0), MarkedBlocks, false, Visited);
-        auto TraversedPaths1 =
-            traverse(BranchInst->getSuccessor(1), MarkedBlocks, false, Visited);
-        for (auto &P : TraversedPaths0) {
-            P.insert(P.begin(), Edge(make_shared<BooleanCondition>(
-                                         BranchInst->getCondition(), true),
-                                     BranchInst->getSuccessor(0)));
-        }
-        for (auto &P : TraversedPaths1) {
-            P.insert(P.begin(), Edge(make_shared<BooleanCondition>(
-                                         BranchInst->getCondition(), false),
-                                     BranchInst->getSuccessor(1)));
-        }
-        TraversedPaths0.insert(TraversedPaths0.end(), TraversedPaths1.begin(),
-                               TraversedPaths1.end());
-        return TraversedPaths0;
-    }
-    if (auto SwitchInst = llvm::dyn_cast<llvm::SwitchInst>(TermInst)) {
-        Paths_ TraversedPaths;
-        std::vector<llvm::APInt> Vals;
-        for (auto Case : SwitchInst->cases()) {
-            Vals.push_back(Case.getCaseValue()->getValue());
-            auto TraversedPaths_ =
-                traverse(Case.getCaseSuccessor(), MarkedBlocks, false, Visited);
-            for (auto &P : TraversedPaths_) {
-                P.insert(P.begin(), Edge(make_shared<SwitchCondition>(
-                                             SwitchInst->getCondition(),
-                                             Case.getCaseValue()->getValue()),
-                                         Case.getCaseSuccessor()));
+PathDAG::PathDAG(Mark StartMark, llvm::BasicBlock *Start,
+                 const BidirBlockMarkMap &MarkedBlocks)
+    : StartMark(StartMark) {
+    DAGBuilder Builder{StartMark, Start, MarkedBlocks, {}, {}, {}};
+    Builder.visit(Start, true);
+    // Reverse the post order to get a topological order starting at Start
+    const size_t Size = Builder.Nodes.size();
+    Nodes.reserve(Size);
+    for (auto It = Builder.Nodes.rbegin(); It != Builder.Nodes.rend(); ++It) {
+        for (auto &Succ : It->Successors) {
+            Succ.Node = Size - 1 - Succ.Node;
+        }
+        Nodes.push_back(std::move(*It));
+    }
+}
+
+static void enumeratePaths(const PathDAG &DAG, size_t NodeIndex, Mark EndMark,
+                           Path_ &Prefix, Paths &Result) {
+    const auto &Node = DAG.Nodes[NodeIndex];
+    if (Node.EndMarks.find(EndMark) != Node.EndMarks.end()) {
+        Result.push_back(Path(DAG.start(), Prefix));
+    }
+    for (const auto &Succ : Node.Successors) {
+        const auto &SuccNode = DAG.Nodes[Succ.Node];
+        if (SuccNode.Reaches.find(EndMark) != SuccNode.Reaches.end()) {
+            Prefix.push_back(Edge(Succ.Cond, SuccNode.Block));
+            enumeratePaths(DAG, Succ.Node, EndMark, Prefix, Result);
+            Prefix.pop_back();
+        }
+    }
+}
+
+Paths PathDAG::paths(Mark EndMark) const {
+    Paths Result;
+    Path_ Prefix;
+    enumeratePaths(*this, 0, EndMark, Prefix, Result);
+    return Result;
+}
+
+uint64_t PathDAG::pathCount(Mark EndMark) const {
+    // The nodes are in topological order, so the successors of a node have
+    // been counted when it is reached in reverse
+    std::vector<uint64_t> Counts(Nodes.size(), 0);
+    for (size_t I = Nodes.size(); I-- > 0;) {
+        const auto &Node = Nodes[I];
+        uint64_t Count = Node.EndMarks.count(EndMark);
+        for (const auto &Succ : Node.Successors) {
+            Count = llvm::SaturatingAdd(Count, Counts[Succ.Node]);
+        }
+        Counts[I] = Count;
+    }
+    return Counts.empty() ? 0 : Counts.front();
+}
+
+PathMap::PathMap(std::map<Mark, std::vector<PathDAG>> DAGs) {
+    shared->DAGs = std::move(DAGs);
+}
+
+const std::map<Mark, std::map<Mark, Paths>> &PathMap::value() const {
+    std::call_once(shared->Enumerated, [this] {
+        for (const auto &DAGs : shared->DAGs) {
+            for (const auto &DAG : DAGs.second) {
+                for (Mark EndMark : DAG.endMarks()) {
+                    auto &Found = shared->Value[DAGs.first][EndMark];
+                    auto NewPaths = DAG.paths(EndMark);
+                    Found.insert(Found.end(), NewPaths.begin(),
+                                 NewPaths.end());
+                }
             }
-            TraversedPaths.insert(TraversedPaths.end(), TraversedPaths_.begin(),
-                                  TraversedPaths_.end());
         }
-        // Handle default case separately
-        auto TraversedPaths_ = traverse(SwitchInst->getDefaultDest(),
-                                        MarkedBlocks, false, Visited);
-        for (auto &P : TraversedPaths_) {
-            P.insert(P.begin(), Edge(make_shared<SwitchDefault>(
-                                         SwitchInst->getCondition(), Vals),
-                                     SwitchInst->getDefaultDest()));
+    });
+    return shared->Value;
+}
+
+std::vector<Mark> PathMap::startMarks() const {
+    std::vector<Mark> Marks;
+    for (const auto &DAGs : shared->DAGs) {
+        if (hasStartMark(DAGs.first)) {
+            Marks.push_back(DAGs.first);
+        }
+    }
+    return Marks;
+}
+
+bool PathMap::hasStartMark(Mark mark) const {
+    auto DAGs = shared->DAGs.find(mark);
+    if (DAGs == shared->DAGs.end()) {
+        return false;
+    }
+    for (const auto &DAG : DAGs->second) {
+        if (!DAG.endMarks().empty()) {
+            return true;
         }
-        TraversedPaths.insert(TraversedPaths.end(), TraversedPaths_.begin(),
-                              TraversedPaths_.end());
+    }
+    return false;
+}
+
+std::set<Mark> PathMap::endMarks(Mark startMark) const {
+    std::set<Mark> Marks;
+    for (const auto &DAG : shared->DAGs.at(startMark)) {
+        Marks.insert(DAG.endMarks().begin(), DAG.endMarks().end());
+    }
+    return Marks;
+}
 
-        return TraversedPaths;
+uint64_t PathMap::pathCount(Mark startMark, Mark endMark) const {
+    uint64_t Count = 0;
+    for (const auto &DAG : shared->DAGs.at(startMark)) {
+        Count = llvm::SaturatingAdd(Count, DAG.pathCount(endMark));
     }
-    logWarningData("Unknown terminator\n", *TermInst);
-    return Paths_();
+    return Count;
 }
 
-bool isMarked(llvm::BasicBlock &BB, BidirBlockMarkMap MarkedBlocks) {
+bool isMarked(llvm::BasicBlock &BB, const BidirBlockMarkMap &MarkedBlocks) {
     const auto Marks = MarkedBlocks.BlockToMarksMap.find(&BB);
     if (Marks != MarkedBlocks.BlockToMarksMap.end()) {
         return !(Marks->second.empty());
@@ -170,7 +280,7 @@ bool isMarked(llvm::BasicBlock &BB, BidirBlockMarkMap MarkedBlocks) {
     return false;
 }
 
-bool isReturn(llvm::BasicBlock &BB, BidirBlockMarkMap MarkedBlocks) {
+bool isReturn(llvm::BasicBlock &BB, const BidirBlockMarkMap &MarkedBlocks) {
     const auto Marks = MarkedBlocks.BlockToMarksMap.find(&BB);
     if (Marks != MarkedBlocks.BlockToMarksMap.end()) {
         return Marks->second.find(EXIT_MARK) != Marks->second.end() ||
@@ -201,6 +311,237 @@ SMTRef SwitchCondition::toSmt() const {
                   std::make_unique<ConstantInt>(Val));
 }
 
+static const llvm::Value *representative(const llvm::Value *Val,
+                                         const PathFacts &Facts) {
+    auto It = Facts.Representatives.find(Val);
+    return It == Facts.Representatives.end() ? Val : It->second;
+}
+
+static llvm::Optional<llvm::APInt> knownValue(const llvm::Value *Val,
+                                              const PathFacts &Facts) {
+    if (auto Const = llvm::dyn_cast<llvm::ConstantInt>(Val)) {
+        return Const->getValue();
+    }
+    auto It = Facts.Values.find(representative(Val, Facts));
+    if (It == Facts.Values.end()) {
+        return llvm::None;
+    }
+    return It->second;
+}
+
+// Constants can come from either program and thus from different contexts, so
+// they are compared by value
+static bool sameConstant(const llvm::APInt &Lhs, const llvm::APInt &Rhs) {
+    return Lhs.getBitWidth() == Rhs.getBitWidth() && Lhs == Rhs;
+}
+
+// Operands of comparisons are the same if they are represented by the same
+// value or are equal constants
+static bool sameOperand(const llvm::Value *Lhs, const llvm::Value *Rhs) {
+    if (Lhs == Rhs) {
+        return true;
+    }
+    const auto LhsConst = llvm::dyn_cast<llvm::ConstantInt>(Lhs);
+    const auto RhsConst = llvm::dyn_cast<llvm::ConstantInt>(Rhs);
+    return LhsConst && RhsConst &&
+           sameConstant(LhsConst->getValue(), RhsConst->getValue());
+}
+
+// Record that Pred holds for the representatives of Lhs and Rhs. Returns false
+// if a known comparison of the same operands excludes this.
+static bool assumeComparison(llvm::CmpInst::Predicate Pred,
+                             const llvm::Value *Lhs, const llvm::Value *Rhs,
+                             PathFacts &Facts) {
+    Lhs = representative(Lhs, Facts);
+    Rhs = representative(Rhs, Facts);
+    for (const auto &Known : Facts.Comparisons) {
+        llvm::CmpInst::Predicate KnownPred = Known.Pred;
+        if (sameOperand(Known.Lhs, Rhs) && sameOperand(Known.Rhs, Lhs)) {
+            KnownPred = llvm::CmpInst::getSwappedPredicate(KnownPred);
+        } else if (!sameOperand(Known.Lhs, Lhs) ||
+                   !sameOperand(Known.Rhs, Rhs)) {
+            continue;
+        }
+        if (llvm::CmpInst::isImpliedFalseByMatchingCmp(KnownPred, Pred)) {
+            return false;
+        }
+    }
+    Facts.Comparisons.push_back({Pred, Lhs, Rhs});
+    return true;
+}
+
+// Record that Val has the value Const and propagate the facts this implies
+// for the operands of Val
+static bool assumeValue(const llvm::Value *Val, const llvm::APInt &Const,
+                        PathFacts &Facts) {
+    if (auto Known = knownValue(Val, Facts)) {
+        return sameConstant(*Known, Const);
+    }
+    Facts.Values[representative(Val, Facts)] = Const;
+    if (const auto Cmp = llvm::dyn_cast<llvm::ICmpInst>(Val)) {
+        const auto Pred = Const.getBoolValue() ? Cmp->getPredicate()
+                                               : Cmp->getInversePredicate();
+        if (!assumeComparison(Pred, Cmp->getOperand(0), Cmp->getOperand(1),
+                              Facts)) {
+            return false;
+        }
+        if (Pred == llvm::CmpInst::ICMP_EQ) {
+            if (auto Rhs = knownValue(Cmp->getOperand(1), Facts)) {
+                return assumeValue(Cmp->getOperand(0), *Rhs, Facts);
+            }
+            if (auto Lhs = knownValue(Cmp->getOperand(0), Facts)) {
+                return assumeValue(Cmp->getOperand(1), *Lhs, Facts);
+            }
+        }
+    }
+    if (const auto BinOp = llvm::dyn_cast<llvm::BinaryOperator>(Val)) {
+        // (and a b) is only true if both are true, (or a b) is only false if
+        // both are false
+        if (BinOp->getType()->isIntegerTy(1) &&
+            ((BinOp->getOpcode() == llvm::Instruction::And &&
+              Const.getBoolValue()) ||
+             (BinOp->getOpcode() == llvm::Instruction::Or &&
+              !Const.getBoolValue()))) {
+            return assumeValue(BinOp->getOperand(0), Const, Facts) &&
+                   assumeValue(BinOp->getOperand(1), Const, Facts);
+        }
+    }
+    return true;
+}
+
+bool BooleanCondition::assume(PathFacts &Facts) const {
+    return assumeValue(Cond, llvm::APInt(1, True), Facts);
+}
+
+bool SwitchCondition::assume(PathFacts &Facts) const {
+    return assumeValue(Cond, Val, Facts);
+}
+
+bool SwitchDefault::assume(PathFacts &Facts) const {
+    const auto Known = knownValue(Cond, Facts);
+    return !Known ||
+           std::none_of(Vals.begin(), Vals.end(), [&Known](const auto &Val) {
+               return sameConstant(*Known, Val);
+           });
+}
+
+// Only fold instructions for which the result is the same for the integer and
+// the bitvector encoding, i.e. no overflows and no bitwise operations on
+// integers
+static llvm::Optional<llvm::APInt>
+foldInstruction(const llvm::Instruction &Instr,
+                llvm::ArrayRef<llvm::APInt> Ops) {
+    if (const auto Cmp = llvm::dyn_cast<llvm::ICmpInst>(&Instr)) {
+        if (Cmp->isUnsigned() && (Ops[0].isNegative() || Ops[1].isNegative())) {
+            return llvm::None;
+        }
+        return llvm::APInt(
+            1, llvm::ICmpInst::compare(Ops[0], Ops[1], Cmp->getPredicate()));
+    }
+    if (llvm::isa<llvm::SelectInst>(Instr)) {
+        return Ops[0].getBoolValue() ? Ops[1] : Ops[2];
+    }
+    const auto BinOp = llvm::dyn_cast<llvm::BinaryOperator>(&Instr);
+    if (!BinOp) {
+        return llvm::None;
+    }
+    const llvm::APInt &Lhs = Ops[0];
+    const llvm::APInt &Rhs = Ops[1];
+    bool Overflow = false;
+    llvm::APInt Result;
+    switch (BinOp->getOpcode()) {
+    case llvm::Instruction::Add:
+        Result = Lhs.sadd_ov(Rhs, Overflow);
+        break;
+    case llvm::Instruction::Sub:
+        Result = Lhs.ssub_ov(Rhs, Overflow);
+        break;
+    case llvm::Instruction::Mul:
+        Result = Lhs.smul_ov(Rhs, Overflow);
+        break;
+    case llvm::Instruction::And:
+        Result = Lhs & Rhs;
+        break;
+    case llvm::Instruction::Or:
+        Result = Lhs | Rhs;
+        break;
+    case llvm::Instruction::Xor:
+        Result = Lhs ^ Rhs;
+        break;
+    default:
+        return llvm::None;
+    }
+    // Bitwise operations are only encoded precisely for booleans
+    if (Overflow || (BinOp->isBitwiseLogicOp() &&
+                     !BinOp->getType()->isIntegerTy(1))) {
+        return llvm::None;
+    }
+    return Result;
+}
+
+// Add the values of the instructions in BB that can be folded to constants.
+// Prev is the block from which BB is entered, nullptr for the first block.
+static void evaluateBlock(llvm::BasicBlock &BB, const llvm::BasicBlock *Prev,
+                          PathFacts &Facts) {
+    for (auto &Instr : BB) {
+        if (const auto Phi = llvm::dyn_cast<llvm::PHINode>(&Instr)) {
+            if (Prev) {
+                if (auto Known = knownValue(
+                        Phi->getIncomingValueForBlock(Prev), Facts)) {
+                    Facts.Values[Phi] = *Known;
+                }
+            }
+            continue;
+        }
+        llvm::SmallVector<llvm::APInt, 3> Ops;
+        for (const auto &Op : Instr.operands()) {
+            auto Known = knownValue(Op, Facts);
+            if (!Known) {
+                break;
+            }
+            Ops.push_back(*Known);
+        }
+        if (Ops.size() != Instr.getNumOperands() || Ops.empty()) {
+            continue;
+        }
+        if (auto Folded = foldInstruction(Instr, Ops)) {
+            Facts.Values.insert({&Instr, *Folded});
+        }
+    }
+}
+
+static bool assumePath(const Path &Path, PathFacts &Facts) {
+    evaluateBlock(*Path.Start, nullptr, Facts);
+    const llvm::BasicBlock *Prev = Path.Start;
+    for (size_t I = 0; I < Path.Edges.size(); ++I) {
+        const auto &Edge = Path.Edges[I];
+        if (Edge.Cond && !Edge.Cond->assume(Facts)) {
+            return false;
+        }
+        // Only the phi nodes of the last block are evaluated and there are no
+        // conditions after them
+        if (I + 1 < Path.Edges.size()) {
+            evaluateBlock(*Edge.Block, Prev, Facts);
+        }
+        Prev = Edge.Block;
+    }
+    return true;
+}
+
+bool isFeasible(const Path &Path) {
+    PathFacts Facts;
+    return assumePath(Path, Facts);
+}
+
+bool isFeasiblePair(const Path &Path1, const Path &Path2,
+                    const ValueEqualities &Equalities) {
+    PathFacts Facts;
+    for (const auto &Equality : Equalities) {
+        Facts.Representatives[Equality.second] = Equality.first;
+    }
+    return assumePath(Path1, Facts) && assumePath(Path2, Facts);
+}
+
 SMTRef SwitchDefault::toSmt() const {
     std::vector<SharedSMTRef> StringVals;
     for (auto Val : Vals) {
@@ -27,12 +27,15 @@
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/ADCE.h"
 #include "llvm/Transforms/Scalar/SimplifyCFG.h"
 #include "llvm/Transforms/Utils/LoopSimplify.h"
 #include "llvm/Transforms/Utils/Mem2Reg.h"
 
+#include <thread>
+
 using std::map;
 using std::vector;
 using std::shared_ptr;
@@ -67,14 +70,35 @@ static void detectMemoryOptions(MonoPair<const llvm::Module &> modules) {
 AnalysisResultsMap preprocessModules(MonoPair<llvm::Module &> modules,
                                      PreprocessOpts opts) {
     map<const llvm::Function *, PassAnalysisResults> passResults;
-    runFunctionPasses(modules.first, opts, passResults, Program::First);
-    runFunctionPasses(modules.second, opts, passResults, Program::Second);
+    // The passes modify the IR so they can only run concurrently if the
+    // modules don’t share an LLVMContext
+    if (opts.Threads > 1 &&
+        &modules.first.getContext() != &modules.second.getContext()) {
+        map<const llvm::Function *, PassAnalysisResults> secondPassResults;
+        std::thread secondPasses([&modules, &opts, &secondPassResults] {
+            runFunctionPasses(modules.second, opts, secondPassResults,
+                              Program::Second);
+        });
+        runFunctionPasses(modules.first, opts, passResults, Program::First);
+        secondPasses.join();
+        passResults.insert(secondPassResults.begin(), secondPassResults.end());
+    } else {
+        runFunctionPasses(modules.first, opts, passResults, Program::First);
+        runFunctionPasses(modules.second, opts, passResults, Program::Second);
+    }
     nameModuleGlobals(modules.first, Program::First);
     nameModuleGlobals(modules.second, Program::Second);
     detectMemoryOptions(modules);
     AnalysisResultsMap analysisResults;
-    runAnalyses(modules.first, Program::First, passResults, analysisResults);
-    runAnalyses(modules.second, Program::Second, passResults, analysisResults);
+    if (opts.Threads > 1) {
+        runAnalysesParallel(modules, passResults, analysisResults,
+                            opts.Threads);
+    } else {
+        runAnalyses(modules.first, Program::First, passResults,
+                    analysisResults);
+        runAnalyses(modules.second, Program::Second, passResults,
+                    analysisResults);
+    }
     return analysisResults;
 }
 
@@ -131,8 +155,8 @@ PassAnalysisResults runFunctionPasses(llvm::Function &fun, Program prog,
     // TODO reenable
     // fpm->add(llvm::createConstantPropagationPass());
     // // Passes need to have a default ctor
-    UniqueNamePass::Prefix = std::to_string(programIndex(prog));
-    fpm.addPass(UniqueNamePass{}); // prefix register names
+    // prefix register names
+    fpm.addPass(UniqueNamePass(std::to_string(programIndex(prog))));
     if (opts.ShowMarkedCFG) {
         fpm.addPass(llvm::CFGViewerPass()); // show marked cfg
     }
@@ -169,6 +193,41 @@ void runAnalyses(const llvm::Module &module, Program prog,
     }
 }
 
+void runAnalysesParallel(
+    MonoPair<const llvm::Module &> modules,
+    map<const llvm::Function *, PassAnalysisResults> &passResults,
+    AnalysisResultsMap &analysisResults, unsigned threads) {
+    vector<std::pair<const llvm::Function *, Program>> functions;
+    auto collectFunctions = [&functions](const llvm::Module &module,
+                                         Program prog) {
+        for (auto &f : module) {
+            if (!f.isIntrinsic() && !isLlreveIntrinsic(f) &&
+                !hasFixedAbstraction(f)) {
+                functions.push_back({&f, prog});
+            }
+        }
+    };
+    collectFunctions(modules.first, Program::First);
+    collectFunctions(modules.second, Program::Second);
+
+    // The analyses only read the IR and passResults. Each function gets its
+    // own slot and the results are merged afterwards.
+    vector<std::unique_ptr<AnalysisResults>> results(functions.size());
+    {
+        llvm::ThreadPool pool(threads);
+        for (size_t i = 0; i < functions.size(); ++i) {
+            pool.async([i, &functions, &passResults, &results] {
+                results[i] = std::make_unique<AnalysisResults>(runAnalyses(
+                    *functions[i].first, functions[i].second, passResults));
+            });
+        }
+        pool.wait();
+    }
+    for (size_t i = 0; i < functions.size(); ++i) {
+        analysisResults.insert({functions[i].first, std::move(*results[i])});
+    }
+}
+
 AnalysisResults runAnalyses(
     const llvm::Function &fun, Program prog,
     std::map<const llvm::Function *, PassAnalysisResults> &passResults) {
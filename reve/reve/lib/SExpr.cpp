@@ -9,6 +9,7 @@
  */
 #include "SExpr.h"
 
+#include <sstream>
 #include <string>
 
 using namespace sexpr;
@@ -78,6 +79,100 @@ const llvm::StringSet<> Apply::atomicOps = {
     "div",    "_",      "bvadd",   "bvsub",    "bvmul",  "store",
     "store_", "select", "select_", "Array"};
 
+// The layout decisions have to match Apply::serialize and List::serialize
+// exactly, otherwise the output depends on which path has been used.
+size_t SExprWriter::beginElement() {
+    if (frames.empty()) {
+        return 0;
+    }
+    Frame &frame = frames.back();
+    switch (frame.separator) {
+    case Separator::Space:
+        buffer += ' ';
+        break;
+    case Separator::NewlineAfterFirst:
+        if (frame.first) {
+            break;
+        }
+    // fallthrough
+    case Separator::Newline:
+        buffer += '\n';
+        buffer.append(frame.childIndent, ' ');
+        break;
+    }
+    frame.first = false;
+    return frame.childIndent;
+}
+
+void SExprWriter::value(llvm::StringRef val) {
+    beginElement();
+    buffer.append(val.data(), val.size());
+}
+
+void SExprWriter::comment(llvm::StringRef val) {
+    beginElement();
+    buffer += "; ";
+    buffer.append(val.data(), val.size());
+}
+
+void SExprWriter::openApply(llvm::StringRef fun, size_t numArgs) {
+    size_t indent = beginElement();
+    buffer += '(';
+    buffer.append(fun.data(), fun.size());
+    if (!pretty) {
+        frames.push_back({indent + 3, Separator::Space, true});
+        return;
+    }
+    bool atomicOp = Apply::atomicOps.find(fun) != Apply::atomicOps.end();
+    bool simpleOp = numArgs <= 1 && Apply::forceIndentOps.find(fun) ==
+                                        Apply::forceIndentOps.end();
+    bool inv = fun.startswith("INV") || fun == "OUT_INV" || fun == "IN_INV" ||
+               fun == "INIT";
+    if (atomicOp || simpleOp || inv) {
+        frames.push_back({indent + fun.size() + 3, Separator::Space, true});
+    } else {
+        frames.push_back({indent + 3, Separator::Newline, true});
+    }
+}
+
+void SExprWriter::openList() {
+    size_t indent = beginElement();
+    buffer += '(';
+    frames.push_back({indent + 1, Separator::NewlineAfterFirst, true});
+}
+
+void SExprWriter::close() {
+    frames.pop_back();
+    buffer += ')';
+    if (frames.empty()) {
+        maybeFlush();
+    }
+}
+
+void SExprWriter::sexpr(const SExpr &expr) {
+    size_t indent = beginElement();
+    std::ostringstream out;
+    expr.serialize(out, indent, pretty);
+    buffer += out.str();
+}
+
+void SExprWriter::newline() {
+    buffer += '\n';
+    maybeFlush();
+}
+
+void SExprWriter::maybeFlush() {
+    // 64KiB is large enough to make the number of writes negligible
+    if (buffer.size() >= (1 << 16)) {
+        flush();
+    }
+}
+
+void SExprWriter::flush() {
+    os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+}
+
 SExprRef sexprFromString(string value) { return make_unique<Value>(value); }
 
 std::ostream &sexpr::operator<<(std::ostream &os, const SExpr &val) {
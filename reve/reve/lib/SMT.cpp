@@ -9,12 +9,14 @@
  */
 
 #include "SMT.h"
+#include "SMTTraversal.h"
 
 #include "Compat.h"
 #include "Helper.h"
 #include "Memory.h"
 #include "Opts.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace smt {
@@ -32,9 +34,32 @@ using namespace sexpr;
 
 // Implementations of toSExpr()
 
-SExprRef TypedVariable::toSExpr() const { return sexprFromString(name); }
+struct SExprPass : PostOrderPass<SExprRef> {
+    auto enter(const SMTExpr &expr) -> llvm::Optional<SExprRef> {
+        if (expr.childCount() == 0) {
+            return expr.assembleSExpr({});
+        }
+        return llvm::None;
+    }
+    auto leave(const SMTExpr &expr, vector<SExprRef> results) -> SExprRef {
+        SExprVec operands;
+        for (auto &result : results) {
+            operands.push_back(std::move(result));
+        }
+        return expr.assembleSExpr(std::move(operands));
+    }
+};
+
+SExprRef SMTExpr::toSExpr() const {
+    SExprPass pass;
+    return traversePostOrder(*this, pass);
+}
+
+SExprRef TypedVariable::assembleSExpr(SExprVec /* unused */) const {
+    return sexprFromString(name);
+}
 
-SExprRef ConstantFP::toSExpr() const {
+SExprRef ConstantFP::assembleSExpr(SExprVec /* unused */) const {
     if (SMTGenerationOpts::getInstance().BitVect) {
         logError("Bitvector representation of floating points is not yet "
                  "implemented\n");
@@ -54,7 +79,7 @@ SExprRef ConstantFP::toSExpr() const {
     }
 }
 
-SExprRef ConstantInt::toSExpr() const {
+SExprRef ConstantInt::assembleSExpr(SExprVec /* unused */) const {
     if (SMTGenerationOpts::getInstance().BitVect) {
         unsigned bitWidth = value.getBitWidth();
         unsigned hexWidth = bitWidth / 4;
@@ -77,7 +102,7 @@ SExprRef ConstantInt::toSExpr() const {
     }
 }
 
-SExprRef ConstantBool::toSExpr() const {
+SExprRef ConstantBool::assembleSExpr(SExprVec /* unused */) const {
     if (value) {
         return sexprFromString("true");
     } else {
@@ -85,9 +110,11 @@ SExprRef ConstantBool::toSExpr() const {
     }
 }
 
-SExprRef ConstantString::toSExpr() const { return sexprFromString(value); }
+SExprRef ConstantString::assembleSExpr(SExprVec /* unused */) const {
+    return sexprFromString(value);
+}
 
-SExprRef SetLogic::toSExpr() const {
+SExprRef SetLogic::assembleSExpr(SExprVec /* unused */) const {
     SExprVec args;
     SExprRef logicPtr = make_unique<Value>(logic);
 
@@ -95,12 +122,12 @@ SExprRef SetLogic::toSExpr() const {
     return std::make_unique<Apply>("set-logic", std::move(args));
 }
 
-SExprRef CheckSat::toSExpr() const {
+SExprRef CheckSat::assembleSExpr(SExprVec /* unused */) const {
     SExprVec args;
     return std::make_unique<Apply>("check-sat", std::move(args));
 }
 
-SExprRef Query::toSExpr() const {
+SExprRef Query::assembleSExpr(SExprVec /* unused */) const {
     SExprVec args;
     args.push_back(make_unique<Value>(queryName));
     args.push_back(make_unique<Value>(":print-certificate"));
@@ -108,14 +135,14 @@ SExprRef Query::toSExpr() const {
     return std::make_unique<Apply>("query", std::move(args));
 }
 
-SExprRef GetModel::toSExpr() const {
+SExprRef GetModel::assembleSExpr(SExprVec /* unused */) const {
     SExprVec args;
     return std::make_unique<Apply>("get-model", std::move(args));
 }
 
-SExprRef Assert::toSExpr() const {
+SExprRef Assert::assembleSExpr(SExprVec operands) const {
     SExprVec args;
-    args.push_back(expr->toSExpr());
+    args.push_back(std::move(operands[0]));
     const string keyword =
         SMTGenerationOpts::getInstance().OutputFormat == SMTFormat::Z3
             ? "rule"
@@ -123,9 +150,9 @@ SExprRef Assert::toSExpr() const {
     return std::make_unique<Apply>(keyword, std::move(args));
 }
 
-SExprRef Forall::toSExpr() const {
+SExprRef Forall::assembleSExpr(SExprVec operands) const {
     if (vars.empty()) {
-        return expr->toSExpr();
+        return std::move(operands[0]);
     }
     SExprVec args;
     SExprVec sortedVars;
@@ -133,7 +160,7 @@ SExprRef Forall::toSExpr() const {
         sortedVars.push_back(sortedVar.toSExpr());
     }
     args.push_back(std::make_unique<List>(std::move(sortedVars)));
-    args.push_back(expr->toSExpr());
+    args.push_back(std::move(operands[0]));
     return std::make_unique<Apply>("forall", std::move(args));
 }
 
@@ -143,39 +170,36 @@ SExprRef SortedVar::toSExpr() const {
     return std::make_unique<Apply>(name, std::move(typeSExpr));
 }
 
-SExprRef Let::toSExpr() const {
+SExprRef Let::assembleSExpr(SExprVec operands) const {
     SExprVec defSExprs;
-    for (const auto &def : defs.assgns) {
+    for (size_t i = 0; i < defs.assgns.size(); ++i) {
         SExprVec argSExprs;
-        argSExprs.push_back(def.second->toSExpr());
-        defSExprs.push_back(
-            std::make_unique<Apply>(def.first, std::move(argSExprs)));
+        argSExprs.push_back(std::move(operands[i]));
+        defSExprs.push_back(std::make_unique<Apply>(defs.assgns[i].first,
+                                                    std::move(argSExprs)));
     }
     SExprVec args;
     args.push_back(std::make_unique<List>(std::move(defSExprs)));
-    args.push_back(expr->toSExpr());
+    args.push_back(std::move(operands.back()));
     return std::make_unique<Apply>("let", std::move(args));
 }
 
-SExprRef Op::toSExpr() const {
-    SExprVec argSExprs;
+SExprRef Op::assembleSExpr(SExprVec operands) const {
     // Special case for emty and
     if (opName == "and" && args.empty()) {
         return make_unique<Value>("true");
     }
     if (opName == "and" && args.size() == 1) {
-        return args.front()->toSExpr();
+        return std::move(operands.front());
     }
     if (opName == "=>" && args.at(1)->isConstantFalse()) {
-        return makeOp("not", args.at(0))->toSExpr();
-    }
-    for (auto &arg : args) {
-        argSExprs.push_back(arg->toSExpr());
+        operands.pop_back();
+        return std::make_unique<Apply>("not", std::move(operands));
     }
-    return std::make_unique<Apply>(opName, std::move(argSExprs));
+    return std::make_unique<Apply>(opName, std::move(operands));
 }
 
-SExprRef FunDecl::toSExpr() const {
+SExprRef FunDecl::assembleSExpr(SExprVec /* unused */) const {
     SExprVec inTypeSExprs;
     for (const auto &inType : inTypes) {
         inTypeSExprs.push_back(inType.toSExpr());
@@ -193,7 +217,7 @@ SExprRef FunDecl::toSExpr() const {
     return std::make_unique<Apply>(keyword, std::move(args));
 }
 
-SExprRef FunDef::toSExpr() const {
+SExprRef FunDef::assembleSExpr(SExprVec operands) const {
     SExprVec argSExprs;
     for (auto arg : args) {
         argSExprs.push_back(arg.toSExpr());
@@ -202,30 +226,27 @@ SExprRef FunDef::toSExpr() const {
     args.push_back(stringExpr(funName)->toSExpr());
     args.push_back(std::make_unique<List>(std::move(argSExprs)));
     args.push_back(outType.toSExpr());
-    args.push_back(body->toSExpr());
+    args.push_back(std::move(operands[0]));
     return std::make_unique<Apply>("define-fun", std::move(args));
 }
 
-SExprRef Comment::toSExpr() const {
+SExprRef Comment::assembleSExpr(SExprVec /* unused */) const {
     return make_unique<class sexpr::Comment>(val);
 }
 
-SExprRef VarDecl::toSExpr() const {
+SExprRef VarDecl::assembleSExpr(SExprVec /* unused */) const {
     SExprVec args;
     args.push_back(stringExpr(var.name)->toSExpr());
     args.push_back(var.type.toSExpr());
     return std::make_unique<Apply>("declare-var", std::move(args));
 }
 
-SExprRef FPCmp::toSExpr() const {
+SExprRef FPCmp::assembleSExpr(SExprVec args) const {
     if (SMTGenerationOpts::getInstance().BitVect) {
         logError("Floating point predicates for bitvectors are not yet "
                  "impleneted\n");
         exit(1);
     } else {
-        SExprVec args;
-        args.push_back(op0->toSExpr());
-        args.push_back(op1->toSExpr());
         switch (this->op) {
         case Predicate::False:
             return sexprFromString("false");
@@ -257,15 +278,12 @@ SExprRef FPCmp::toSExpr() const {
     }
 }
 
-SExprRef BinaryFPOperator::toSExpr() const {
+SExprRef BinaryFPOperator::assembleSExpr(SExprVec args) const {
     if (SMTGenerationOpts::getInstance().BitVect) {
         logError("Floating point binary operators for bitvectors are not yet "
                  "implemented\n");
         exit(1);
     } else {
-        SExprVec args;
-        args.push_back(op0->toSExpr());
-        args.push_back(op1->toSExpr());
         switch (this->op) {
         case Opcode::FAdd:
             return std::make_unique<Apply>("+", std::move(args));
@@ -282,7 +300,7 @@ SExprRef BinaryFPOperator::toSExpr() const {
     }
 }
 
-SExprRef TypeCast::toSExpr() const {
+SExprRef TypeCast::assembleSExpr(SExprVec args) const {
     // Extending 1bit integers (i.e. booleans) to integers is an SMT type
     // conversion and we have to deal with it separately
     if (destType.getTag() == TypeTag::Int && destType.unsafeBitWidth() > 1 &&
@@ -290,15 +308,13 @@ SExprRef TypeCast::toSExpr() const {
           sourceType.unsafeBitWidth() == 1) ||
          sourceType.getTag() == TypeTag::Bool)) {
         unsigned destBitWidth = destType.unsafeBitWidth();
-        vector<SharedSMTRef> args = {
-            operand,
-            std::make_unique<ConstantInt>(llvm::APInt(destBitWidth, 1)),
-            std::make_unique<ConstantInt>(llvm::APInt(destBitWidth, 0))};
-        return Op("ite", std::move(args)).toSExpr();
+        args.push_back(
+            ConstantInt(llvm::APInt(destBitWidth, 1)).assembleSExpr({}));
+        args.push_back(
+            ConstantInt(llvm::APInt(destBitWidth, 0)).assembleSExpr({}));
+        return std::make_unique<Apply>("ite", std::move(args));
     }
     if (SMTGenerationOpts::getInstance().BitVect) {
-        SExprVec args;
-        args.push_back(operand->toSExpr());
         switch (this->op) {
         case llvm::Instruction::Trunc: {
             unsigned bitWidth = destType.unsafeBitWidth();
@@ -326,14 +342,12 @@ SExprRef TypeCast::toSExpr() const {
             exit(1);
         }
     } else {
-        SExprVec args;
-        args.push_back(operand->toSExpr());
         switch (this->op) {
         case llvm::Instruction::SExt:
         case llvm::Instruction::ZExt:
         case llvm::Instruction::Trunc:
         case llvm::Instruction::BitCast:
-            return operand->toSExpr();
+            return std::move(args[0]);
         case llvm::Instruction::SIToFP:
             return std::make_unique<Apply>("to_real", std::move(args));
         default:
@@ -343,6 +357,207 @@ SExprRef TypeCast::toSExpr() const {
     }
 }
 
+// Implementations of writeSMTLib()
+
+void SMTLibSchedule::run(SExprWriter &writer) {
+    while (!items.empty()) {
+        Item item = items.back();
+        items.pop_back();
+        if (item.expr) {
+            size_t begin = items.size();
+            item.expr->scheduleSMTLib(writer, *this);
+            std::reverse(items.begin() + begin, items.end());
+        } else if (!item.head.empty()) {
+            writer.openApply(item.head, item.argCount);
+        } else {
+            writer.close();
+        }
+    }
+}
+
+void SMTExpr::writeSMTLib(SExprWriter &writer) const {
+    SMTLibSchedule schedule;
+    schedule.write(*this);
+    schedule.run(writer);
+}
+
+void SMTExpr::scheduleSMTLib(SExprWriter &writer,
+                             SMTLibSchedule & /* unused */) const {
+    writer.sexpr(*toSExpr());
+}
+
+void TypedVariable::scheduleSMTLib(SExprWriter &writer,
+                                   SMTLibSchedule & /* unused */) const {
+    writer.value(name);
+}
+
+void ConstantInt::scheduleSMTLib(SExprWriter &writer,
+                                 SMTLibSchedule &schedule) const {
+    if (SMTGenerationOpts::getInstance().BitVect) {
+        SMTExpr::scheduleSMTLib(writer, schedule);
+    } else if (value.isNegative()) {
+        writer.openApply("-", 1);
+        writer.value((-value).toString(10, true));
+        writer.close();
+    } else {
+        writer.value(value.toString(10, true));
+    }
+}
+
+void ConstantBool::scheduleSMTLib(SExprWriter &writer,
+                                  SMTLibSchedule & /* unused */) const {
+    writer.value(value ? "true" : "false");
+}
+
+void ConstantString::scheduleSMTLib(SExprWriter &writer,
+                                    SMTLibSchedule & /* unused */) const {
+    writer.value(value);
+}
+
+void SetLogic::scheduleSMTLib(SExprWriter &writer,
+                              SMTLibSchedule & /* unused */) const {
+    writer.openApply("set-logic", 1);
+    writer.value(logic);
+    writer.close();
+}
+
+void CheckSat::scheduleSMTLib(SExprWriter &writer,
+                              SMTLibSchedule & /* unused */) const {
+    writer.openApply("check-sat", 0);
+    writer.close();
+}
+
+void Query::scheduleSMTLib(SExprWriter &writer,
+                           SMTLibSchedule & /* unused */) const {
+    writer.openApply("query", 3);
+    writer.value(queryName);
+    writer.value(":print-certificate");
+    writer.value("true");
+    writer.close();
+}
+
+void GetModel::scheduleSMTLib(SExprWriter &writer,
+                              SMTLibSchedule & /* unused */) const {
+    writer.openApply("get-model", 0);
+    writer.close();
+}
+
+void Assert::scheduleSMTLib(SExprWriter &writer,
+                            SMTLibSchedule &schedule) const {
+    writer.openApply(SMTGenerationOpts::getInstance().OutputFormat ==
+                             SMTFormat::Z3
+                         ? "rule"
+                         : "assert",
+                     1);
+    schedule.write(*expr);
+    schedule.close();
+}
+
+void Forall::scheduleSMTLib(SExprWriter &writer,
+                            SMTLibSchedule &schedule) const {
+    if (vars.empty()) {
+        schedule.write(*expr);
+        return;
+    }
+    writer.openApply("forall", 2);
+    writer.openList();
+    for (const auto &sortedVar : vars) {
+        sortedVar.writeSMTLib(writer);
+    }
+    writer.close();
+    schedule.write(*expr);
+    schedule.close();
+}
+
+void SortedVar::writeSMTLib(SExprWriter &writer) const {
+    writer.openApply(name, 1);
+    writer.sexpr(*type.toSExpr());
+    writer.close();
+}
+
+void Let::scheduleSMTLib(SExprWriter &writer,
+                         SMTLibSchedule &schedule) const {
+    writer.openApply("let", 2);
+    writer.openList();
+    for (const auto &def : defs.assgns) {
+        schedule.openApply(def.first, 1);
+        schedule.write(*def.second);
+        schedule.close();
+    }
+    schedule.close();
+    schedule.write(*expr);
+    schedule.close();
+}
+
+void Op::scheduleSMTLib(SExprWriter &writer, SMTLibSchedule &schedule) const {
+    // Same special cases as in assembleSExpr
+    if (opName == "and" && args.empty()) {
+        writer.value("true");
+        return;
+    }
+    if (opName == "and" && args.size() == 1) {
+        schedule.write(*args.front());
+        return;
+    }
+    if (opName == "=>" && args.at(1)->isConstantFalse()) {
+        writer.openApply("not", 1);
+        schedule.write(*args.at(0));
+        schedule.close();
+        return;
+    }
+    writer.openApply(opName, args.size());
+    for (const auto &arg : args) {
+        schedule.write(*arg);
+    }
+    schedule.close();
+}
+
+void FunDecl::scheduleSMTLib(SExprWriter &writer,
+                             SMTLibSchedule & /* unused */) const {
+    const bool smtHorn =
+        SMTGenerationOpts::getInstance().OutputFormat == SMTFormat::SMTHorn;
+    const bool z3 =
+        SMTGenerationOpts::getInstance().OutputFormat == SMTFormat::Z3;
+    writer.openApply(z3 ? "declare-rel" : "declare-fun", smtHorn ? 3 : 2);
+    writer.value(funName);
+    writer.openList();
+    for (const auto &inType : inTypes) {
+        writer.sexpr(*inType.toSExpr());
+    }
+    writer.close();
+    if (smtHorn) {
+        writer.sexpr(*outType.toSExpr());
+    }
+    writer.close();
+}
+
+void FunDef::scheduleSMTLib(SExprWriter &writer,
+                            SMTLibSchedule &schedule) const {
+    writer.openApply("define-fun", 4);
+    writer.value(funName);
+    writer.openList();
+    for (const auto &arg : args) {
+        arg.writeSMTLib(writer);
+    }
+    writer.close();
+    writer.sexpr(*outType.toSExpr());
+    schedule.write(*body);
+    schedule.close();
+}
+
+void Comment::scheduleSMTLib(SExprWriter &writer,
+                            SMTLibSchedule & /* unused */) const {
+    writer.comment(val);
+}
+
+void VarDecl::scheduleSMTLib(SExprWriter &writer,
+                             SMTLibSchedule & /* unused */) const {
+    writer.openApply("declare-var", 2);
+    writer.value(var.name);
+    writer.sexpr(*var.type.toSExpr());
+    writer.close();
+}
+
 struct CollectUsesVisitor : SMTVisitor {
     llvm::StringSet<> uses;
     void dispatch(ConstantString &str) override { uses.insert(str.value); }
@@ -357,89 +572,292 @@ static llvm::StringSet<> collectUses(SMTExpr &expr) {
 
 // Implementations of mergeImplications
 
-SharedSMTRef SMTExpr::mergeImplications(std::vector<SharedSMTRef> conditions) {
-    if (conditions.empty()) {
-        return shared_from_this();
-    } else {
-        return makeOp("=>", make_shared<Op>("and", conditions),
-                      shared_from_this());
+SharedSMTRef SMTExpr::mergeImplications(vector<SharedSMTRef> conditions) {
+    // Binders between this expression and the innermost conclusion, they are
+    // rebuilt around the merged implication
+    vector<const SMTExpr *> binders;
+    SMTExpr *conclusion = this;
+    while (true) {
+        if (auto assertExpr = llvm::dyn_cast<Assert>(conclusion)) {
+            assert(conditions.empty());
+            binders.push_back(assertExpr);
+            conclusion = assertExpr->expr.get();
+        } else if (auto let = llvm::dyn_cast<Let>(conclusion)) {
+            binders.push_back(let);
+            conclusion = let->expr.get();
+        } else if (auto forall = llvm::dyn_cast<Forall>(conclusion)) {
+            binders.push_back(forall);
+            conclusion = forall->expr.get();
+        } else if (auto op = llvm::dyn_cast<Op>(conclusion)) {
+            if (op->opName != "=>") {
+                break;
+            }
+            assert(op->args.size() == 2);
+            conditions.push_back(op->args.at(0));
+            conclusion = op->args.at(1).get();
+        } else {
+            break;
+        }
     }
+    SharedSMTRef result = conclusion->shared_from_this();
+    // Other expressions than implications are only wrapped if there are
+    // conditions
+    if (!conditions.empty() || llvm::isa<Op>(conclusion)) {
+        result = makeOp("=>", make_shared<Op>("and", std::move(conditions)),
+                        std::move(result));
+    }
+    for (auto binder = binders.rbegin(); binder != binders.rend(); ++binder) {
+        if (auto let = llvm::dyn_cast<Let>(*binder)) {
+            result = make_shared<Let>(let->defs, std::move(result));
+        } else if (auto forall = llvm::dyn_cast<Forall>(*binder)) {
+            result = make_shared<Forall>(forall->vars, std::move(result));
+        } else {
+            result = make_shared<Assert>(std::move(result));
+        }
+    }
+    return result;
 }
 
-SharedSMTRef Assert::mergeImplications(std::vector<SharedSMTRef> conditions) {
-    assert(conditions.empty());
-    return make_shared<Assert>(expr->mergeImplications(std::move(conditions)));
+// Implementations of destructors
+
+void SMTExpr::releaseChild(SharedSMTRef &expr) {
+    // Expressions whose last reference is dropped while the outermost call
+    // is running are added to its list and destroyed in a loop
+    static thread_local vector<SharedSMTRef> *released = nullptr;
+    if (released) {
+        released->push_back(std::move(expr));
+        return;
+    }
+    vector<SharedSMTRef> pending;
+    pending.push_back(std::move(expr));
+    released = &pending;
+    while (!pending.empty()) {
+        SharedSMTRef next = std::move(pending.back());
+        pending.pop_back();
+        next.reset();
+    }
+    released = nullptr;
 }
 
-SharedSMTRef Let::mergeImplications(std::vector<SharedSMTRef> conditions) {
-    return make_shared<Let>(defs,
-                            expr->mergeImplications(std::move(conditions)));
+Assert::~Assert() { releaseChild(expr); }
+
+Forall::~Forall() { releaseChild(expr); }
+
+Let::~Let() {
+    for (auto &def : defs.assgns) {
+        releaseChild(def.second);
+    }
+    releaseChild(expr);
 }
 
-SharedSMTRef Op::mergeImplications(std::vector<SharedSMTRef> conditions) {
-    if (opName == "=>") {
-        assert(args.size() == 2);
-        conditions.push_back(args.at(0));
-        return args.at(1)->mergeImplications(std::move(conditions));
-    } else {
-        return makeOp("=>", make_shared<Op>("and", conditions),
-                      shared_from_this());
+Op::~Op() {
+    for (auto &arg : args) {
+        releaseChild(arg);
     }
 }
 
-SharedSMTRef Forall::mergeImplications(std::vector<SharedSMTRef> conditions) {
-    return std::make_shared<Forall>(
-        vars, expr->mergeImplications(std::move(conditions)));
+FPCmp::~FPCmp() {
+    releaseChild(op0);
+    releaseChild(op1);
 }
 
-// Implementations of splitConjunctions()
+BinaryFPOperator::~BinaryFPOperator() {
+    releaseChild(op0);
+    releaseChild(op1);
+}
 
-vector<SharedSMTRef> SMTExpr::splitConjunctions() {
-    return {shared_from_this()};
+TypeCast::~TypeCast() { releaseChild(operand); }
+
+FunDef::~FunDef() { releaseChild(body); }
+
+// Implementations of children() and withChildren()
+
+vector<SharedSMTRef> SMTExpr::children() const {
+    vector<SharedSMTRef> result;
+    for (size_t i = 0; i < childCount(); ++i) {
+        result.push_back(child(i));
+    }
+    return result;
+}
+
+const SharedSMTRef &SMTExpr::child(size_t /* unused */) const {
+    logError("Expression has no children\n");
+    exit(1);
+}
+
+SharedSMTRef SMTExpr::withChildren(vector<SharedSMTRef> newChildren) {
+    assert(newChildren.empty());
+    return shared_from_this();
+}
+
+size_t Assert::childCount() const { return 1; }
+
+const SharedSMTRef &Assert::child(size_t index) const {
+    assert(index == 0);
+    return expr;
+}
+
+SharedSMTRef Assert::withChildren(vector<SharedSMTRef> newChildren) {
+    assert(newChildren.size() == 1);
+    return make_shared<Assert>(std::move(newChildren[0]));
+}
+
+size_t Forall::childCount() const { return 1; }
+
+const SharedSMTRef &Forall::child(size_t index) const {
+    assert(index == 0);
+    return expr;
+}
+
+SharedSMTRef Forall::withChildren(vector<SharedSMTRef> newChildren) {
+    assert(newChildren.size() == 1);
+    return make_shared<Forall>(vars, std::move(newChildren[0]));
 }
 
-vector<SharedSMTRef> Assert::splitConjunctions() {
-    vector<SharedSMTRef> smtExprs = expr->splitConjunctions();
-    for (auto &expr : smtExprs) {
-        expr = make_shared<Assert>(std::move(expr));
+size_t Let::childCount() const { return defs.assgns.size() + 1; }
+
+const SharedSMTRef &Let::child(size_t index) const {
+    if (index < defs.assgns.size()) {
+        return defs.assgns[index].second;
     }
-    return smtExprs;
+    assert(index == defs.assgns.size());
+    return expr;
 }
 
-vector<SharedSMTRef> Let::splitConjunctions() {
-    vector<SharedSMTRef> smtExprs = expr->splitConjunctions();
-    for (auto &expr : smtExprs) {
-        expr = make_shared<Let>(defs, std::move(expr));
+SharedSMTRef Let::withChildren(vector<SharedSMTRef> newChildren) {
+    assert(newChildren.size() == defs.assgns.size() + 1);
+    AssignmentGroup newDefs;
+    for (size_t i = 0; i < defs.assgns.size(); ++i) {
+        newDefs.assgns.push_back(
+            {defs.assgns[i].first, std::move(newChildren[i])});
     }
-    return smtExprs;
+    return make_shared<Let>(std::move(newDefs),
+                            std::move(newChildren.back()));
+}
+
+size_t Op::childCount() const { return args.size(); }
+
+const SharedSMTRef &Op::child(size_t index) const { return args.at(index); }
+
+SharedSMTRef Op::withChildren(vector<SharedSMTRef> newChildren) {
+    assert(newChildren.size() == args.size());
+    return make_shared<Op>(opName, std::move(newChildren), instantiate);
+}
+
+size_t FPCmp::childCount() const { return 2; }
+
+const SharedSMTRef &FPCmp::child(size_t index) const {
+    assert(index < 2);
+    return index == 0 ? op0 : op1;
+}
+
+SharedSMTRef FPCmp::withChildren(vector<SharedSMTRef> newChildren) {
+    assert(newChildren.size() == 2);
+    return make_shared<FPCmp>(op, type, std::move(newChildren[0]),
+                              std::move(newChildren[1]));
+}
+
+size_t BinaryFPOperator::childCount() const { return 2; }
+
+const SharedSMTRef &BinaryFPOperator::child(size_t index) const {
+    assert(index < 2);
+    return index == 0 ? op0 : op1;
 }
 
-vector<SharedSMTRef> Op::splitConjunctions() {
-    if (opName == "=>") {
-        assert(args.size() == 2);
-        vector<SharedSMTRef> smtExprs = args.at(1)->splitConjunctions();
-        for (auto &expr : smtExprs) {
-            expr = makeOp("=>", args.at(0), std::move(expr));
+SharedSMTRef BinaryFPOperator::withChildren(vector<SharedSMTRef> newChildren) {
+    assert(newChildren.size() == 2);
+    return make_shared<BinaryFPOperator>(op, type, std::move(newChildren[0]),
+                                         std::move(newChildren[1]));
+}
+
+size_t TypeCast::childCount() const { return 1; }
+
+const SharedSMTRef &TypeCast::child(size_t index) const {
+    assert(index == 0);
+    return operand;
+}
+
+SharedSMTRef TypeCast::withChildren(vector<SharedSMTRef> newChildren) {
+    assert(newChildren.size() == 1);
+    return make_shared<TypeCast>(op, sourceType, destType,
+                                 std::move(newChildren[0]));
+}
+
+size_t FunDef::childCount() const { return 1; }
+
+const SharedSMTRef &FunDef::child(size_t index) const {
+    assert(index == 0);
+    return body;
+}
+
+SharedSMTRef FunDef::withChildren(vector<SharedSMTRef> newChildren) {
+    assert(newChildren.size() == 1);
+    return make_shared<FunDef>(funName, args, outType,
+                               std::move(newChildren[0]));
+}
+
+// Implementations of splitConjunctions()
+
+// Conjunctions are split below asserts, lets, quantifiers and in the
+// conclusions of implications
+struct SplitConjunctionsPass : PostOrderPass<vector<SharedSMTRef>> {
+    static bool isSplit(const SMTExpr &expr) {
+        if (auto op = llvm::dyn_cast<Op>(&expr)) {
+            return op->opName == "=>" || op->opName == "and";
         }
-        return smtExprs;
-    } else if (opName == "and") {
-        vector<SharedSMTRef> smtExprs;
-        for (const auto &expr : args) {
-            vector<SharedSMTRef> exprs = expr->splitConjunctions();
-            smtExprs.insert(smtExprs.end(), exprs.begin(), exprs.end());
+        return llvm::isa<Assert>(expr) || llvm::isa<Let>(expr) ||
+               llvm::isa<Forall>(expr);
+    }
+    auto traversedChildren(const SMTExpr &expr) -> std::pair<size_t, size_t> {
+        // Only the body of a let and the conclusion of an implication
+        if (llvm::isa<Let>(expr)) {
+            return {expr.childCount() - 1, expr.childCount()};
+        }
+        if (auto op = llvm::dyn_cast<Op>(&expr)) {
+            if (op->opName == "=>") {
+                assert(op->args.size() == 2);
+                return {1, 2};
+            }
+        }
+        return {0, expr.childCount()};
+    }
+    auto enter(SMTExpr &expr) -> llvm::Optional<vector<SharedSMTRef>> {
+        if (!isSplit(expr)) {
+            return vector<SharedSMTRef>{expr.shared_from_this()};
+        }
+        return llvm::None;
+    }
+    auto leave(SMTExpr &expr, vector<vector<SharedSMTRef>> results)
+        -> vector<SharedSMTRef> {
+        if (auto op = llvm::dyn_cast<Op>(&expr)) {
+            if (op->opName == "and") {
+                vector<SharedSMTRef> smtExprs;
+                for (auto &exprs : results) {
+                    smtExprs.insert(smtExprs.end(), exprs.begin(),
+                                    exprs.end());
+                }
+                return smtExprs;
+            }
+        }
+        vector<SharedSMTRef> smtExprs = std::move(results.at(0));
+        for (auto &smtExpr : smtExprs) {
+            if (auto op = llvm::dyn_cast<Op>(&expr)) {
+                smtExpr = makeOp("=>", op->args.at(0), std::move(smtExpr));
+            } else if (auto let = llvm::dyn_cast<Let>(&expr)) {
+                smtExpr = make_shared<Let>(let->defs, std::move(smtExpr));
+            } else if (auto forall = llvm::dyn_cast<Forall>(&expr)) {
+                smtExpr = make_shared<Forall>(forall->vars, std::move(smtExpr));
+            } else {
+                smtExpr = make_shared<Assert>(std::move(smtExpr));
+            }
         }
         return smtExprs;
-    } else {
-        return {shared_from_this()};
     }
-}
+};
 
-vector<SharedSMTRef> Forall::splitConjunctions() {
-    vector<SharedSMTRef> smtExprs = expr->splitConjunctions();
-    for (auto &expr : smtExprs) {
-        expr = make_shared<Forall>(vars, std::move(expr));
-    }
-    return smtExprs;
+vector<SharedSMTRef> SMTExpr::splitConjunctions() {
+    SplitConjunctionsPass pass;
+    return traversePostOrder(*this, pass);
 }
 
 // Implementations of heapInfo
@@ -448,7 +866,7 @@ unique_ptr<const HeapInfo> SMTExpr::heapInfo() const { return nullptr; }
 
 unique_ptr<const HeapInfo> TypedVariable::heapInfo() const {
     std::smatch matchResult;
-    if (std::regex_match(name, matchResult, HEAP_REGEX)) {
+    if (std::regex_match(name.str(), matchResult, HEAP_REGEX)) {
         // The actual match counts too
         assert(matchResult.size() == 3 || matchResult.size() == 4);
         return make_unique<HeapInfo>(matchResult[1], matchResult[2],
@@ -459,150 +877,420 @@ unique_ptr<const HeapInfo> TypedVariable::heapInfo() const {
 
 // Implementations of inlineLets
 
-SharedSMTRef SMTExpr::inlineLets(map<string, SharedSMTRef> assignments) {
-    return shared_from_this();
+SharedSMTRef LetInliner::inlineLets(SMTExpr &expr) {
+    struct InlinePass : PostOrderPass<SharedSMTRef> {
+        LetInliner &inliner;
+        explicit InlinePass(LetInliner &inliner) : inliner(inliner) {}
+        auto key(const SMTExpr &expr) const -> MemoKey {
+            return {&expr, inliner.scopes.back().id};
+        }
+        auto enter(SMTExpr &expr) -> llvm::Optional<SharedSMTRef> {
+            switch (expr.getKind()) {
+            case SMTExprKind::TypedVariable:
+                if (auto bound = inliner.lookup(
+                        llvm::cast<TypedVariable>(expr).name)) {
+                    return bound;
+                }
+                return expr.shared_from_this();
+            case SMTExprKind::ConstantString:
+                if (auto bound = inliner.lookup(
+                        llvm::cast<ConstantString>(expr).value)) {
+                    return bound;
+                }
+                return expr.shared_from_this();
+            case SMTExprKind::Assert:
+            case SMTExprKind::Let:
+            case SMTExprKind::Forall:
+            case SMTExprKind::Op:
+            case SMTExprKind::TypeCast:
+            case SMTExprKind::BinaryFPOperator:
+            case SMTExprKind::FPCmp: {
+                auto memoIt = inliner.memo.find(key(expr));
+                if (memoIt != inliner.memo.end()) {
+                    return memoIt->second;
+                }
+                return llvm::None;
+            }
+            default:
+                return expr.shared_from_this();
+            }
+        }
+        void beforeChild(const SMTExpr &expr, size_t index,
+                         llvm::ArrayRef<SharedSMTRef> results) {
+            if (auto let = llvm::dyn_cast<Let>(&expr)) {
+                // The bindings of a single let are independent of each
+                // other so they are all evaluated in the outer scope
+                if (index == let->defs.assgns.size()) {
+                    inliner.enterScope();
+                    for (size_t i = 0; i < let->defs.assgns.size(); ++i) {
+                        inliner.bind(let->defs.assgns[i].first, results[i]);
+                    }
+                }
+            } else if (auto forall = llvm::dyn_cast<Forall>(&expr)) {
+                inliner.enterScope();
+                for (const auto &var : forall->vars) {
+                    inliner.shadow(var.name);
+                }
+            }
+        }
+        auto leave(SMTExpr &expr, vector<SharedSMTRef> results)
+            -> SharedSMTRef {
+            SharedSMTRef result;
+            switch (expr.getKind()) {
+            case SMTExprKind::Let:
+                inliner.exitScope();
+                result = std::move(results.back());
+                break;
+            case SMTExprKind::Forall:
+                inliner.exitScope();
+                result = make_shared<Forall>(llvm::cast<Forall>(expr).vars,
+                                             std::move(results.at(0)));
+                break;
+            case SMTExprKind::Op: {
+                const auto &op = llvm::cast<Op>(expr);
+                bool changed = !op.instantiate;
+                for (size_t i = 0; i < results.size(); ++i) {
+                    changed |= results[i] != op.args[i];
+                }
+                // Inlining has always produced an Op with the default value
+                // of instantiate so only reuse nodes where that makes no
+                // difference
+                result = changed
+                             ? make_shared<Op>(op.opName, std::move(results))
+                             : expr.shared_from_this();
+                break;
+            }
+            default:
+                result = expr.withChildren(std::move(results));
+            }
+            // Scopes opened by this expression have been left again
+            inliner.memo.insert({key(expr), result});
+            return result;
+        }
+    };
+    InlinePass pass(*this);
+    return traversePostOrder(expr, pass);
 }
 
-SharedSMTRef Assert::inlineLets(map<string, SharedSMTRef> assignments) {
-    return make_unique<Assert>(expr->inlineLets(assignments));
+SharedSMTRef LetInliner::lookup(const Symbol &name) const {
+    auto it = bindings.find(name);
+    if (it == bindings.end() || it->second.empty()) {
+        return nullptr;
+    }
+    return it->second.back();
 }
 
-SharedSMTRef Let::inlineLets(map<string, SharedSMTRef> assignments) {
-    map<string, SharedSMTRef> oldAssignments = assignments;
-    for (const auto &def : defs.assgns) {
-        assignments[def.first] = def.second->inlineLets(oldAssignments);
-    }
-    return expr->inlineLets(assignments);
+void LetInliner::enterScope() {
+    scopes.push_back({nextScopeId++, boundNames.size()});
 }
 
-SharedSMTRef Forall::inlineLets(map<string, SharedSMTRef> assignments) {
-    for (const auto &var : vars) {
-        assignments.erase(var.name);
+void LetInliner::exitScope() {
+    assert(scopes.size() > 1);
+    for (size_t i = scopes.back().boundNamesBegin; i < boundNames.size();
+         ++i) {
+        bindings[boundNames[i]].pop_back();
     }
-    return make_unique<Forall>(vars, expr->inlineLets(assignments));
+    boundNames.resize(scopes.back().boundNamesBegin);
+    scopes.pop_back();
 }
 
-SharedSMTRef Op::inlineLets(map<string, SharedSMTRef> assignments) {
-    vector<SharedSMTRef> newArgs;
-    for (const auto &arg : args) {
-        newArgs.push_back(arg->inlineLets(assignments));
-    }
-    return make_unique<Op>(opName, newArgs);
+void LetInliner::bind(const Symbol &name, SharedSMTRef value) {
+    bindings[name].push_back(std::move(value));
+    boundNames.push_back(name);
 }
 
-SharedSMTRef TypedVariable::inlineLets(map<string, SharedSMTRef> assignments) {
-    auto mapIt = assignments.find(name);
-    if (mapIt == assignments.end()) {
-        return shared_from_this();
-    }
-    return mapIt->second;
+SharedSMTRef SMTExpr::inlineLets() {
+    LetInliner inliner;
+    return inliner.inlineLets(*this);
 }
 
-SharedSMTRef ConstantString::inlineLets(map<string, SharedSMTRef> assignments) {
-    auto mapIt = assignments.find(value);
-    if (mapIt == assignments.end()) {
-        return shared_from_this();
+// Implementations for using the z3 API
+
+static z3::sort z3Sort(z3::context &cxt, const Type &type) {
+    switch (type.getTag()) {
+    case TypeTag::Int:
+        return cxt.int_sort();
+    case TypeTag::Bool:
+        return cxt.bool_sort();
+    case TypeTag::Array:
+        return cxt.array_sort(cxt.int_sort(), cxt.int_sort());
+    default:
+        std::cerr << "Unsupported type: " << *type.toSExpr() << "\n";
+        exit(1);
     }
-    return mapIt->second;
 }
 
-SharedSMTRef TypeCast::inlineLets(map<string, SharedSMTRef> assignments) {
-    return std::make_unique<TypeCast>(op, sourceType, destType,
-                                      operand->inlineLets(assignments));
+// Returns true if name was bound to a different expression before
+static bool bindName(llvm::StringMap<z3::expr> &nameMap, llvm::StringRef name,
+                     z3::expr e) {
+    auto it = nameMap.insert({name, e});
+    if (!it.second) {
+        bool shadowed = !z3::eq(it.first->second, e);
+        it.first->second = e;
+        return shadowed;
+    }
+    return false;
 }
 
-SharedSMTRef
-BinaryFPOperator::inlineLets(map<string, SharedSMTRef> assignments) {
-    return make_unique<BinaryFPOperator>(op, type, op0->inlineLets(assignments),
-                                         op1->inlineLets(assignments));
-}
+auto Z3TranslationCache::lookup(const SMTExpr &expr) const
+    -> const z3::expr * {
+    auto it = translations.find({&expr, scope});
+    if (it == translations.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+void Z3TranslationCache::insert(const SMTExpr &expr, z3::expr translation) {
+    translations.emplace(Key(&expr, scope), std::move(translation));
+}
+
+auto Z3TranslationCache::enterScope() -> unsigned {
+    unsigned previousScope = scope;
+    scope = nextScope++;
+    return previousScope;
+}
+
+void Z3TranslationCache::exitScope(unsigned previousScope) {
+    scope = previousScope;
+}
+
+void Z3TranslationCache::clear() { translations.clear(); }
+
+// Lets and quantifiers bind their names in nameMap before their bodies are
+// translated and restore the previous bindings afterwards
+struct Z3TranslationPass : PostOrderPass<z3::expr> {
+    z3::context &cxt;
+    llvm::StringMap<z3::expr> &nameMap;
+    const llvm::StringMap<Z3DefineFun> &defineFunMap;
+    Z3TranslationCache &cache;
+    // Scopes to return to when leaving a let or quantifier
+    vector<llvm::Optional<unsigned>> previousScopes;
+    // Bindings replaced by each enclosing let or quantifier, None if the name
+    // was not bound before
+    vector<vector<std::pair<string, llvm::Optional<z3::expr>>>> savedBindings;
+    Z3TranslationPass(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                      const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                      Z3TranslationCache &cache)
+        : cxt(cxt), nameMap(nameMap), defineFunMap(defineFunMap),
+          cache(cache) {}
+    static bool isCached(const SMTExpr &expr) {
+        switch (expr.getKind()) {
+        case SMTExprKind::Op:
+        case SMTExprKind::Let:
+        case SMTExprKind::Forall:
+        case SMTExprKind::FPCmp:
+        case SMTExprKind::BinaryFPOperator:
+        case SMTExprKind::TypeCast:
+            return true;
+        default:
+            // Leaves are cheaper to translate than to look up
+            return false;
+        }
+    }
+    bool bind(llvm::StringRef name, z3::expr e) {
+        auto it = nameMap.find(name);
+        savedBindings.back().emplace_back(
+            name.str(), it == nameMap.end() ? llvm::Optional<z3::expr>()
+                                            : it->second);
+        return bindName(nameMap, name, e);
+    }
+    void restoreBindings() {
+        const auto &saved = savedBindings.back();
+        for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+            if (it->second) {
+                bindName(nameMap, it->first, *it->second);
+            } else {
+                nameMap.erase(it->first);
+            }
+        }
+        savedBindings.pop_back();
+    }
+    auto enter(const SMTExpr &expr) -> llvm::Optional<z3::expr> {
+        if (!isCached(expr)) {
+            return expr.translateToZ3(cxt, nameMap, defineFunMap, {});
+        }
+        if (const z3::expr *cached = cache.lookup(expr)) {
+            return *cached;
+        }
+        return llvm::None;
+    }
+    void beforeChild(const SMTExpr &expr, size_t index,
+                     llvm::ArrayRef<z3::expr> results) {
+        if (auto let = llvm::dyn_cast<Let>(&expr)) {
+            // The bindings of a single let are parallel so all definitions
+            // have to be translated before any of them is visible
+            if (index == let->defs.assgns.size()) {
+                previousScopes.push_back(cache.enterScope());
+                savedBindings.emplace_back();
+                for (size_t i = 0; i < let->defs.assgns.size(); ++i) {
+                    bind(let->defs.assgns[i].first, results[i]);
+                }
+            }
+        } else if (auto forall = llvm::dyn_cast<Forall>(&expr)) {
+            bool shadowed = false;
+            savedBindings.emplace_back();
+            for (const auto &var : forall->vars) {
+                z3::expr c = cxt.constant(var.name.str().c_str(),
+                                          z3Sort(cxt, var.type));
+                shadowed = bind(var.name, c) || shadowed;
+            }
+            // Constants are identified by their name and sort, so
+            // translations can be shared with other quantifiers unless a
+            // different binding is shadowed
+            previousScopes.push_back(shadowed
+                                         ? cache.enterScope()
+                                         : llvm::Optional<unsigned>());
+        }
+    }
+    auto leave(const SMTExpr &expr, vector<z3::expr> results) -> z3::expr {
+        if (llvm::isa<Let>(expr) || llvm::isa<Forall>(expr)) {
+            if (previousScopes.back()) {
+                cache.exitScope(*previousScopes.back());
+            }
+            previousScopes.pop_back();
+            restoreBindings();
+        }
+        z3::expr translation =
+            expr.translateToZ3(cxt, nameMap, defineFunMap, results);
+        cache.insert(expr, translation);
+        return translation;
+    }
+};
 
-SharedSMTRef FPCmp::inlineLets(map<string, SharedSMTRef> assignments) {
-    return make_unique<FPCmp>(op, type, op0->inlineLets(assignments),
-                              op1->inlineLets(assignments));
+auto SMTExpr::toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
+                       const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                       Z3TranslationCache &cache) const -> z3::expr {
+    Z3TranslationPass pass(cxt, nameMap, defineFunMap, cache);
+    return traversePostOrder(*this, pass);
 }
 
-// Implementations for using the z3 API
-
 void VarDecl::toZ3(z3::context &cxt, z3::solver & /* unused */,
                    llvm::StringMap<z3::expr> &nameMap,
-                   llvm::StringMap<Z3DefineFun> & /* unused */) const {
+                   llvm::StringMap<Z3DefineFun> & /* unused */,
+                   Z3TranslationCache &cache) const {
+    bool shadowed = false;
     if (var.type.getTag() == TypeTag::Int) {
-        z3::expr c = cxt.int_const(var.name.c_str());
-        auto it = nameMap.insert({var.name, c});
-        if (!it.second) {
-            it.first->second = c;
-        }
+        z3::expr c = cxt.int_const(var.name.str().c_str());
+        shadowed = bindName(nameMap, var.name, c);
     } else if (var.type.getTag() == TypeTag::Array) {
         z3::sort intArraySort = cxt.array_sort(cxt.int_sort(), cxt.int_sort());
-        z3::expr c = cxt.constant(var.name.c_str(), intArraySort);
-        auto it = nameMap.insert({var.name, c});
-        if (!it.second) {
-            it.first->second = c;
-        }
+        z3::expr c = cxt.constant(var.name.str().c_str(), intArraySort);
+        shadowed = bindName(nameMap, var.name, c);
     } else if (var.type.getTag() == TypeTag::Bool) {
-        z3::expr c = cxt.bool_const(var.name.c_str());
-        auto it = nameMap.insert({var.name, c});
-        if (!it.second) {
-            it.first->second = c;
-        }
+        z3::expr c = cxt.bool_const(var.name.str().c_str());
+        shadowed = bindName(nameMap, var.name, c);
     } else {
         logError("Unsupported type\n");
         exit(1);
     }
+    if (shadowed) {
+        // Cached translations might refer to the previous declaration
+        cache.clear();
+    }
 }
 
 void Assert::toZ3(z3::context &cxt, z3::solver &solver,
                   llvm::StringMap<z3::expr> &nameMap,
-                  llvm::StringMap<Z3DefineFun> &defineFunMap) const {
-    solver.add(expr->toZ3Expr(cxt, nameMap, defineFunMap));
+                  llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  Z3TranslationCache &cache) const {
+    solver.add(expr->toZ3Expr(cxt, nameMap, defineFunMap, cache));
+}
+
+void SetLogic::toZ3(z3::context & /* unused */, z3::solver & /* unused */,
+                    llvm::StringMap<z3::expr> & /* unused */,
+                    llvm::StringMap<Z3DefineFun> & /* unused */,
+                    Z3TranslationCache & /* unused */) const {
+    /* noop, the logic is determined by the solver */
+}
+
+void Comment::toZ3(z3::context & /* unused */, z3::solver & /* unused */,
+                   llvm::StringMap<z3::expr> & /* unused */,
+                   llvm::StringMap<Z3DefineFun> & /* unused */,
+                   Z3TranslationCache & /* unused */) const {
+    /* noop */
+}
+
+// Uninterpreted functions are stored as a definition whose body is the
+// application of the declared function to fresh constants. Substituting the
+// arguments in Op::translateToZ3 then produces the application we want.
+void FunDecl::toZ3(z3::context &cxt, z3::solver & /* unused */,
+                   llvm::StringMap<z3::expr> & /* unused */,
+                   llvm::StringMap<Z3DefineFun> &defineFunMap,
+                   Z3TranslationCache & /* unused */) const {
+    z3::sort_vector domain(cxt);
+    z3::expr_vector vars(cxt);
+    for (size_t i = 0; i < inTypes.size(); ++i) {
+        z3::sort sort = z3Sort(cxt, inTypes[i]);
+        domain.push_back(sort);
+        vars.push_back(cxt.constant(
+            (funName + "$arg" + std::to_string(i)).c_str(), sort));
+    }
+    z3::func_decl decl =
+        cxt.function(funName.str().c_str(), domain, z3Sort(cxt, outType));
+    auto it = defineFunMap.insert({funName, {vars, decl(vars)}});
+    if (!it.second) {
+        logError("Function " + funName + " declared twice\n");
+        exit(1);
+    }
 }
 
 void CheckSat::toZ3(z3::context & /* unused */, z3::solver & /* unused */,
                     llvm::StringMap<z3::expr> & /* unused */,
-                    llvm::StringMap<Z3DefineFun> & /* unused */) const {
+                    llvm::StringMap<Z3DefineFun> & /* unused */,
+                    Z3TranslationCache & /* unused */) const {
     /* noop */
 }
 
 void GetModel::toZ3(z3::context & /* unused */, z3::solver & /* unused */,
                     llvm::StringMap<z3::expr> & /* unused */,
-                    llvm::StringMap<Z3DefineFun> & /* unused */) const {
+                    llvm::StringMap<Z3DefineFun> & /* unused */,
+                    Z3TranslationCache & /* unused */) const {
     /* noop */
 }
 
 void SMTExpr::toZ3(z3::context & /* unused */, z3::solver & /* unused */,
                    llvm::StringMap<z3::expr> & /* unused */,
-                   llvm::StringMap<Z3DefineFun> &
-                   /* unused */) const {
+                   llvm::StringMap<Z3DefineFun> & /* unused */,
+                   Z3TranslationCache & /* unused */) const {
     logError("Unsupported smt toplevel\n");
     std::cerr << *toSExpr();
     exit(1);
 }
 
 z3::expr
-SMTExpr::toZ3Expr(z3::context & /* unused */,
-                  llvm::StringMap<z3::expr> & /* unused */,
-                  const llvm::StringMap<Z3DefineFun> & /* unused */) const {
+SMTExpr::translateToZ3(z3::context & /* unused */,
+                       llvm::StringMap<z3::expr> & /* unused */,
+                       const llvm::StringMap<Z3DefineFun> & /* unused */,
+                       llvm::ArrayRef<z3::expr> /* unused */) const {
     logError("Unsupported smtexpr\n");
     std::cerr << *toSExpr();
     exit(1);
 }
 
-z3::expr TypeCast::toZ3Expr(z3::context &cxt,
-                            llvm::StringMap<z3::expr> &nameMap,
-                            const llvm::StringMap<Z3DefineFun> &funMap) const {
+z3::expr
+TypeCast::translateToZ3(z3::context &cxt,
+                        llvm::StringMap<z3::expr> & /* unused */,
+                        const llvm::StringMap<Z3DefineFun> & /* unused */,
+                        llvm::ArrayRef<z3::expr> operands) const {
     if (SMTGenerationOpts::getInstance().BitVect) {
         logError("Bitvector mode not implemented for using the Z3 API for "
                  "typecasts\n");
         exit(1);
     } else {
-        return operand->toZ3Expr(cxt, nameMap, funMap);
+        z3::expr e = operands[0];
+        // Mirrors the ite in toSExpr for extending booleans to integers
+        if (destType.getTag() == TypeTag::Int && e.is_bool()) {
+            return z3::ite(e, cxt.int_val(1), cxt.int_val(0));
+        }
+        return e;
     }
 }
 
-z3::expr TypedVariable::toZ3Expr(
+z3::expr TypedVariable::translateToZ3(
     z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-    const llvm::StringMap<Z3DefineFun> & /* unused */) const {
+    const llvm::StringMap<Z3DefineFun> & /* unused */,
+    llvm::ArrayRef<z3::expr> /* unused */) const {
     if (nameMap.count(name) == 0) {
         std::cerr << "Z3 serialization error: '" << name
                   << "' not in variable map\n";
@@ -612,9 +1300,19 @@ z3::expr TypedVariable::toZ3Expr(
     }
 }
 
-z3::expr ConstantString::toZ3Expr(
+z3::expr ConstantString::translateToZ3(
     z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-    const llvm::StringMap<Z3DefineFun> & /* unused */) const {
+    const llvm::StringMap<Z3DefineFun> & /* unused */,
+    llvm::ArrayRef<z3::expr> /* unused */) const {
+    // Numerals are sometimes constructed as strings
+    if (!value.empty() &&
+        std::all_of(value.begin(), value.end(),
+                    [](char c) { return c >= '0' && c <= '9'; })) {
+        return cxt.int_val(value.c_str());
+    }
+    if (value == "true" || value == "false") {
+        return cxt.bool_val(value == "true");
+    }
     if (nameMap.count(value) == 0) {
         std::cerr << "Z3 serialization error: '" << value
                   << "' not in variable map\n";
@@ -624,16 +1322,18 @@ z3::expr ConstantString::toZ3Expr(
     }
 }
 
-z3::expr ConstantBool::toZ3Expr(
+z3::expr ConstantBool::translateToZ3(
     z3::context &cxt, llvm::StringMap<z3::expr> & /* unused */,
-    const llvm::StringMap<Z3DefineFun> & /* unused */) const {
+    const llvm::StringMap<Z3DefineFun> & /* unused */,
+    llvm::ArrayRef<z3::expr> /* unused */) const {
     return cxt.bool_val(value);
 }
 
 z3::expr
-ConstantInt::toZ3Expr(z3::context &cxt,
-                      llvm::StringMap<z3::expr> & /* unused */,
-                      const llvm::StringMap<Z3DefineFun> & /* unused */) const {
+ConstantInt::translateToZ3(z3::context &cxt,
+                           llvm::StringMap<z3::expr> & /* unused */,
+                           const llvm::StringMap<Z3DefineFun> & /* unused */,
+                           llvm::ArrayRef<z3::expr> /* unused */) const {
     if (SMTGenerationOpts::getInstance().BitVect) {
         logError("Bitvector serialization for z3 is not yet implemented\n");
         exit(1);
@@ -642,81 +1342,89 @@ ConstantInt::toZ3Expr(z3::context &cxt,
     }
 }
 
-z3::expr Let::toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-                       const llvm::StringMap<Z3DefineFun> &defineFunMap) const {
-    for (const auto &assgn : defs.assgns) {
-        auto e = assgn.second->toZ3Expr(cxt, nameMap, defineFunMap);
-        auto it = nameMap.insert({assgn.first, e});
-        if (!it.second) {
-            it.first->second = e;
-        }
+z3::expr Let::translateToZ3(z3::context & /* unused */,
+                            llvm::StringMap<z3::expr> & /* unused */,
+                            const llvm::StringMap<Z3DefineFun> & /* unused */,
+                            llvm::ArrayRef<z3::expr> operands) const {
+    // The definitions have been bound while translating the body
+    return operands.back();
+}
+
+z3::expr
+Forall::translateToZ3(z3::context &cxt,
+                      llvm::StringMap<z3::expr> & /* unused */,
+                      const llvm::StringMap<Z3DefineFun> & /* unused */,
+                      llvm::ArrayRef<z3::expr> operands) const {
+    if (vars.empty()) {
+        return operands[0];
+    }
+    z3::expr_vector boundVars(cxt);
+    for (const auto &var : vars) {
+        boundVars.push_back(
+            cxt.constant(var.name.str().c_str(), z3Sort(cxt, var.type)));
     }
-    return expr->toZ3Expr(cxt, nameMap, defineFunMap);
+    return z3::forall(boundVars, operands[0]);
 }
 
-z3::expr Op::toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
-                      const llvm::StringMap<Z3DefineFun> &defineFunMap) const {
+z3::expr Op::translateToZ3(z3::context &cxt,
+                           llvm::StringMap<z3::expr> & /* unused */,
+                           const llvm::StringMap<Z3DefineFun> &defineFunMap,
+                           llvm::ArrayRef<z3::expr> operands) const {
     if (defineFunMap.count(opName) > 0) {
         auto fun = defineFunMap.find(opName)->second;
         z3::expr_vector src = fun.vars;
         z3::expr_vector dst(cxt);
-        for (const auto &arg : args) {
-            dst.push_back(arg->toZ3Expr(cxt, nameMap, defineFunMap));
+        for (const auto &operand : operands) {
+            dst.push_back(operand);
         }
         assert(src.size() == dst.size());
         return fun.e.substitute(src, dst);
     } else {
-        if (opName == "and") {
-            z3::expr result =
-                args.front()->toZ3Expr(cxt, nameMap, defineFunMap);
+        if (opName == "and" && args.empty()) {
+            return cxt.bool_val(true);
+        } else if (opName == "or" && args.empty()) {
+            return cxt.bool_val(false);
+        } else if (opName == "and") {
+            z3::expr result = operands.front();
             for (size_t i = 1; i < args.size(); ++i) {
-                result =
-                    result && args.at(i)->toZ3Expr(cxt, nameMap, defineFunMap);
+                result = result && operands[i];
             }
             return result;
         } else if (opName == "or") {
-            z3::expr result =
-                args.front()->toZ3Expr(cxt, nameMap, defineFunMap);
+            z3::expr result = operands.front();
             for (size_t i = 1; i < args.size(); ++i) {
-                result =
-                    result || args.at(i)->toZ3Expr(cxt, nameMap, defineFunMap);
+                result = result || operands[i];
             }
             return result;
         } else if (opName == "+") {
-            z3::expr result =
-                args.front()->toZ3Expr(cxt, nameMap, defineFunMap);
+            z3::expr result = operands.front();
             for (size_t i = 1; i < args.size(); ++i) {
-                result =
-                    result + args.at(i)->toZ3Expr(cxt, nameMap, defineFunMap);
+                result = result + operands[i];
             }
             return result;
         } else if (opName == "*") {
-            z3::expr result =
-                args.front()->toZ3Expr(cxt, nameMap, defineFunMap);
+            z3::expr result = operands.front();
             for (size_t i = 1; i < args.size(); ++i) {
-                result =
-                    result * args.at(i)->toZ3Expr(cxt, nameMap, defineFunMap);
+                result = result * operands[i];
             }
             return result;
         } else if (opName == "distinct") {
             z3::expr_vector z3Args(cxt);
-            for (const auto &arg : args) {
-                z3Args.push_back(arg->toZ3Expr(cxt, nameMap, defineFunMap));
+            for (const auto &operand : operands) {
+                z3Args.push_back(operand);
             }
             return z3::distinct(z3Args);
         } else if (opName == "not") {
             assert(args.size() == 1);
-            z3::expr e = args.at(0)->toZ3Expr(cxt, nameMap, defineFunMap);
+            z3::expr e = operands[0];
             return !e;
         } else if (opName == "-") {
             if (args.size() == 1) {
-                z3::expr e = args.at(0)->toZ3Expr(cxt, nameMap, defineFunMap);
+                z3::expr e = operands[0];
                 return -e;
             } else if (args.size() == 2) {
-                z3::expr firstArg =
-                    args.at(0)->toZ3Expr(cxt, nameMap, defineFunMap);
-                z3::expr secondArg =
-                    args.at(1)->toZ3Expr(cxt, nameMap, defineFunMap);
+                z3::expr firstArg = operands[0];
+                z3::expr secondArg = operands[1];
                 return firstArg - secondArg;
             } else {
                 std::cerr << "Cannot subtract more than two arguments\n";
@@ -724,19 +1432,19 @@ z3::expr Op::toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
             }
         } else if (opName == "ite") {
             assert(args.size() == 3);
-            z3::expr cond = args.at(0)->toZ3Expr(cxt, nameMap, defineFunMap);
-            z3::expr ifTrue = args.at(1)->toZ3Expr(cxt, nameMap, defineFunMap);
-            z3::expr ifFalse = args.at(2)->toZ3Expr(cxt, nameMap, defineFunMap);
+            z3::expr cond = operands[0];
+            z3::expr ifTrue = operands[1];
+            z3::expr ifFalse = operands[2];
             return z3::ite(cond, ifTrue, ifFalse);
         } else if (opName == "store") {
             assert(args.size() == 3);
-            z3::expr array = args.at(0)->toZ3Expr(cxt, nameMap, defineFunMap);
-            z3::expr index = args.at(1)->toZ3Expr(cxt, nameMap, defineFunMap);
-            z3::expr val = args.at(2)->toZ3Expr(cxt, nameMap, defineFunMap);
+            z3::expr array = operands[0];
+            z3::expr index = operands[1];
+            z3::expr val = operands[2];
             return z3::store(array, index, val);
         } else if (opName == "abs") {
             assert(args.size() == 1);
-            z3::expr val = args.at(0)->toZ3Expr(cxt, nameMap, defineFunMap);
+            z3::expr val = operands[0];
             z3::expr cond = val >= 0;
             return z3::ite(cond, val, -val);
         } else {
@@ -744,10 +1452,8 @@ z3::expr Op::toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
                 std::cerr << "Unsupported opname " << opName << "\n";
                 exit(1);
             }
-            z3::expr firstArg =
-                args.at(0)->toZ3Expr(cxt, nameMap, defineFunMap);
-            z3::expr secondArg =
-                args.at(1)->toZ3Expr(cxt, nameMap, defineFunMap);
+            z3::expr firstArg = operands[0];
+            z3::expr secondArg = operands[1];
             if (opName == "=") {
                 return firstArg == secondArg;
             } else if (opName == ">=") {
@@ -778,11 +1484,12 @@ z3::expr Op::toZ3Expr(z3::context &cxt, llvm::StringMap<z3::expr> &nameMap,
 
 void FunDef::toZ3(z3::context &cxt, z3::solver & /* unused */,
                   llvm::StringMap<z3::expr> &nameMap,
-                  llvm::StringMap<Z3DefineFun> &defineFunMap) const {
+                  llvm::StringMap<Z3DefineFun> &defineFunMap,
+                  Z3TranslationCache &cache) const {
     z3::expr_vector vars(cxt);
     for (const auto &arg : args) {
         if (arg.type.getTag() == TypeTag::Int) {
-            z3::expr c = cxt.int_const(arg.name.c_str());
+            z3::expr c = cxt.int_const(arg.name.str().c_str());
             vars.push_back(c);
             auto it = nameMap.insert({arg.name, c});
             if (!it.second) {
@@ -791,7 +1498,7 @@ void FunDef::toZ3(z3::context &cxt, z3::solver & /* unused */,
         } else if (arg.type.getTag() == TypeTag::Array) {
             z3::sort intArraySort =
                 cxt.array_sort(cxt.int_sort(), cxt.int_sort());
-            z3::expr c = cxt.constant(arg.name.c_str(), intArraySort);
+            z3::expr c = cxt.constant(arg.name.str().c_str(), intArraySort);
             vars.push_back(c);
             auto it = nameMap.insert({arg.name, c});
             if (!it.second) {
@@ -803,8 +1510,15 @@ void FunDef::toZ3(z3::context &cxt, z3::solver & /* unused */,
             exit(1);
         }
     }
-    z3::expr z3Body = body->toZ3Expr(cxt, nameMap, defineFunMap);
+    // The arguments are only bound inside of the body
+    unsigned previousScope = cache.enterScope();
+    z3::expr z3Body = body->toZ3Expr(cxt, nameMap, defineFunMap, cache);
+    cache.exitScope(previousScope);
     defineFunMap.insert({funName, {vars, z3Body}});
+    // Constants are referenced by name without an application
+    if (args.empty()) {
+        bindName(nameMap, funName, z3Body);
+    }
 }
 
 std::unique_ptr<smt::SMTExpr>
@@ -870,7 +1584,7 @@ unique_ptr<Op> makeOp(std::string opName,
     return make_unique<Op>(opName, smtArgs);
 }
 
-unique_ptr<AssignmentGroup> makeAssignment(string name,
+unique_ptr<AssignmentGroup> makeAssignment(Symbol name,
                                            unique_ptr<SMTExpr> val) {
     return make_unique<AssignmentGroup>(name, std::move(val));
 }
@@ -888,123 +1602,153 @@ SortedVar sortedVarFromTypedVariable(const TypedVariable &var) {
     return {var.name, var.type};
 }
 
-shared_ptr<SMTExpr> SetLogic::accept(SMTVisitor &visitor) const {
-    shared_ptr<SetLogic> result{new SetLogic(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> Assert::accept(SMTVisitor &visitor) const {
-    shared_ptr<Assert> result{new Assert(*this)};
-    visitor.dispatch(*result);
-    result->expr = result->expr->accept(visitor);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> TypedVariable::accept(SMTVisitor &visitor) const {
-    shared_ptr<TypedVariable> result{new TypedVariable(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> Forall::accept(SMTVisitor &visitor) const {
-    shared_ptr<Forall> result{new Forall(*this)};
-    visitor.dispatch(*result);
-    result->expr = result->expr->accept(visitor);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> CheckSat::accept(SMTVisitor &visitor) const {
-    shared_ptr<CheckSat> result{new CheckSat(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> GetModel::accept(SMTVisitor &visitor) const {
-    shared_ptr<GetModel> result{new GetModel(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> Let::accept(SMTVisitor &visitor) const {
-    shared_ptr<Let> result{new Let(*this)};
-    // It is slightly unclear if bindings should be traversed before or after
-    // the let itself. However let statements cannot be recursive and it thus
-    // makes sense to traverse them first.
-    if (!visitor.ignoreLetBindings) {
-        for (auto &def : result->defs.assgns) {
-            def.second = def.second->accept(visitor);
+// Calls fn with expr cast to its dynamic type
+template <typename Expr, typename Fn>
+static auto withDynamicType(Expr &expr, Fn fn)
+    -> decltype(fn(llvm::cast<SetLogic>(expr))) {
+    switch (expr.getKind()) {
+    case SMTExprKind::SetLogic:
+        return fn(llvm::cast<SetLogic>(expr));
+    case SMTExprKind::Assert:
+        return fn(llvm::cast<Assert>(expr));
+    case SMTExprKind::TypedVariable:
+        return fn(llvm::cast<TypedVariable>(expr));
+    case SMTExprKind::Forall:
+        return fn(llvm::cast<Forall>(expr));
+    case SMTExprKind::CheckSat:
+        return fn(llvm::cast<CheckSat>(expr));
+    case SMTExprKind::GetModel:
+        return fn(llvm::cast<GetModel>(expr));
+    case SMTExprKind::Let:
+        return fn(llvm::cast<Let>(expr));
+    case SMTExprKind::ConstantFP:
+        return fn(llvm::cast<ConstantFP>(expr));
+    case SMTExprKind::ConstantInt:
+        return fn(llvm::cast<ConstantInt>(expr));
+    case SMTExprKind::ConstantBool:
+        return fn(llvm::cast<ConstantBool>(expr));
+    case SMTExprKind::ConstantString:
+        return fn(llvm::cast<ConstantString>(expr));
+    case SMTExprKind::Op:
+        return fn(llvm::cast<Op>(expr));
+    case SMTExprKind::FPCmp:
+        return fn(llvm::cast<FPCmp>(expr));
+    case SMTExprKind::BinaryFPOperator:
+        return fn(llvm::cast<BinaryFPOperator>(expr));
+    case SMTExprKind::TypeCast:
+        return fn(llvm::cast<TypeCast>(expr));
+    case SMTExprKind::Query:
+        return fn(llvm::cast<Query>(expr));
+    case SMTExprKind::FunDecl:
+        return fn(llvm::cast<FunDecl>(expr));
+    case SMTExprKind::FunDef:
+        return fn(llvm::cast<FunDef>(expr));
+    case SMTExprKind::Comment:
+        return fn(llvm::cast<Comment>(expr));
+    case SMTExprKind::VarDecl:
+        return fn(llvm::cast<VarDecl>(expr));
+    }
+    logError("Unknown expression kind\n");
+    exit(1);
+}
+
+// Subexpressions of a copy made by accept that are traversed before or after
+// the visitor is dispatched on the copy
+static void visitedOperands(SMTExpr &expr, const SMTVisitor &visitor,
+                            bool beforeDispatch,
+                            vector<SharedSMTRef *> &operands) {
+    operands.clear();
+    if (auto assertExpr = llvm::dyn_cast<Assert>(&expr)) {
+        if (!beforeDispatch) {
+            operands.push_back(&assertExpr->expr);
+        }
+    } else if (auto forall = llvm::dyn_cast<Forall>(&expr)) {
+        if (!beforeDispatch) {
+            operands.push_back(&forall->expr);
+        }
+    } else if (auto let = llvm::dyn_cast<Let>(&expr)) {
+        // It is slightly unclear if bindings should be traversed before or
+        // after the let itself. However let statements cannot be recursive
+        // and it thus makes sense to traverse them first.
+        if (beforeDispatch && !visitor.ignoreLetBindings) {
+            for (auto &def : let->defs.assgns) {
+                operands.push_back(&def.second);
+            }
+        } else if (!beforeDispatch) {
+            operands.push_back(&let->expr);
+        }
+    } else if (auto op = llvm::dyn_cast<Op>(&expr)) {
+        if (!beforeDispatch) {
+            for (auto &arg : op->args) {
+                operands.push_back(&arg);
+            }
+        }
+    } else if (auto binaryOp = llvm::dyn_cast<BinaryFPOperator>(&expr)) {
+        if (!beforeDispatch) {
+            operands.push_back(&binaryOp->op0);
+            operands.push_back(&binaryOp->op1);
+        }
+    } else if (auto typeCast = llvm::dyn_cast<TypeCast>(&expr)) {
+        if (beforeDispatch) {
+            operands.push_back(&typeCast->operand);
+        }
+    } else if (auto funDef = llvm::dyn_cast<FunDef>(&expr)) {
+        if (!beforeDispatch) {
+            operands.push_back(&funDef->body);
+        }
+    }
+}
+
+shared_ptr<SMTExpr> SMTExpr::accept(SMTVisitor &visitor) const {
+    // dispatch and reassemble operate on a copy of each expression whose
+    // operands are replaced by the results of visiting them
+    struct Frame {
+        shared_ptr<SMTExpr> copy;
+        vector<SharedSMTRef *> operands;
+        size_t nextOperand;
+        bool dispatched;
+    };
+    auto enter = [&visitor](const SMTExpr &expr) {
+        Frame frame{withDynamicType(expr,
+                                    [](const auto &e) -> shared_ptr<SMTExpr> {
+                                        using T = std::decay_t<decltype(e)>;
+                                        return shared_ptr<T>{new T(e)};
+                                    }),
+                    {},
+                    0,
+                    false};
+        visitedOperands(*frame.copy, visitor, true, frame.operands);
+        return frame;
+    };
+    vector<Frame> stack;
+    stack.push_back(enter(*this));
+    shared_ptr<SMTExpr> result;
+    bool hasResult = false;
+    while (true) {
+        Frame &frame = stack.back();
+        if (hasResult) {
+            *frame.operands[frame.nextOperand++] = std::move(result);
+            hasResult = false;
+        }
+        if (frame.nextOperand < frame.operands.size()) {
+            stack.push_back(enter(**frame.operands[frame.nextOperand]));
+        } else if (!frame.dispatched) {
+            withDynamicType(*frame.copy,
+                            [&visitor](auto &e) { visitor.dispatch(e); });
+            frame.dispatched = true;
+            frame.nextOperand = 0;
+            visitedOperands(*frame.copy, visitor, false, frame.operands);
+        } else {
+            result = withDynamicType(*frame.copy, [&visitor](auto &e) {
+                return visitor.reassemble(e);
+            });
+            hasResult = true;
+            stack.pop_back();
+            if (stack.empty()) {
+                return result;
+            }
         }
     }
-    visitor.dispatch(*result);
-    result->expr = result->expr->accept(visitor);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> ConstantFP::accept(SMTVisitor &visitor) const {
-    shared_ptr<ConstantFP> result{new ConstantFP(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> ConstantInt::accept(SMTVisitor &visitor) const {
-    shared_ptr<ConstantInt> result{new ConstantInt(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> ConstantBool::accept(SMTVisitor &visitor) const {
-    shared_ptr<ConstantBool> result{new ConstantBool(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> ConstantString::accept(SMTVisitor &visitor) const {
-    shared_ptr<ConstantString> result{new ConstantString(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> Op::accept(SMTVisitor &visitor) const {
-    shared_ptr<Op> result{new Op(*this)};
-    visitor.dispatch(*result);
-    for (auto &arg : result->args) {
-        arg = arg->accept(visitor);
-    }
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> FPCmp::accept(SMTVisitor &visitor) const {
-    shared_ptr<FPCmp> result{new FPCmp(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> BinaryFPOperator::accept(SMTVisitor &visitor) const {
-    shared_ptr<BinaryFPOperator> result{new BinaryFPOperator(*this)};
-    visitor.dispatch(*result);
-    result->op0 = result->op0->accept(visitor);
-    result->op1 = result->op1->accept(visitor);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> TypeCast::accept(SMTVisitor &visitor) const {
-    shared_ptr<TypeCast> result{new TypeCast(*this)};
-    result->operand = result->operand->accept(visitor);
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> Query::accept(SMTVisitor &visitor) const {
-    shared_ptr<Query> result{new Query(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> FunDecl::accept(SMTVisitor &visitor) const {
-    shared_ptr<FunDecl> result{new FunDecl(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> FunDef::accept(SMTVisitor &visitor) const {
-    shared_ptr<FunDef> result{new FunDef(*this)};
-    visitor.dispatch(*result);
-    result->body = result->body->accept(visitor);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> Comment::accept(SMTVisitor &visitor) const {
-    shared_ptr<Comment> result{new Comment(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
-}
-shared_ptr<SMTExpr> VarDecl::accept(SMTVisitor &visitor) const {
-    shared_ptr<VarDecl> result{new VarDecl(*this)};
-    visitor.dispatch(*result);
-    return visitor.reassemble(*result);
 }
 } // namespace smt
 
@@ -0,0 +1,213 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#include "SMTCache.h"
+
+#include "Logging.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+using llreve::FunctionInvariant;
+using smt::SharedSMTRef;
+using std::string;
+
+using namespace llreve::opts;
+
+static void printSMT(std::ostream &out, const SharedSMTRef &smt) {
+    if (smt) {
+        sexpr::SExprWriter writer(out, true);
+        smt->writeSMTLib(writer);
+    } else {
+        out << "null";
+    }
+    out << "\n";
+}
+
+// Both programs can contain functions of the same name, so the name is
+// followed by the program the function belongs to
+static void printFunctionName(std::ostream &out, const llvm::Function *fun) {
+    if (!fun) {
+        out << "null\n";
+        return;
+    }
+    const auto &mainFunctions = SMTGenerationOpts::getInstance().MainFunctions;
+    int program = 0;
+    if (mainFunctions.first &&
+        fun->getParent() == mainFunctions.first->getParent()) {
+        program = 1;
+    } else if (mainFunctions.second &&
+               fun->getParent() == mainFunctions.second->getParent()) {
+        program = 2;
+    }
+    out << fun->getName().str() << " " << program << "\n";
+}
+
+static void
+printInvariants(std::ostream &out,
+                const std::map<Mark, FunctionInvariant<SharedSMTRef>> &invs) {
+    for (const auto &inv : invs) {
+        out << inv.first << "\n";
+        printSMT(out, inv.second.preCondition);
+        printSMT(out, inv.second.postCondition);
+    }
+}
+
+// The containers keyed by functions are ordered by their addresses which
+// change from run to run, so their entries are printed sorted by the names
+// of the functions
+static void printSorted(std::ostream &out, std::vector<string> entries) {
+    std::sort(entries.begin(), entries.end());
+    for (const auto &entry : entries) {
+        out << entry;
+    }
+}
+
+template <typename FunctionPairs>
+static void printFunctionPairs(std::ostream &out,
+                               const FunctionPairs &funPairs) {
+    std::vector<string> entries;
+    for (const auto &funPair : funPairs) {
+        std::ostringstream entry;
+        printFunctionName(entry, funPair.first);
+        printFunctionName(entry, funPair.second);
+        entries.push_back(entry.str());
+    }
+    printSorted(out, std::move(entries));
+}
+
+// Everything in SMTGenerationOpts, functions are identified by their names
+static void printSMTGenerationOpts(std::ostream &out) {
+    const SMTGenerationOpts &opts = SMTGenerationOpts::getInstance();
+    printFunctionName(out, opts.MainFunctions.first);
+    printFunctionName(out, opts.MainFunctions.second);
+    out << static_cast<int>(opts.Heap) << static_cast<int>(opts.Stack)
+        << static_cast<int>(opts.GlobalConstants)
+        << static_cast<int>(opts.OnlyRecursive)
+        << static_cast<int>(opts.ByteHeap) << opts.EverythingSigned
+        << static_cast<int>(opts.OutputFormat)
+        << static_cast<int>(opts.PerfectSync) << opts.PassInputThrough
+        << opts.BitVect << opts.Invert << opts.InitPredicate
+        << opts.DisableAutoAbstraction << static_cast<int>(opts.Encoding)
+        << opts.PathBudget << "\n";
+    for (const auto &inv : opts.IterativeRelationalInvariants) {
+        out << inv.first << "\n";
+        printSMT(out, inv.second);
+    }
+    std::vector<string> entries;
+    for (const auto &invs : opts.FunctionalFunctionalInvariants) {
+        std::ostringstream entry;
+        printFunctionName(entry, invs.first);
+        printInvariants(entry, invs.second);
+        entries.push_back(entry.str());
+    }
+    printSorted(out, std::move(entries));
+    entries.clear();
+    for (const auto &invs : opts.FunctionalRelationalInvariants) {
+        std::ostringstream entry;
+        printFunctionName(entry, invs.first.first);
+        printFunctionName(entry, invs.first.second);
+        printInvariants(entry, invs.second);
+        entries.push_back(entry.str());
+    }
+    printSorted(out, std::move(entries));
+    printFunctionPairs(out, opts.AssumeEquivalent);
+    printFunctionPairs(out, opts.CoupledFunctions);
+    entries.clear();
+    for (const auto &numeral : opts.FunctionNumerals) {
+        std::ostringstream entry;
+        printFunctionName(entry, numeral.first);
+        entry << numeral.second << "\n";
+        entries.push_back(entry.str());
+    }
+    printSorted(out, std::move(entries));
+}
+
+string smtCacheKey(MonoPair<const llvm::Module &> modules,
+                   const PreprocessOpts &preprocessOpts,
+                   const FileOptions &fileOpts,
+                   const SerializeOpts &serializeOpts,
+                   llvm::StringRef version) {
+    llvm::MD5 hash;
+    hash.update(version);
+    modules.forEach([&hash](const llvm::Module &mod) {
+        string ir;
+        llvm::raw_string_ostream irStream(ir);
+        irStream << mod;
+        hash.update(irStream.str());
+    });
+
+    std::ostringstream opts;
+    printSMTGenerationOpts(opts);
+    opts << preprocessOpts.InferMarks << "\n";
+    for (const auto &cond : fileOpts.FunctionConditions) {
+        opts << cond.first << "\n" << cond.second << "\n";
+    }
+    printSMT(opts, fileOpts.InRelation);
+    printSMT(opts, fileOpts.OutRelation);
+    opts << fileOpts.AdditionalInRelation << serializeOpts.DontInstantiate
+         << serializeOpts.MergeImplications << serializeOpts.Pretty
+         << serializeOpts.InlineLets << serializeOpts.CSE
+         << serializeOpts.Simplify << serializeOpts.PruneClauses
+         << serializeOpts.InlinePredicates << "\n";
+    hash.update(opts.str());
+
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    llvm::SmallString<32> key;
+    llvm::MD5::stringifyResult(result, key);
+    return key.str().str();
+}
+
+static llvm::SmallString<256> cachePath(llvm::StringRef cacheDir,
+                                        llvm::StringRef key) {
+    llvm::SmallString<256> path(cacheDir);
+    llvm::sys::path::append(path, key + ".smt2");
+    return path;
+}
+
+bool lookupSMTCache(llvm::StringRef cacheDir, llvm::StringRef key,
+                    string &smt) {
+    auto buffer = llvm::MemoryBuffer::getFile(cachePath(cacheDir, key));
+    if (!buffer) {
+        return false;
+    }
+    smt = (*buffer)->getBuffer().str();
+    return true;
+}
+
+void storeSMTCache(llvm::StringRef cacheDir, llvm::StringRef key,
+                   llvm::StringRef smt) {
+    llvm::SmallString<256> path = cachePath(cacheDir, key);
+    llvm::SmallString<256> tmpPath;
+    int fd;
+    // Write to a temporary file first so concurrent runs never see partial
+    // entries
+    if (llvm::sys::fs::create_directories(cacheDir) ||
+        llvm::sys::fs::createUniqueFile(path + ".tmp-%%%%%%%%", fd, tmpPath)) {
+        logWarning("Couldn’t write to the SMT cache\n");
+        return;
+    }
+    {
+        llvm::raw_fd_ostream os(fd, true);
+        os << smt;
+    }
+    if (llvm::sys::fs::rename(tmpPath, path)) {
+        logWarning("Couldn’t write to the SMT cache\n");
+        llvm::sys::fs::remove(tmpPath);
+    }
+}
@@ -10,6 +10,8 @@
 
 #include "Serialize.h"
 
+#include "CommonSubexpressions.h"
+
 #include <llvm/ADT/StringMap.h>
 
 #include <fstream>
@@ -76,11 +78,11 @@ static void renameVariables(smt::SMTExpr &expr,
 }
 
 struct AssignmentRenameVisitor : smt::SMTVisitor {
-    llvm::StringMap<unsigned> variableMap;
+    smt::SymbolMap<unsigned> variableMap;
     void dispatch(smt::TypedVariable &var) override {
         auto foundIt = variableMap.find(var.name);
         if (foundIt != variableMap.end()) {
-            var.name += "_" + std::to_string(foundIt->getValue());
+            var.name = var.name + "_" + std::to_string(foundIt->second);
         }
     }
     // There are still some places left where we use ConstantString instead of
@@ -88,20 +90,21 @@ struct AssignmentRenameVisitor : smt::SMTVisitor {
     void dispatch(smt::ConstantString &str) override {
         auto foundIt = variableMap.find(str.value);
         if (foundIt != variableMap.end()) {
-            str.value += "_" + std::to_string(foundIt->getValue());
+            str.value += "_" + std::to_string(foundIt->second);
         }
     }
 
     void dispatch(smt::Let &let) override {
         for (auto &assignment : let.defs.assgns) {
             int newIndex = ++variableMap[assignment.first];
-            assignment.first += "_" + std::to_string(newIndex);
+            assignment.first =
+                assignment.first + "_" + std::to_string(newIndex);
         }
     }
     void dispatch(Forall &forall) override {
         for (auto &var : forall.vars) {
             int newIndex = ++variableMap[var.name];
-            var.name += "_" + std::to_string(newIndex);
+            var.name = var.name + "_" + std::to_string(newIndex);
         }
     }
 };
@@ -178,7 +181,7 @@ static shared_ptr<smt::SMTExpr> compressLets(smt::SMTExpr &expr) {
 struct InstantiateArraysVisitor : smt::SMTVisitor {
     InstantiateArraysVisitor() : smt::SMTVisitor(true) {}
     shared_ptr<smt::SMTExpr> reassemble(Op &op) {
-        if (op.opName.compare(0, 4, "INV_") == 0 || op.opName == "INIT") {
+        if (op.opName.str().compare(0, 4, "INV_") == 0 || op.opName == "INIT") {
             std::vector<SortedVar> indices;
             std::vector<SharedSMTRef> newArgs;
             for (const auto &arg : op.args) {
@@ -228,6 +231,37 @@ static shared_ptr<smt::SMTExpr> instantiateArrays(smt::SMTExpr &expr) {
     return expr.accept(visitor);
 }
 
+// Rewrite a single toplevel expression of the SMT-Horn format
+static SharedSMTRef prepareHornExpr(SharedSMTRef expr,
+                                    const SerializeOpts &opts) {
+    if (opts.Pretty) {
+        expr = compressLets(*expr);
+    }
+    // Common subexpressions cannot be found across the binders of lets
+    if (opts.InlineLets || opts.CSE) {
+        expr = renameAssignments(*expr)->inlineLets();
+    }
+    if (opts.MergeImplications) {
+        expr = expr->mergeImplications({});
+    }
+    if (!opts.DontInstantiate) {
+        expr = instantiateArrays(*expr);
+    }
+    return expr;
+}
+
+// Rewrite and write a single toplevel expression of the SMT-Horn format
+static void serializeHornExpr(SharedSMTRef expr, const SerializeOpts &opts,
+                              sexpr::SExprWriter &writer) {
+    expr = prepareHornExpr(std::move(expr), opts);
+    if (opts.CSE) {
+        // Only repetitions inside of this expression are known here
+        expr = smt::bindCommonSubexpressions(std::move(expr));
+    }
+    expr->writeSMTLib(writer);
+    writer.newline();
+}
+
 void serializeSMT(vector<SharedSMTRef> smtExprs, bool muZ, SerializeOpts opts) {
     // write to file or to stdout
     std::streambuf *buf;
@@ -241,23 +275,42 @@ void serializeSMT(vector<SharedSMTRef> smtExprs, bool muZ, SerializeOpts opts) {
     }
 
     std::ostream outFile(buf);
+    serializeSMT(std::move(smtExprs), muZ, opts, outFile);
+
+    if (!opts.OutputFileName.empty()) {
+        ofStream.close();
+    }
+}
+
+void writeSerializedSMT(const std::string &smt, const SerializeOpts &opts) {
+    if (!opts.OutputFileName.empty()) {
+        std::ofstream ofStream(opts.OutputFileName);
+        ofStream << smt;
+    } else {
+        std::cout << smt;
+    }
+}
 
+void serializeSMT(vector<SharedSMTRef> smtExprs, bool muZ, SerializeOpts opts,
+                  std::ostream &outFile) {
     int i = 0;
     if (muZ) {
         set<SortedVar> introducedVariables;
         vector<SharedSMTRef> preparedSMTExprs;
+        // The muZ output has always been pretty printed
+        sexpr::SExprWriter writer(outFile, true);
         // Explicit casts are significantly easier to debug
-        outFile << *makeOp("set-option", ":int-real-coercions",
-                           std::make_unique<smt::ConstantBool>(false))
-                        ->toSExpr()
-                << "\n";
+        makeOp("set-option", ":int-real-coercions",
+               std::make_unique<smt::ConstantBool>(false))
+            ->writeSMTLib(writer);
+        writer.newline();
         vector<SharedSMTRef> letCompressedExprs;
         for (const auto &smt : smtExprs) {
             auto splitSMTs = smt->splitConjunctions();
             for (auto &expr : splitSMTs) {
                 expr = renameAssignments(*compressLets(*expr));
                 if (opts.InlineLets) {
-                    expr = expr->inlineLets({});
+                    expr = expr->inlineLets();
                 }
                 expr = removeForalls(*expr, introducedVariables);
                 preparedSMTExprs.push_back(expr->mergeImplications({}));
@@ -266,36 +319,63 @@ void serializeSMT(vector<SharedSMTRef> smtExprs, bool muZ, SerializeOpts opts) {
         const auto renamedVariables =
             simplifyVariableNames(introducedVariables, opts.InlineLets);
         for (const auto &var : introducedVariables) {
-            outFile << *VarDecl({renamedVariables.lookup(var.name), var.type})
-                            .toSExpr();
-            outFile << "\n";
+            VarDecl({renamedVariables.lookup(var.name), var.type})
+                .writeSMTLib(writer);
+            writer.newline();
         }
         for (const auto &smt : preparedSMTExprs) {
             renameVariables(*smt, renamedVariables);
-            outFile << *smt->toSExpr();
-            outFile << "\n";
+            smt->writeSMTLib(writer);
+            writer.newline();
+        }
+    } else if (opts.CSE) {
+        // Definitions shared between assertions can only be found once all
+        // of them have been rewritten
+        for (auto &expr : smtExprs) {
+            expr = prepareHornExpr(std::move(expr), opts);
+        }
+        smtExprs = smt::eliminateCommonSubexpressions(std::move(smtExprs));
+        sexpr::SExprWriter writer(outFile, opts.Pretty);
+        for (auto &expr : smtExprs) {
+            expr->writeSMTLib(writer);
+            writer.newline();
+            expr = nullptr;
         }
     } else {
+        sexpr::SExprWriter writer(outFile, opts.Pretty);
         for (auto &expr : smtExprs) {
-            if (opts.Pretty) {
-                expr = compressLets(*expr);
-            }
-            if (opts.InlineLets) {
-                expr = renameAssignments(*expr)->inlineLets({});
-            }
-            if (opts.MergeImplications) {
-                expr = expr->mergeImplications({});
-            }
-            if (!opts.DontInstantiate) {
-                expr = instantiateArrays(*expr);
-            }
-            expr->toSExpr()->serialize(outFile, 0, opts.Pretty);
-            outFile << "\n";
+            // Moving releases the expression as soon as it has been written
+            serializeHornExpr(std::move(expr), opts, writer);
             ++i;
         }
     }
+}
 
-    if (!opts.OutputFileName.empty()) {
-        ofStream.close();
+StreamingSerializer::StreamingSerializer(SerializeOpts opts,
+                                         std::ostream &outFile,
+                                         size_t capacity)
+    : opts(std::move(opts)), queue(capacity) {
+    consumer = std::thread([this, &outFile] {
+        sexpr::SExprWriter writer(outFile, this->opts.Pretty);
+        SharedSMTRef expr;
+        while (queue.pop(expr)) {
+            serializeHornExpr(std::move(expr), this->opts, writer);
+        }
+    });
+}
+
+StreamingSerializer::~StreamingSerializer() {
+    if (consumer.joinable()) {
+        queue.close();
+        consumer.join();
     }
 }
+
+void StreamingSerializer::push(SharedSMTRef expr) {
+    queue.push(std::move(expr));
+}
+
+void StreamingSerializer::finish() {
+    queue.close();
+    consumer.join();
+}
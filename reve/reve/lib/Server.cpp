@@ -0,0 +1,224 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#include "Server.h"
+
+#include "Logging.h"
+
+#include "json.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using nlohmann::json;
+using std::string;
+using std::vector;
+
+// Convert a job to command line arguments. Returns false if the job is
+// malformed.
+static bool jobArguments(const json &job, vector<string> &args,
+                         string &error) {
+    if (!job.is_object()) {
+        error = "job is not an object";
+        return false;
+    }
+    auto files = job.find("files");
+    if (files == job.end() || !files->is_array() || files->size() != 2 ||
+        !(*files)[0].is_string() || !(*files)[1].is_string()) {
+        error = "'files' has to be an array of two file names";
+        return false;
+    }
+    args.push_back((*files)[0].get<string>());
+    args.push_back((*files)[1].get<string>());
+    auto fun = job.find("fun");
+    if (fun != job.end()) {
+        if (!fun->is_string()) {
+            error = "'fun' has to be a string";
+            return false;
+        }
+        args.push_back("-fun=" + fun->get<string>());
+    }
+    auto jobArgs = job.find("args");
+    if (jobArgs != job.end()) {
+        if (!jobArgs->is_array()) {
+            error = "'args' has to be an array of strings";
+            return false;
+        }
+        for (const auto &arg : *jobArgs) {
+            if (!arg.is_string()) {
+                error = "'args' has to be an array of strings";
+                return false;
+            }
+            args.push_back(arg.get<string>());
+        }
+    }
+    return true;
+}
+
+// Run the job in a child process and collect its stdout
+static int runInChild(const char *exeName, const vector<string> &args,
+                      const JobRunner &runJob, string &output) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        logError("Couldn’t create pipe\n");
+        return 1;
+    }
+    std::cout.flush();
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        logError("Couldn’t fork\n");
+        close(fds[0]);
+        close(fds[1]);
+        return 1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        vector<const char *> argv = {exeName};
+        for (const auto &arg : args) {
+            argv.push_back(arg.c_str());
+        }
+        int exitCode = runJob(static_cast<int>(argv.size()), argv.data());
+        std::cout.flush();
+        fflush(stdout);
+        _exit(exitCode);
+    }
+    close(fds[1]);
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        output.append(buf, static_cast<size_t>(n));
+    }
+    close(fds[0]);
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return 1;
+        }
+    }
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    // Same convention as the shell for processes killed by a signal
+    return 128 + WTERMSIG(status);
+}
+
+static void serveJobs(const char *exeName, FILE *in, FILE *out,
+                      const JobRunner &runJob) {
+    char *line = nullptr;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, in)) != -1) {
+        string jobLine(line, static_cast<size_t>(length));
+        if (jobLine.find_first_not_of(" \t\r\n") == string::npos) {
+            continue;
+        }
+        json response;
+        json job;
+        try {
+            job = json::parse(jobLine);
+        } catch (const std::invalid_argument &e) {
+            response["exit_code"] = 1;
+            response["error"] = string("invalid json: ") + e.what();
+            fprintf(out, "%s\n", response.dump().c_str());
+            fflush(out);
+            continue;
+        }
+        if (job.is_object() && job.find("id") != job.end()) {
+            response["id"] = job["id"];
+        }
+        vector<string> args;
+        string error;
+        if (!jobArguments(job, args, error)) {
+            response["exit_code"] = 1;
+            response["error"] = error;
+        } else {
+            string output;
+            response["exit_code"] = runInChild(exeName, args, runJob, output);
+            response["output"] = output;
+        }
+        fprintf(out, "%s\n", response.dump().c_str());
+        fflush(out);
+    }
+    free(line);
+}
+
+int serveStdin(const char *exeName, const JobRunner &runJob) {
+    serveJobs(exeName, stdin, stdout, runJob);
+    return 0;
+}
+
+int serveSocket(const char *exeName, const string &socketPath,
+                const JobRunner &runJob) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        logError("Socket path is too long\n");
+        return 1;
+    }
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        logError("Couldn’t create socket\n");
+        return 1;
+    }
+    unlink(socketPath.c_str());
+    if (bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(sock, 16) != 0) {
+        logError("Couldn’t listen on " + socketPath + "\n");
+        close(sock);
+        return 1;
+    }
+    // Clients disconnecting early shouldn’t terminate the server
+    signal(SIGPIPE, SIG_IGN);
+    while (true) {
+        int conn = accept(sock, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logError("Couldn’t accept connection\n");
+            break;
+        }
+        FILE *in = fdopen(conn, "r");
+        FILE *out = fdopen(dup(conn), "w");
+        if (in && out) {
+            serveJobs(exeName, in, out, runJob);
+        }
+        if (in) {
+            fclose(in);
+        }
+        if (out) {
+            fclose(out);
+        }
+    }
+    close(sock);
+    unlink(socketPath.c_str());
+    return 1;
+}
@@ -0,0 +1,310 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#include "Simplify.h"
+
+#include "Opts.h"
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+using namespace llreve::opts;
+
+namespace smt {
+
+void SimplificationStats::print(std::ostream &out) const {
+    out << "Simplification: folded " << foldedConstants
+        << " constant expressions, simplified " << simplifiedConnectives
+        << " connectives, removed " << removedDoubleNegations
+        << " double negations and " << removedAssertions
+        << " trivially true assertions\n";
+}
+
+static const ConstantBool *boolLiteral(const SharedSMTRef &expr) {
+    return llvm::dyn_cast<ConstantBool>(expr.get());
+}
+
+static const ConstantInt *intLiteral(const SharedSMTRef &expr) {
+    return llvm::dyn_cast<ConstantInt>(expr.get());
+}
+
+static bool isLiteral(const SharedSMTRef &expr, bool value) {
+    const auto literal = boolLiteral(expr);
+    return literal && literal->value == value;
+}
+
+static bool isOp(const SharedSMTRef &expr, llvm::StringRef opName) {
+    const auto op = llvm::dyn_cast<Op>(expr.get());
+    return op && op->opName == opName;
+}
+
+static SharedSMTRef boolExpr(bool value) {
+    return make_shared<ConstantBool>(value);
+}
+
+// Integers are printed as signed values if bitvectors are not used, so
+// literals of different widths are compared after sign extension.
+static bool compareLiterals(llvm::StringRef opName, llvm::APInt lhs,
+                            llvm::APInt rhs, bool &result) {
+    unsigned width = std::max(lhs.getBitWidth(), rhs.getBitWidth());
+    bool isUnsigned = opName.startswith("bvu");
+    if (isUnsigned) {
+        lhs = lhs.zext(width);
+        rhs = rhs.zext(width);
+    } else {
+        lhs = lhs.sext(width);
+        rhs = rhs.sext(width);
+    }
+    if (opName == "=") {
+        result = lhs == rhs;
+    } else if (opName == "distinct") {
+        result = lhs != rhs;
+    } else if (opName == "<" || opName == "bvslt") {
+        result = lhs.slt(rhs);
+    } else if (opName == "<=" || opName == "bvsle") {
+        result = lhs.sle(rhs);
+    } else if (opName == ">" || opName == "bvsgt") {
+        result = lhs.sgt(rhs);
+    } else if (opName == ">=" || opName == "bvsge") {
+        result = lhs.sge(rhs);
+    } else if (opName == "bvult") {
+        result = lhs.ult(rhs);
+    } else if (opName == "bvule") {
+        result = lhs.ule(rhs);
+    } else if (opName == "bvugt") {
+        result = lhs.ugt(rhs);
+    } else if (opName == "bvuge") {
+        result = lhs.uge(rhs);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Arithmetic on mathematical integers. The width of the result is chosen
+// large enough so that no overflow can occur.
+static bool foldArithmetic(llvm::StringRef opName,
+                           const vector<const ConstantInt *> &literals,
+                           llvm::APInt &result) {
+    if (literals.empty()) {
+        return false;
+    }
+    unsigned width = 0;
+    for (const auto literal : literals) {
+        if (opName == "*") {
+            width += literal->value.getBitWidth();
+        } else {
+            width = std::max(width, literal->value.getBitWidth());
+        }
+    }
+    width += literals.size();
+    result = literals.front()->value.sext(width);
+    if (opName == "-" && literals.size() == 1) {
+        result = -result;
+        return true;
+    }
+    for (size_t i = 1; i < literals.size(); ++i) {
+        llvm::APInt value = literals[i]->value.sext(width);
+        if (opName == "+") {
+            result += value;
+        } else if (opName == "-") {
+            result -= value;
+        } else if (opName == "*") {
+            result *= value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct SimplifyVisitor : SMTVisitor {
+    SimplificationStats &stats;
+    explicit SimplifyVisitor(SimplificationStats &stats) : stats(stats) {}
+
+    // Shared implementation of and (neutral = true) and or (neutral = false)
+    SharedSMTRef simplifyJunction(Op &op, bool neutral) {
+        vector<SharedSMTRef> args;
+        bool changed = false;
+        for (auto &arg : op.args) {
+            if (isLiteral(arg, neutral)) {
+                changed = true;
+            } else if (isLiteral(arg, !neutral)) {
+                ++stats.simplifiedConnectives;
+                return boolExpr(!neutral);
+            } else if (isOp(arg, op.opName)) {
+                // The arguments have already been flattened
+                const auto &nested = llvm::cast<Op>(*arg);
+                args.insert(args.end(), nested.args.begin(), nested.args.end());
+                changed = true;
+            } else {
+                args.push_back(arg);
+            }
+        }
+        if (!changed && args.size() > 1) {
+            return op.shared_from_this();
+        }
+        ++stats.simplifiedConnectives;
+        if (args.empty()) {
+            return boolExpr(neutral);
+        }
+        if (args.size() == 1) {
+            return args.front();
+        }
+        op.args = std::move(args);
+        return op.shared_from_this();
+    }
+
+    SharedSMTRef simplifyImplication(Op &op) {
+        if (op.args.size() != 2) {
+            return op.shared_from_this();
+        }
+        const auto &premise = op.args.at(0);
+        const auto &conclusion = op.args.at(1);
+        if (isLiteral(premise, false) || isLiteral(conclusion, true)) {
+            ++stats.simplifiedConnectives;
+            return boolExpr(true);
+        }
+        if (isLiteral(premise, true)) {
+            ++stats.simplifiedConnectives;
+            return conclusion;
+        }
+        return op.shared_from_this();
+    }
+
+    SharedSMTRef simplifyNegation(Op &op) {
+        if (op.args.size() != 1) {
+            return op.shared_from_this();
+        }
+        const auto &arg = op.args.front();
+        if (const auto literal = boolLiteral(arg)) {
+            ++stats.foldedConstants;
+            return boolExpr(!literal->value);
+        }
+        if (isOp(arg, "not")) {
+            ++stats.removedDoubleNegations;
+            return llvm::cast<Op>(*arg).args.at(0);
+        }
+        return op.shared_from_this();
+    }
+
+    SharedSMTRef simplifyIte(Op &op) {
+        if (op.args.size() != 3) {
+            return op.shared_from_this();
+        }
+        if (const auto literal = boolLiteral(op.args.at(0))) {
+            ++stats.simplifiedConnectives;
+            return literal->value ? op.args.at(1) : op.args.at(2);
+        }
+        return op.shared_from_this();
+    }
+
+    SharedSMTRef foldLiterals(Op &op) {
+        if (op.args.size() == 2 &&
+            (op.opName == "=" || op.opName == "distinct")) {
+            const auto lhs = boolLiteral(op.args.at(0));
+            const auto rhs = boolLiteral(op.args.at(1));
+            if (lhs && rhs) {
+                ++stats.foldedConstants;
+                return boolExpr((lhs->value == rhs->value) ==
+                                (op.opName == "="));
+            }
+        }
+        vector<const ConstantInt *> literals;
+        for (const auto &arg : op.args) {
+            const auto literal = intLiteral(arg);
+            if (!literal) {
+                return op.shared_from_this();
+            }
+            literals.push_back(literal);
+        }
+        bool comparison;
+        if (literals.size() == 2 &&
+            compareLiterals(op.opName, literals.at(0)->value,
+                            literals.at(1)->value, comparison)) {
+            ++stats.foldedConstants;
+            return boolExpr(comparison);
+        }
+        // With bitvectors the wraparound semantics of the solver would have
+        // to be replicated, which is not worth it
+        llvm::APInt value;
+        if (!SMTGenerationOpts::getInstance().BitVect &&
+            foldArithmetic(op.opName, literals, value)) {
+            ++stats.foldedConstants;
+            return make_shared<ConstantInt>(value);
+        }
+        return op.shared_from_this();
+    }
+
+    shared_ptr<SMTExpr> reassemble(Op &op) override {
+        if (op.opName == "and") {
+            return simplifyJunction(op, true);
+        }
+        if (op.opName == "or") {
+            return simplifyJunction(op, false);
+        }
+        if (op.opName == "=>") {
+            return simplifyImplication(op);
+        }
+        if (op.opName == "not") {
+            return simplifyNegation(op);
+        }
+        if (op.opName == "ite") {
+            return simplifyIte(op);
+        }
+        return foldLiterals(op);
+    }
+    shared_ptr<SMTExpr> reassemble(Forall &forall) override {
+        if (boolLiteral(forall.expr)) {
+            return forall.expr;
+        }
+        return forall.shared_from_this();
+    }
+    shared_ptr<SMTExpr> reassemble(Let &let) override {
+        if (boolLiteral(let.expr)) {
+            return let.expr;
+        }
+        return let.shared_from_this();
+    }
+};
+
+auto simplify(const SMTExpr &expr, SimplificationStats &stats)
+    -> SharedSMTRef {
+    SimplifyVisitor visitor(stats);
+    return expr.accept(visitor);
+}
+
+auto simplifyAssertion(const SMTExpr &expr, SimplificationStats &stats)
+    -> SharedSMTRef {
+    auto simplified = simplify(expr, stats);
+    if (const auto assertion = llvm::dyn_cast<Assert>(simplified.get())) {
+        if (isLiteral(assertion->expr, true)) {
+            ++stats.removedAssertions;
+            return nullptr;
+        }
+    }
+    return simplified;
+}
+
+auto simplifyAssertions(vector<SharedSMTRef> exprs, SimplificationStats &stats)
+    -> vector<SharedSMTRef> {
+    vector<SharedSMTRef> result;
+    result.reserve(exprs.size());
+    for (auto &expr : exprs) {
+        if (auto simplified = simplifyAssertion(*expr, stats)) {
+            result.push_back(std::move(simplified));
+        }
+        // Release the original expression right away
+        expr = nullptr;
+    }
+    return result;
+}
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#include "Solve.h"
+
+#include "llvm/ADT/StringMap.h"
+
+using smt::SharedSMTRef;
+using smt::Z3DefineFun;
+using std::vector;
+
+auto solveSMT(const vector<SharedSMTRef> &smtExprs) -> SolveResult {
+    z3::context cxt;
+    // The HORN logic selects the fixedpoint (Spacer) engine
+    z3::solver solver(cxt, "HORN");
+    llvm::StringMap<z3::expr> nameMap;
+    llvm::StringMap<Z3DefineFun> defineFunMap;
+    smt::Z3TranslationCache cache;
+    for (const auto &smt : smtExprs) {
+        smt->toZ3(cxt, solver, nameMap, defineFunMap, cache);
+    }
+    // A model for the uninterpreted predicates is a set of coupling
+    // invariants proving equivalence
+    switch (solver.check()) {
+    case z3::sat:
+        return SolveResult::Equal;
+    case z3::unsat:
+        return SolveResult::NotEqual;
+    case z3::unknown:
+        return SolveResult::Unknown;
+    }
+    return SolveResult::Unknown;
+}
+
+auto solveResultName(SolveResult result) -> const char * {
+    switch (result) {
+    case SolveResult::Equal:
+        return "EQUAL";
+    case SolveResult::NotEqual:
+        return "NOT_EQUAL";
+    case SolveResult::Unknown:
+        return "UNKNOWN";
+    }
+    return "UNKNOWN";
+}
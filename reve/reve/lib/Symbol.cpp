@@ -0,0 +1,78 @@
+/*
+ * This file is part of
+ *    llreve - Automatic regression verification for LLVM programs
+ *
+ * Copyright (C) 2016 Karlsruhe Institute of Technology
+ *
+ * The system is published under a BSD license.
+ * See LICENSE (distributed with this file) for details.
+ */
+
+#include "Symbol.h"
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringMap.h"
+
+#include <array>
+#include <mutex>
+
+namespace smt {
+
+namespace {
+// The strings are never freed. The entries of a StringMap are not moved when
+// it grows so pointers to them stay valid.
+//
+// The pool is split into shards selected by the hash of the name so threads
+// interning different names rarely wait for each other. A name always ends up
+// in the same shard, so it is still stored only once.
+class SymbolPool {
+    static constexpr size_t ShardCount = 64;
+    struct Shard {
+        std::mutex mutex;
+        llvm::StringMap<std::string> names;
+    };
+    std::array<Shard, ShardCount> shards;
+
+  public:
+    const std::string *intern(llvm::StringRef name) {
+        Shard &shard = shards[llvm::hash_value(name) % ShardCount];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.names.find(name);
+        if (it == shard.names.end()) {
+            it = shard.names.insert({name, name.str()}).first;
+        }
+        return &it->second;
+    }
+};
+}
+
+static SymbolPool &symbolPool() {
+    // Constructed on first use so symbols can be created during static
+    // initialization
+    static SymbolPool *pool = new SymbolPool;
+    return *pool;
+}
+
+// Names which have already been interned by the current thread can be found
+// without taking any lock. Since the pool never frees a string, the cached
+// pointers stay valid after the thread has looked them up.
+static const std::string *internName(llvm::StringRef name) {
+    thread_local llvm::StringMap<const std::string *> cache;
+    auto it = cache.find(name);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    const std::string *interned = symbolPool().intern(name);
+    cache.insert({name, interned});
+    return interned;
+}
+
+static const std::string *emptyName() {
+    static const std::string *name = symbolPool().intern("");
+    return name;
+}
+
+Symbol::Symbol() : name(emptyName()) {}
+
+Symbol::Symbol(llvm::StringRef name) : name(internName(name)) {}
+}
@@ -59,5 +59,3 @@ void makePrefixed(llvm::Value &Val, std::string Prefix,
                     std::to_string(InstructionNames.at(OldName)++));
     }
 }
-
-string UniqueNamePass::Prefix = "ERROR";
@@ -1,6 +1,11 @@
+#include <array>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <memory>
 #include <regex>
+#include <sys/wait.h>
 
 using std::string;
 
@@ -20,7 +25,9 @@ static std::pair<int, std::string> exec(const std::string &cmd) {
     return {exitCode, result};
 }
 
-enum class Solver { Z3, ELDARICA };
+// Z3 solves the muZ output, Z3_HORN and ELDARICA solve the SMT-Horn output and
+// LLREVE solves the clauses using -solve
+enum class Solver { Z3, Z3_HORN, ELDARICA, LLREVE };
 enum class ExpectedResult { EQUIVALENT, NOT_EQUIVALENT, UNKNOWN };
 
 std::ostream &operator<<(::std::ostream &os, ExpectedResult result) {
@@ -38,11 +45,55 @@ std::ostream &operator<<(::std::ostream &os, Solver solver) {
     switch (solver) {
     case Solver::Z3:
         return os << "z3";
+    case Solver::Z3_HORN:
+        return os << "z3-horn";
     case Solver::ELDARICA:
         return os << "eldarica";
+    case Solver::LLREVE:
+        return os << "llreve";
     }
 }
 
+// How llreve is run for an example
+enum class Invocation {
+    // The example is passed on the command line
+    Direct,
+    // The example is sent as a JSON job to llreve -server
+    Server,
+    // llreve runs twice with the same empty -smt-cache-dir. The second run
+    // has to produce the same SMT from the cache entry of the first one.
+    Cache
+};
+
+std::ostream &operator<<(::std::ostream &os, Invocation invocation) {
+    switch (invocation) {
+    case Invocation::Direct:
+        return os << "direct";
+    case Invocation::Server:
+        return os << "server";
+    case Invocation::Cache:
+        return os << "cache";
+    }
+}
+
+// Additional flags of llreve and the solver that is used for its output
+struct Mode {
+    Solver solver;
+    std::string flags;
+    Invocation invocation = Invocation::Direct;
+    // If not empty, the SMT has to be identical to the one generated with
+    // these flags instead of flags
+    std::string sameOutputAs = "";
+};
+
+std::ostream &operator<<(::std::ostream &os, const Mode &mode) {
+    os << mode.solver << " " << mode.flags << " " << mode.invocation;
+    if (!mode.sameOutputAs.empty()) {
+        os << " same output as " << mode.sameOutputAs;
+    }
+    return os;
+}
+
 ExpectedResult parseZ3Result(const std::string &output) {
     if (std::regex_search(output, std::regex("(^|\n)unsat"))) {
         return ExpectedResult::EQUIVALENT;
@@ -53,7 +104,8 @@ ExpectedResult parseZ3Result(const std::string &output) {
     return ExpectedResult::UNKNOWN;
 }
 
-ExpectedResult parseEldResult(const std::string &output) {
+// Solvers of the SMT-Horn format report sat if invariants have been found
+ExpectedResult parseHornResult(const std::string &output) {
     if (std::regex_search(output, std::regex("^sat"))) {
         return ExpectedResult::EQUIVALENT;
     }
@@ -63,42 +115,198 @@ ExpectedResult parseEldResult(const std::string &output) {
     return ExpectedResult::UNKNOWN;
 }
 
-class LlreveTest
-    : public testing::TestWithParam<
-          ::testing::tuple<std::string, std::string, ExpectedResult, Solver>> {
-  protected:
-    virtual void SetUp() {}
-    virtual void TearDown() {}
-};
+ExpectedResult parseSolveResult(const std::string &output) {
+    if (std::regex_search(output, std::regex("(^|\n)EQUAL"))) {
+        return ExpectedResult::EQUIVALENT;
+    }
+    if (std::regex_search(output, std::regex("(^|\n)NOT_EQUAL"))) {
+        return ExpectedResult::NOT_EQUIVALENT;
+    }
+    return ExpectedResult::UNKNOWN;
+}
 
-TEST_P(LlreveTest, Llreve) {
-    std::string directory;
-    std::string fileName;
-    ExpectedResult expectedResult;
-    Solver solver;
-    std::tie(directory, fileName, expectedResult, solver) = GetParam();
-    fileName =
-        PathToTestExecutable + "../../examples/" + directory + "/" + fileName;
-    char smtOutput[7] = "XXXXXX";
-    int fd = mkstemp(smtOutput);
+ExpectedResult parseDynamicResult(const std::string &output) {
+    if (std::regex_search(output, std::regex("have been proven equivalent"))) {
+        return ExpectedResult::EQUIVALENT;
+    }
+    if (std::regex_search(output, std::regex("could not be proved"))) {
+        return ExpectedResult::NOT_EQUIVALENT;
+    }
+    return ExpectedResult::UNKNOWN;
+}
+
+static std::string makeTempFile() {
+    char fileName[7] = "XXXXXX";
+    int fd = mkstemp(fileName);
     if (fd == -1) {
         perror("mkstemp");
         exit(1);
     }
     close(fd);
-    std::ostringstream llreveCommand;
-    llreveCommand << PathToTestExecutable
-                  << "llreve -inline-opts -o=" << smtOutput
-                  << " -I=" << PathToTestExecutable << "../../examples/headers"
-                  << " ";
+    return fileName;
+}
+
+static std::string readFile(const std::string &fileName) {
+    std::ifstream file(fileName);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+static std::vector<std::string> directoryEntries(const std::string &directory) {
+    std::vector<std::string> entries;
+    DIR *dir = opendir(directory.c_str());
+    if (!dir) {
+        return entries;
+    }
+    while (const dirent *entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") != 0 &&
+            strcmp(entry->d_name, "..") != 0) {
+            entries.push_back(directory + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+    return entries;
+}
+
+static std::vector<std::string> splitFlags(const std::string &flags) {
+    std::istringstream stream(flags);
+    std::vector<std::string> result;
+    std::string flag;
+    while (stream >> flag) {
+        result.push_back(flag);
+    }
+    return result;
+}
+
+static std::string jsonString(const std::string &str) {
+    std::string result = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result + "\"";
+}
+
+// Runs llreve on the example and writes the SMT to smtOutput. Returns the
+// exit code of llreve, -1 if it didn’t exit normally, and what it printed to
+// stdout.
+static std::pair<int, std::string>
+runLlreve(const std::string &fileName, Solver solver, const std::string &flags,
+          Invocation invocation, const std::string &smtOutput) {
+    std::vector<std::string> args = {
+        "-inline-opts", "-o=" + smtOutput,
+        "-I=" + PathToTestExecutable + "../../examples/headers"};
     if (solver == Solver::Z3) {
-        llreveCommand << "-muz ";
+        args.push_back("-muz");
+    } else if (solver == Solver::LLREVE) {
+        args.push_back("-solve");
+    }
+    for (const auto &flag : splitFlags(flags)) {
+        args.push_back(flag);
+    }
+    if (invocation != Invocation::Server) {
+        std::ostringstream llreveCommand;
+        llreveCommand << PathToTestExecutable << "llreve";
+        for (const auto &arg : args) {
+            llreveCommand << " " << arg;
+        }
+        llreveCommand << " " << fileName << "_1.c"
+                      << " " << fileName << "_2.c";
+        int status;
+        std::string output;
+        std::tie(status, output) = exec(llreveCommand.str());
+        return {WIFEXITED(status) ? WEXITSTATUS(status) : -1, output};
+    }
+    // Responses have the form {"exit_code":…,"id":…,"output":"…"}
+    std::string jobFile = makeTempFile();
+    {
+        std::ofstream job(jobFile);
+        job << "{\"id\": 1, \"files\": [" << jsonString(fileName + "_1.c")
+            << ", " << jsonString(fileName + "_2.c") << "], \"args\": [";
+        for (size_t i = 0; i < args.size(); ++i) {
+            job << (i == 0 ? "" : ", ") << jsonString(args[i]);
+        }
+        job << "]}\n";
+    }
+    int status;
+    std::string response;
+    std::tie(status, response) =
+        exec(PathToTestExecutable + "llreve -server < " + jobFile);
+    std::remove(jobFile.c_str());
+    std::smatch exitCode;
+    if (status != 0 ||
+        !std::regex_search(response, exitCode,
+                           std::regex("\"exit_code\":([0-9]+)"))) {
+        return {-1, response};
+    }
+    std::string output;
+    std::smatch outputMatch;
+    if (std::regex_search(response, outputMatch,
+                          std::regex("\"output\":\"((\\\\.|[^\"\\\\])*)\""))) {
+        output = std::regex_replace(outputMatch[1].str(), std::regex("\\\\n"),
+                                    "\n");
+    }
+    return {std::stoi(exitCode[1]), output};
+}
+
+static void checkLlreve(const std::string &directory, std::string fileName,
+                        ExpectedResult expectedResult, const Mode &mode) {
+    fileName =
+        PathToTestExecutable + "../../examples/" + directory + "/" + fileName;
+    const Solver solver = mode.solver;
+    std::string smtOutput = makeTempFile();
+    std::string flags = mode.flags;
+    std::string cacheDir;
+    if (mode.invocation == Invocation::Cache) {
+        char cacheDirTemplate[] = "llreve-cache-XXXXXX";
+        ASSERT_NE(mkdtemp(cacheDirTemplate), nullptr);
+        cacheDir = cacheDirTemplate;
+        flags += " -smt-cache-dir=" + cacheDir;
     }
-    llreveCommand << fileName << "_1.c"
-                  << " " << fileName << "_2.c";
     std::string llreveOutput;
     int exitCode;
-    std::tie(exitCode, llreveOutput) = exec(llreveCommand.str());
+    std::tie(exitCode, llreveOutput) =
+        runLlreve(fileName, solver, flags, mode.invocation, smtOutput);
+    if (mode.invocation == Invocation::Cache) {
+        const auto entries = directoryEntries(cacheDir);
+        // Mark the entry so that the output of the second run shows that it
+        // has been read from the cache
+        const std::string marker = "; cached\n";
+        const bool stored = exitCode == 0 && entries.size() == 1;
+        std::string cachedOutput = makeTempFile();
+        if (stored) {
+            std::ofstream(entries[0], std::ios::app) << marker;
+            std::tie(exitCode, llreveOutput) = runLlreve(
+                fileName, solver, flags, mode.invocation, cachedOutput);
+        }
+        exec("rm -r " + cacheDir);
+        ASSERT_TRUE(stored);
+        EXPECT_EQ(readFile(cachedOutput), readFile(smtOutput) + marker);
+        std::rename(cachedOutput.c_str(), smtOutput.c_str());
+    }
+    if (!mode.sameOutputAs.empty()) {
+        ASSERT_EQ(exitCode, 0);
+        std::string referenceOutput = makeTempFile();
+        int referenceExitCode;
+        std::string referenceLlreveOutput;
+        std::tie(referenceExitCode, referenceLlreveOutput) =
+            runLlreve(fileName, solver, mode.sameOutputAs, mode.invocation,
+                      referenceOutput);
+        ASSERT_EQ(referenceExitCode, 0);
+        EXPECT_EQ(readFile(smtOutput), readFile(referenceOutput));
+        std::remove(referenceOutput.c_str());
+    }
+    if (solver == Solver::LLREVE) {
+        // The exit code reflects the result
+        ASSERT_NE(exitCode, -1);
+        ASSERT_NE(exitCode, 1);
+        ASSERT_EQ(parseSolveResult(llreveOutput), expectedResult);
+        std::remove(smtOutput.c_str());
+        return;
+    }
     ASSERT_EQ(exitCode, 0);
     switch (solver) {
     case Solver::Z3: {
@@ -110,37 +318,147 @@ TEST_P(LlreveTest, Llreve) {
         ASSERT_EQ(parseZ3Result(z3Output), expectedResult);
         break;
     }
-    case Solver::ELDARICA:
+    case Solver::Z3_HORN: {
+        std::ostringstream z3Command;
+        z3Command << "z3 " << smtOutput;
+        std::string z3Output;
+        std::tie(exitCode, z3Output) = exec(z3Command.str());
+        ASSERT_EQ(exitCode, 0);
+        ASSERT_EQ(parseHornResult(z3Output), expectedResult);
+        break;
+    }
+    case Solver::ELDARICA: {
         std::ostringstream eldCommand;
         eldCommand << "eld-client -hsmt " << smtOutput;
         std::string eldOutput;
         std::tie(exitCode, eldOutput) = exec(eldCommand.str());
         ASSERT_EQ(exitCode, 0);
-        parseEldResult(eldOutput);
+        parseHornResult(eldOutput);
         break;
     }
-    std::remove(smtOutput);
-    EXPECT_EQ(0, 0);
+    case Solver::LLREVE:
+        break;
+    }
+    std::remove(smtOutput.c_str());
+}
+
+// llreve-dynamic interprets the programs to find the invariants and solves the
+// clauses itself
+static void checkLlreveDynamic(const std::string &directory,
+                               std::string fileName,
+                               ExpectedResult expectedResult) {
+    fileName =
+        PathToTestExecutable + "../../examples/" + directory + "/" + fileName;
+    std::ostringstream dynamicCommand;
+    dynamicCommand << PathToTestExecutable
+                   << "../dynamic/llreve-dynamic/llreve-dynamic -heap"
+                   << " -patterns=" << PathToTestExecutable
+                   << "../../dynamic/patterns/heappatterns"
+                   << " -I=" << PathToTestExecutable << "../../examples/headers"
+                   << " " << fileName << "_1.c"
+                   << " " << fileName << "_2.c 2>&1";
+    std::string dynamicOutput;
+    int exitCode;
+    std::tie(exitCode, dynamicOutput) = exec(dynamicCommand.str());
+    ASSERT_EQ(exitCode, 0);
+    ASSERT_EQ(parseDynamicResult(dynamicOutput), expectedResult);
+}
+
+class LlreveTest
+    : public testing::TestWithParam<
+          ::testing::tuple<std::string, std::string, ExpectedResult, Solver>> {
+  protected:
+    virtual void SetUp() {}
+    virtual void TearDown() {}
+};
+
+TEST_P(LlreveTest, Llreve) {
+    std::string directory;
+    std::string fileName;
+    ExpectedResult expectedResult;
+    Solver solver;
+    std::tie(directory, fileName, expectedResult, solver) = GetParam();
+    checkLlreve(directory, fileName, expectedResult, Mode{solver, ""});
+}
+
+// Runs the examples with flags that change the encoding or the processing of
+// the clauses. They have to produce the same results as the default mode.
+class LlreveModeTest
+    : public testing::TestWithParam<
+          ::testing::tuple<std::string, std::string, ExpectedResult, Mode>> {
+  protected:
+    virtual void SetUp() {}
+    virtual void TearDown() {}
+};
+
+TEST_P(LlreveModeTest, Llreve) {
+    std::string directory;
+    std::string fileName;
+    ExpectedResult expectedResult;
+    Mode mode;
+    std::tie(directory, fileName, expectedResult, mode) = GetParam();
+    checkLlreve(directory, fileName, expectedResult, mode);
+}
+
+class LlreveDynamicTest
+    : public testing::TestWithParam<
+          ::testing::tuple<std::string, std::string, ExpectedResult>> {
+  protected:
+    virtual void SetUp() {}
+    virtual void TearDown() {}
+};
+
+TEST_P(LlreveDynamicTest, LlreveDynamic) {
+    std::string directory;
+    std::string fileName;
+    ExpectedResult expectedResult;
+    std::tie(directory, fileName, expectedResult) = GetParam();
+    checkLlreveDynamic(directory, fileName, expectedResult);
 }
 
+// The programs of sign_split branch on the sign of x in opposite ways, so the
+// pairs of paths starting at the entry that disagree on x are infeasible. In
+// the faulty version the programs take different branches for x = 0, so those
+// pairs must not be skipped.
+static const std::string loopExamples[] = {
+    "barthe", "barthe2", "barthe2-big", "barthe2-big2", "break",
+    "break_single", "bug15", "digits10_inl", "fib", "loop", "loop2", "loop3",
+    "loop_unswitching", "nested-while", "sign_split", "simple-loop", "upcount",
+    "while_after_while_if", "while-if"};
+static const std::string faultyExamples[] = {
+    "ackermann!", "add-horn!", "barthe!",       "inlining!",  "limit1!",
+    "limit2!",    "loop5!",    "nested-while!", "sign_split!"};
+static const std::string heapExamples[] = {
+    "clearstr", "fib", "heap_call", "memcpy_a", "memcpy_b", "propagate"};
+static const std::string recExamples[] = {
+    "ackermann", "add-horn", "cocome1", "inlining", "limit1unrolled", "limit2",
+    "limit3", "loop_rec", "mccarthy91", /* "rec_while", */ "triangular"};
+
+// -cse and -stream only affect the SMT-Horn format. The LLREVE solver adds
+// -solve. The SMT generated by several threads has to be the same as the one
+// generated by a single thread.
+static const Mode modes[] = {
+    {Solver::Z3, "-large-block-encoding"},
+    {Solver::Z3, "-path-budget=1"},
+    {Solver::Z3, "-simplify"},
+    {Solver::Z3, "-prune-clauses -inline-predicates"},
+    {Solver::Z3, "-threads=4", Invocation::Direct, "-threads=1"},
+    {Solver::Z3, "", Invocation::Server},
+    {Solver::Z3, "", Invocation::Cache},
+    {Solver::Z3_HORN, "-cse"},
+    {Solver::Z3_HORN, "-stream"},
+    {Solver::LLREVE, ""}};
+
 INSTANTIATE_TEST_CASE_P(
     Loop, LlreveTest,
-    testing::Combine(testing::Values("loop"),
-                     testing::Values("barthe", "barthe2", "barthe2-big",
-                                     "barthe2-big2", "break", "break_single",
-                                     "bug15", "digits10_inl", "fib", "loop",
-                                     "loop2", "loop3", "loop_unswitching",
-                                     "nested-while", "simple-loop", "upcount",
-                                     "while_after_while_if", "while-if"),
+    testing::Combine(testing::Values("loop"), testing::ValuesIn(loopExamples),
                      testing::Values(ExpectedResult::EQUIVALENT),
                      testing::Values(Solver::Z3, Solver::ELDARICA)));
 
 INSTANTIATE_TEST_CASE_P(
     Faulty, LlreveTest,
     testing::Combine(testing::Values("faulty"),
-                     testing::Values("ackermann!", "add-horn!", "barthe!",
-                                     "inlining!", "limit1!", "limit2!",
-                                     "loop5!", "nested-while!"),
+                     testing::ValuesIn(faultyExamples),
                      testing::Values(ExpectedResult::NOT_EQUIVALENT),
                      testing::Values(Solver::Z3, Solver::ELDARICA)));
 
@@ -155,19 +473,13 @@ INSTANTIATE_TEST_CASE_P(
 
 INSTANTIATE_TEST_CASE_P(
     Heap, LlreveTest,
-    testing::Combine(testing::Values("heap"),
-                     testing::Values("clearstr", "fib", "heap_call", "memcpy_a",
-                                     "memcpy_b", "propagate"),
+    testing::Combine(testing::Values("heap"), testing::ValuesIn(heapExamples),
                      testing::Values(ExpectedResult::EQUIVALENT),
                      testing::Values(Solver::Z3, Solver::ELDARICA)));
 
 INSTANTIATE_TEST_CASE_P(
     Rec, LlreveTest,
-    testing::Combine(testing::Values("rec"),
-                     testing::Values("ackermann", "add-horn", "cocome1",
-                                     "inlining", "limit1unrolled", "limit2",
-                                     "limit3", "loop_rec", "mccarthy91",
-                                     /* "rec_while", */ "triangular"),
+    testing::Combine(testing::Values("rec"), testing::ValuesIn(recExamples),
                      testing::Values(ExpectedResult::EQUIVALENT),
                      testing::Values(Solver::Z3, Solver::ELDARICA)));
 
@@ -191,6 +503,37 @@ INSTANTIATE_TEST_CASE_P(
                      testing::Values(ExpectedResult::EQUIVALENT),
                      testing::Values(Solver::Z3)));
 
+INSTANTIATE_TEST_CASE_P(
+    LoopModes, LlreveModeTest,
+    testing::Combine(testing::Values("loop"), testing::ValuesIn(loopExamples),
+                     testing::Values(ExpectedResult::EQUIVALENT),
+                     testing::ValuesIn(modes)));
+
+INSTANTIATE_TEST_CASE_P(
+    FaultyModes, LlreveModeTest,
+    testing::Combine(testing::Values("faulty"),
+                     testing::ValuesIn(faultyExamples),
+                     testing::Values(ExpectedResult::NOT_EQUIVALENT),
+                     testing::ValuesIn(modes)));
+
+INSTANTIATE_TEST_CASE_P(
+    HeapModes, LlreveModeTest,
+    testing::Combine(testing::Values("heap"), testing::ValuesIn(heapExamples),
+                     testing::Values(ExpectedResult::EQUIVALENT),
+                     testing::ValuesIn(modes)));
+
+INSTANTIATE_TEST_CASE_P(
+    RecModes, LlreveModeTest,
+    testing::Combine(testing::Values("rec"), testing::ValuesIn(recExamples),
+                     testing::Values(ExpectedResult::EQUIVALENT),
+                     testing::ValuesIn(modes)));
+
+// Loads and stores of pointers, which the interpreter treats as 64 bit integers
+INSTANTIATE_TEST_CASE_P(
+    HeapDynamic, LlreveDynamicTest,
+    testing::Combine(testing::Values("heap"), testing::Values("ptr_to_ptr"),
+                     testing::Values(ExpectedResult::EQUIVALENT)));
+
 static std::string getDirectory(std::string filePath) {
     auto pos = filePath.rfind('/');
     if (pos != std::string::npos) {